@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <sstream>
+
+#include "bench_util.h"
+#include "com_subseq.h"
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+// The arguments of the benchmark are (the number of ComSubseqs of each file,
+// the number of files). The copy waits for the file system, so the throughput
+// is measured with the real time.
+static void BM_CombineComSubSeqFiles(benchmark::State& state) {
+  const std::size_t file_size = static_cast<std::size_t>(state.range(0));
+  const std::size_t files_size = static_cast<std::size_t>(state.range(1));
+  const std::vector<ComSubseq> seqs = GenerateSortedRuns(file_size, 16);
+
+  std::vector<FilePath> ifilepaths;
+  for (std::size_t i = 0; i < files_size; ++i) {
+    std::ostringstream oss;
+    oss << "bench_combine_" << i;
+    ifilepaths.push_back(GetBenchFilePath(oss.str()));
+    WriteComSubseqFile(seqs, ifilepaths.back());
+  }
+  const FilePath ofilepath = GetBenchFilePath("bench_combined");
+
+  for (auto _ : state) CombineComSubSeqFiles(ifilepaths, ofilepath);
+
+  const uint64_t size = file_size * files_size;
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+  for (const auto& filepath : ifilepaths) std::remove(filepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+BENCHMARK(BM_CombineComSubSeqFiles)
+    ->Args({1 << 16, 64})
+    ->Args({1 << 20, 8})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace pcpe
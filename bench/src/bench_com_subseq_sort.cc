@@ -0,0 +1,136 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "bench_util.h"
+#include "com_subseq.h"
+#include "com_subseq_sort.h"
+#include "env.h"
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+// The arguments of the sort benchmarks are (the number of ComSubseqs, the
+// skew of the sequence pairs in percent). The ComSubseqs are of 1000
+// sequences.
+//
+// The sort and the parallel merge run on the thread pool, so their throughput
+// is measured with the real time.
+static const std::size_t kSeqsSize = 1000;
+
+// The number of input files of the merge benchmarks.
+static const std::size_t kMergeFilesSize = 8;
+
+static void RemoveFiles(const std::vector<FilePath>& filepaths) {
+  for (const auto& filepath : filepaths) std::remove(filepath.c_str());
+}
+
+/**
+ * Sort a file. If `split_size` is not 0, the sort buffer holds `split_size`
+ * ComSubseqs at most so the file is sorted with external merge sort.
+ * */
+static void SortComSubseqFile(benchmark::State& state,
+                              std::size_t split_size) {
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+  const double skew = static_cast<double>(state.range(1)) / 100.0;
+  const FilePath ifilepath = GetBenchFilePath("bench_unsorted");
+  WriteComSubseqFile(GenerateComSubseqs(size, kSeqsSize, skew, 1), ifilepath);
+
+  const uint32_t buffer_size = GetEnv().getBufferSize();
+  if (split_size != 0)
+    gEnv.setBufferSize(static_cast<uint32_t>(split_size * sizeof(ComSubseq)));
+
+  for (auto _ : state) {
+    std::vector<FilePath> ofilepaths;
+    SortComSubseqsFiles({ifilepath}, ofilepaths);
+
+    state.PauseTiming();
+    RemoveFiles(ofilepaths);
+    state.ResumeTiming();
+  }
+
+  gEnv.setBufferSize(buffer_size);
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+  std::remove(ifilepath.c_str());
+}
+
+static void BM_SortComSubseqsFiles(benchmark::State& state) {
+  SortComSubseqFile(state, 0);
+}
+BENCHMARK(BM_SortComSubseqsFiles)
+    ->Args({1 << 20, 0})
+    ->Args({1 << 20, 100})
+    ->Args({1 << 22, 0})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+static void BM_SortComSubseqsFiles_external(benchmark::State& state) {
+  SortComSubseqFile(state, state.range(0) / kMergeFilesSize);
+}
+BENCHMARK(BM_SortComSubseqsFiles_external)
+    ->Args({1 << 20, 0})
+    ->Args({1 << 22, 0})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/// Write `kMergeFilesSize` sorted files of `size` ComSubseqs in total.
+static std::vector<FilePath> CreateSortedFiles(std::size_t size) {
+  const ComSubseqLess less(GetEnv().getComSubseqOrder());
+  std::vector<ComSubseq> seqs = GenerateComSubseqs(size, kSeqsSize, 0.0, 1);
+
+  std::vector<FilePath> filepaths;
+  const std::size_t file_size = (size + kMergeFilesSize - 1) / kMergeFilesSize;
+  for (std::size_t i = 0; i < kMergeFilesSize; ++i) {
+    auto begin = seqs.begin() + std::min(seqs.size(), i * file_size);
+    auto end = seqs.begin() + std::min(seqs.size(), (i + 1) * file_size);
+    std::sort(begin, end, less);
+
+    std::ostringstream oss;
+    oss << "bench_sorted_" << i;
+    filepaths.push_back(GetBenchFilePath(oss.str()));
+    WriteComSubseqFile(std::vector<ComSubseq>(begin, end), filepaths.back());
+  }
+
+  return filepaths;
+}
+
+static void BM_MergeSortedComSubseqFiles(benchmark::State& state) {
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+  const std::vector<FilePath> ifilepaths = CreateSortedFiles(size);
+  const FilePath ofilepath = GetBenchFilePath("bench_merged");
+
+  for (auto _ : state) {
+    ComSubseqFileWriter writer(ofilepath);
+    MergeSortedComSubseqFiles(ifilepaths, writer);
+    writer.close();
+  }
+
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+  RemoveFiles(ifilepaths);
+  std::remove(ofilepath.c_str());
+}
+BENCHMARK(BM_MergeSortedComSubseqFiles)
+    ->Arg(1 << 20)
+    ->Arg(1 << 22)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ParallelMergeSortedComSubseqFiles(benchmark::State& state) {
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+  const std::vector<FilePath> ifilepaths = CreateSortedFiles(size);
+  const FilePath ofilepath = GetBenchFilePath("bench_merged");
+
+  for (auto _ : state) ParallelMergeSortedComSubseqFiles(ifilepaths, ofilepath);
+
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+  RemoveFiles(ifilepaths);
+  std::remove(ofilepath.c_str());
+}
+BENCHMARK(BM_ParallelMergeSortedComSubseqFiles)
+    ->Arg(1 << 20)
+    ->Arg(1 << 22)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace pcpe
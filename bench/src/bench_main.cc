@@ -0,0 +1,19 @@
+#include <benchmark/benchmark.h>
+
+#include "env.h"
+#include "pcpe_util.h"
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  // All input and output files of the benchmarks are in the folder.
+  const pcpe::FilePath folder = "./benchoutput";
+  if (!pcpe::CheckFolderExists(folder.c_str()) &&
+      !pcpe::CreateFolder(folder.c_str()))
+    return 1;
+  pcpe::gEnv.setTempFolderPath(folder);
+
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
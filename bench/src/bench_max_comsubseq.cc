@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+
+#include "bench_util.h"
+#include "com_subseq.h"
+#include "max_comsubseq.h"
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+// The arguments of the benchmarks are (the number of sorted ComSubseqs, the
+// length of the continuous runs).
+
+static void BM_MergeContineousComSubseqs(benchmark::State& state) {
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+  const std::vector<ComSubseq> sorted_seqs =
+      GenerateSortedRuns(size, static_cast<std::size_t>(state.range(1)));
+  std::vector<ComSubseq> seqs;
+  std::unique_ptr<bool[]> merges(new bool[size]);
+
+  for (auto _ : state) {
+    // The lengths of the runs are changed by the merge.
+    state.PauseTiming();
+    seqs = sorted_seqs;
+    state.ResumeTiming();
+
+    MergeContineousComSubseqs(seqs.data(), merges.get(), seqs.size());
+    benchmark::DoNotOptimize(merges.get());
+  }
+
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+}
+BENCHMARK(BM_MergeContineousComSubseqs)
+    ->Args({1 << 20, 1})
+    ->Args({1 << 20, 16})
+    ->Args({1 << 22, 16})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_MaxComSubseqFileWriter(benchmark::State& state) {
+  const std::size_t size = static_cast<std::size_t>(state.range(0));
+  const std::vector<ComSubseq> seqs =
+      GenerateSortedRuns(size, static_cast<std::size_t>(state.range(1)));
+  const FilePath ofilepath = GetBenchFilePath("bench_max_comsubseq");
+
+  for (auto _ : state) {
+    MaxComSubseqFileWriter writer(ofilepath);
+    for (const auto& seq : seqs) writer.writeSeq(seq);
+    writer.close();
+  }
+
+  SetThroughput(state, size, size * sizeof(ComSubseq));
+  std::remove(ofilepath.c_str());
+}
+BENCHMARK(BM_MaxComSubseqFileWriter)
+    ->Args({1 << 20, 1})
+    ->Args({1 << 20, 16})
+    ->Args({1 << 22, 16})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace pcpe
@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+
+#include "bench_util.h"
+#include "com_subseq.h"
+#include "env.h"
+#include "pcpe_util.h"
+#include "small_seq_hash.h"
+
+namespace pcpe {
+
+// The arguments of the benchmarks are (the number of sequences, the skew of
+// the residue composition in percent). Each sequence has 512 residues.
+static const std::size_t kSeqLength = 512;
+
+static double GetSkew(const benchmark::State& state) {
+  return static_cast<double>(state.range(1)) / 100.0;
+}
+
+static uint64_t GetSmallSeqsBytes(const SmallSeqList& smallseqs,
+                                  uint64_t& entries_size) {
+  entries_size = 0;
+  for (const auto& smallseq : smallseqs)
+    entries_size += smallseq.second.size();
+
+  return smallseqs.size() * sizeof(SmallSeqHashIndex) +
+         entries_size * sizeof(SeqLoc);
+}
+
+static void BM_HashSmallSeq(benchmark::State& state) {
+  const SeqList seqs = GenerateSequences(1, state.range(0), 0.0, 1);
+  const char* s = seqs[0].c_str();
+  const std::size_t size = seqs[0].size() - GetEnv().getSmallSeqLength() + 1;
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < size; ++i)
+      benchmark::DoNotOptimize(HashSmallSeq(s + i));
+  }
+
+  SetThroughput(state, size, seqs[0].size());
+}
+BENCHMARK(BM_HashSmallSeq)->Arg(1 << 16)->Arg(1 << 20);
+
+static void BM_ConstructSmallSeqs(benchmark::State& state) {
+  const SeqList seqs =
+      GenerateSequences(state.range(0), kSeqLength, GetSkew(state), 1);
+  const uint64_t size = GetSmallSeqSize(seqs, 0, seqs.size());
+
+  for (auto _ : state) {
+    SmallSeqList smallseqs;
+    ConstructSmallSeqs(seqs, 0, seqs.size(), smallseqs);
+    benchmark::DoNotOptimize(smallseqs.size());
+  }
+
+  SetThroughput(state, size, GetSequencesBytes(seqs));
+}
+BENCHMARK(BM_ConstructSmallSeqs)
+    ->Args({1000, 0})
+    ->Args({1000, 150})
+    ->Args({4000, 0})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SmallSeqHashFileRoundTrip(benchmark::State& state) {
+  const SeqList seqs =
+      GenerateSequences(state.range(0), kSeqLength, GetSkew(state), 1);
+  SmallSeqList smallseqs;
+  ConstructSmallSeqs(seqs, 0, seqs.size(), smallseqs);
+
+  uint64_t entries_size = 0;
+  const uint64_t bytes = GetSmallSeqsBytes(smallseqs, entries_size);
+  const FilePath filepath = GetBenchFilePath("bench_hash_table");
+
+  for (auto _ : state) {
+    SmallSeqHashFileWriter writer(filepath);
+    for (const auto& smallseq : smallseqs) writer.writeEntry(smallseq);
+    writer.close();
+
+    SmallSeqHashFileReader reader(filepath);
+    std::pair<SmallSeqHashIndex, SeqLocList> entry;
+    while (!reader.eof()) reader.readEntry(entry);
+    reader.close();
+  }
+
+  // Each entry is written and read once.
+  SetThroughput(state, 2 * entries_size, 2 * bytes);
+  std::remove(filepath.c_str());
+}
+BENCHMARK(BM_SmallSeqHashFileRoundTrip)
+    ->Args({1000, 0})
+    ->Args({1000, 150})
+    ->Args({4000, 0})
+    ->Unit(benchmark::kMillisecond);
+
+/// Count the ComSubseqs without writing them.
+struct ComSubseqCounter {
+  bool writeSeq(const ComSubseq&) {
+    size++;
+    return true;
+  }
+
+  uint64_t size = 0;
+};
+
+static void BM_CompareHashTableFiles(benchmark::State& state) {
+  const double skew = GetSkew(state);
+  const SeqList xs = GenerateSequences(state.range(0), kSeqLength, skew, 1);
+  const SeqList ys = GenerateSequences(state.range(0), kSeqLength, skew, 2);
+
+  const FilePath x_filepath = GetBenchFilePath("bench_hash_table_x");
+  const FilePath y_filepath = GetBenchFilePath("bench_hash_table_y");
+  const FilePath ofilepath = GetBenchFilePath("bench_compare_hash");
+  CreateHashTableFile(xs, 0, xs.size(), x_filepath);
+  CreateHashTableFile(ys, 0, ys.size(), y_filepath);
+
+  ComSubseqCounter counter;
+  CompareHashTableFiles(x_filepath, y_filepath, counter);
+
+  for (auto _ : state) {
+    ComSubseqFileWriter writer(ofilepath);
+    CompareHashTableFiles(x_filepath, y_filepath, writer);
+    writer.close();
+  }
+
+  // The throughput is of the output ComSubseqs.
+  SetThroughput(state, counter.size, counter.size * sizeof(ComSubseq));
+  std::remove(x_filepath.c_str());
+  std::remove(y_filepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+BENCHMARK(BM_CompareHashTableFiles)
+    ->Args({1000, 0})
+    ->Args({1000, 100})
+    ->Args({4000, 0})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace pcpe
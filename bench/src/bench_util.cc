@@ -0,0 +1,84 @@
+#include "bench_util.h"
+
+#include <cmath>
+#include <random>
+
+#include "env.h"
+
+namespace pcpe {
+
+static const char* kAminoAcids = "ACDEFGHIKLMNPQRSTVWY";
+static const std::size_t kAminoAcidSize = 20;
+
+/// The Zipf weights `1 / rank^skew` of `size` items.
+static std::vector<double> GetZipfWeights(std::size_t size, double skew) {
+  std::vector<double> weights(size);
+  for (std::size_t i = 0; i < size; ++i)
+    weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), skew);
+
+  return weights;
+}
+
+FilePath GetBenchFilePath(const std::string& name) {
+  return GetEnv().getTempFolderPath() + "/" + name;
+}
+
+SeqList GenerateSequences(std::size_t size, std::size_t length, double skew,
+                          uint32_t seed) {
+  std::mt19937 gen(seed);
+  const std::vector<double> weights = GetZipfWeights(kAminoAcidSize, skew);
+  std::discrete_distribution<std::size_t> residue(weights.begin(),
+                                                  weights.end());
+
+  SeqList seqs(size);
+  for (auto& seq : seqs) {
+    seq.resize(length);
+    for (auto& c : seq) c = kAminoAcids[residue(gen)];
+  }
+
+  return seqs;
+}
+
+std::vector<ComSubseq> GenerateComSubseqs(std::size_t size,
+                                          std::size_t seqs_size, double skew,
+                                          uint32_t seed) {
+  std::mt19937 gen(seed);
+  const std::vector<double> weights = GetZipfWeights(seqs_size, skew);
+  std::discrete_distribution<uint32_t> seq_idx(weights.begin(), weights.end());
+  std::uniform_int_distribution<uint32_t> loc(0, 4095);
+
+  std::vector<ComSubseq> seqs;
+  seqs.reserve(size);
+  for (std::size_t i = 0; i < size; ++i)
+    seqs.emplace_back(seq_idx(gen), seq_idx(gen), loc(gen), loc(gen), 6);
+
+  return seqs;
+}
+
+std::vector<ComSubseq> GenerateSortedRuns(std::size_t size,
+                                          std::size_t run_length) {
+  std::vector<ComSubseq> seqs;
+  seqs.reserve(size);
+  for (std::size_t i = 0; i < size; ++i) {
+    const uint32_t run = static_cast<uint32_t>(i / run_length);
+    const uint32_t loc = static_cast<uint32_t>(i % run_length);
+    seqs.emplace_back(run / 1024, run % 1024, loc, loc, 6);
+  }
+
+  return seqs;
+}
+
+void SetThroughput(benchmark::State& state, uint64_t items, uint64_t bytes) {
+  const int64_t iterations = static_cast<int64_t>(state.iterations());
+  state.SetItemsProcessed(iterations * static_cast<int64_t>(items));
+  state.SetBytesProcessed(iterations * static_cast<int64_t>(bytes));
+}
+
+uint64_t GetSequencesBytes(const SeqList& seqs) {
+  uint64_t size = 0;
+  for (const auto& seq : seqs) size += seq.size();
+
+  return size;
+}
+
+}  // namespace pcpe
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "com_subseq.h"
+#include "pcpe_util.h"
+#include "seq.h"
+
+namespace pcpe {
+
+/// Get the path of a file in the temp folder of `GetEnv()`.
+FilePath GetBenchFilePath(const std::string& name);
+
+/**
+ * Generate random protein sequences.
+ *
+ * The residues are drawn from the 20 amino acids with the Zipf weights
+ * `1 / rank^skew`. The skew 0 is the uniform composition. A larger skew makes
+ * a few residues dominant so the small seqs repeat more often, which is the
+ * case of low-complexity sequences.
+ *
+ * @param[in] size the number of sequences
+ * @param[in] length the length of each sequence
+ * @param[in] skew the skew of the residue composition
+ * @param[in] seed the seed of the random generator
+ * */
+SeqList GenerateSequences(std::size_t size, std::size_t length, double skew,
+                          uint32_t seed);
+
+/**
+ * Generate random ComSubseqs of `seqs_size` sequences. The sequences of each
+ * ComSubseq are drawn with the Zipf weights `1 / rank^skew` so a larger skew
+ * concentrates the ComSubseqs on a few sequence pairs.
+ * */
+std::vector<ComSubseq> GenerateComSubseqs(std::size_t size,
+                                          std::size_t seqs_size, double skew,
+                                          uint32_t seed);
+
+/**
+ * Generate ComSubseqs sorted with both `ComSubseqOrder`s. They form the
+ * continuous runs of `run_length` ComSubseqs, so the maximum common
+ * subseqences are `size / run_length` runs.
+ * */
+std::vector<ComSubseq> GenerateSortedRuns(std::size_t size,
+                                          std::size_t run_length);
+
+/**
+ * Report the throughput (records/s and bytes/s) of the benchmark. Each
+ * iteration processes `items` records of `bytes` bytes.
+ * */
+void SetThroughput(benchmark::State& state, uint64_t items, uint64_t bytes);
+
+/// Get the total size (unit: byte(s)) of the sequences.
+uint64_t GetSequencesBytes(const SeqList& seqs);
+
+}  // namespace pcpe
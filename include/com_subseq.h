@@ -5,10 +5,22 @@
 #include <memory>
 #include <vector>
 
+#include "memory_budget.h"
 #include "pcpe_util.h"
 
 namespace pcpe {
 
+/// The sort keys of ComSubseqs used by the sort and merge stages.
+enum class ComSubseqOrder {
+  /// (x, y, x_loc, y_loc). It's the order of `ComSubseq::operator<`.
+  kLocation,
+
+  /// (x, y, x_loc - y_loc, x_loc). The ComSubseqs on the same diagonal of a
+  /// sequence pair are contiguous so the continuous ComSubseqs are always
+  /// neighbours after sorting.
+  kDiagonal,
+};
+
 class ComSubseq;
 std::ostream& operator<<(std::ostream& out, const ComSubseq& s);
 
@@ -26,6 +38,10 @@ class ComSubseq {
   ComSubseq& operator=(const ComSubseq&) = default;
   ~ComSubseq() = default;
 
+  uint32_t getX() const { return x_; }
+  uint32_t getY() const { return y_; }
+  uint32_t getXLoc() const { return x_loc_; }
+  uint32_t getYLoc() const { return y_loc_; }
   uint32_t getLength() const { return len_; }
   void setLength(uint32_t len) { len_ = len; }
 
@@ -33,6 +49,15 @@ class ComSubseq {
 
   bool isSameSeqeunce(const ComSubseq& rhs) const;
 
+  /// Get the diagonal (x_loc - y_loc) of the ComSubseq in the dot plot of the
+  /// two sequences.
+  int64_t getDiagonal() const {
+    return static_cast<int64_t>(x_loc_) - static_cast<int64_t>(y_loc_);
+  }
+
+  /// Compare with the key (x, y, x_loc - y_loc, x_loc).
+  bool lessByDiagonal(const ComSubseq& rhs) const;
+
   bool operator==(const ComSubseq& rhs) const;
   bool operator<(const ComSubseq& rhs) const;
   bool operator>(const ComSubseq& rhs) const;
@@ -48,9 +73,30 @@ class ComSubseq {
   uint32_t len_;
 };
 
+/**
+ * The comparator of ComSubseqs for the given sort keys. It can be used with
+ * `std::sort` and other standard algorithms.
+ * */
+class ComSubseqLess {
+ public:
+  explicit ComSubseqLess(ComSubseqOrder order) : order_(order) {}
+
+  bool operator()(const ComSubseq& x, const ComSubseq& y) const {
+    if (order_ == ComSubseqOrder::kDiagonal) return x.lessByDiagonal(y);
+
+    return x < y;
+  }
+
+  ComSubseqOrder getOrder() const { return order_; }
+
+ private:
+  ComSubseqOrder order_;
+};
+
 class ComSubseqFileReader {
   friend bool CompareComSubseqFileReaderFirstEntry(
-      const ComSubseqFileReader& x, const ComSubseqFileReader& y);
+      const ComSubseqFileReader& x, const ComSubseqFileReader& y,
+      const ComSubseqLess& less);
 
  public:
   /// Construct with filepath
@@ -89,6 +135,7 @@ class ComSubseqFileReader {
   FileSize file_size_;       // unit: byte
   FileSize curr_read_size_;  // unit: byte
 
+  MemoryReservation memory_;
   const std::streamsize max_buffer_size_;
   std::unique_ptr<ComSubseq[]> buffer_;
   std::streamsize buffer_size_;
@@ -107,10 +154,12 @@ class ComSubseqFileWriter {
   /// Get the path of output file
   const FilePath& getFilePath() const { return filepath_; }
 
-  void close() {
+  /// Return false if the file is not open or a write error happened.
+  bool close() {
     writeBuffer();
     outfile_.flush();
     outfile_.close();
+    return !outfile_.fail();
   }
 
   bool is_open() const { return outfile_.is_open(); }
@@ -125,6 +174,7 @@ class ComSubseqFileWriter {
   FilePath filepath_;
   std::ofstream outfile_;
 
+  MemoryReservation memory_;
   std::unique_ptr<ComSubseq[]> buffer_;
   std::streamsize buffer_size_;
   std::size_t buffer_idx_;
@@ -143,6 +193,17 @@ class ComSubseqFileWriter {
 bool ReadComSubseqFile(const FilePath& filepath,
                        std::vector<ComSubseq>& com_seqs);
 
+/**
+ * Read the ComSubseq at the index of a file.
+ *
+ * @param[in] ifile the opened ComSubseq file
+ * @param[in] idx the index of the ComSubseq (unit: ComSubseq)
+ * @param[out] seq the ComSubseq
+ *
+ * @return false: the index is out of the file or error happened.
+ * */
+bool ReadComSubseqAt(std::ifstream& ifile, uint64_t idx, ComSubseq& seq);
+
 /**
  * Write lists of ComSubseq to a file.
  *
@@ -168,12 +229,43 @@ void SplitComSubseqFile(const FilePath& ifilepath,
                         std::vector<FilePath>& ofilepaths);
 
 /**
- * Combine several ComSubseq files into one file.
+ * Split a sequence files to several files. The size of splited files is
+ * smaller than or equal the split size.
+ *
+ * @param[in] ifilepath the path of input file
+ * @param[in] split_size the maximum size of each splited file (unit: byte)
+ * @param[out] ofilepaths the path of output files
+ *
+ * */
+void SplitComSubseqFile(const FilePath& ifilepath, std::size_t split_size,
+                        std::vector<FilePath>& ofilepaths);
+
+/**
+ * Append a ComSubseq file to the end of another file.
+ *
+ * The data is copied in the kernel (`copy_file_range` or `sendfile`) so no
+ * buffer is allocated. A bounded buffer is used only if the kernel does not
+ * support the copy of the two files.
+ *
+ * @param[in] ifilepath the path of input file
+ * @param[out] ofilepath the path of output file
+ *
+ * @return true: append file successfully.
+ *         false: error happened.
+ * */
+bool AppendComSubseqFile(const FilePath& ifilepath, const FilePath& ofilepath);
+
+/**
+ * Combine several ComSubseq files into one file. The files are copied the
+ * same as `AppendComSubseqFile`.
  *
  * @param[in] ifilepath the list of input file paths
  * @param[out] ofilepath the path of output file
+ *
+ * @return true: combine files successfully.
+ *         false: error happened. The output file is incomplete.
  * */
-void CombineComSubSeqFiles(const std::vector<FilePath>& ifilepaths,
+bool CombineComSubSeqFiles(const std::vector<FilePath>& ifilepaths,
                            const FilePath& ofilepath);
 
 }  // namespace pcpe
@@ -1,15 +1,200 @@
 #pragma once
 
+#include <cstdint>
+#include <queue>
 #include <vector>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "memory_budget.h"
 #include "pcpe_util.h"
 
 namespace pcpe {
+
+bool CompareComSubseqFileReaderFirstEntry(const ComSubseqFileReader& x,
+                                          const ComSubseqFileReader& y,
+                                          const ComSubseqLess& less);
+
+/**
+ * External merge sort for the sorted files and write the result with the
+ * writer.
+ *
+ * @param[in] filepaths The list of files. Each file is sorted with
+ *                      `GetEnv().getComSubseqOrder()`.
+ * @param[out] writer The output. The `Writer` could be any type with a
+ *                    `writeSeq(const ComSubseq&)` member function, e.g.
+ *                    `ComSubseqFileWriter` or `MaxComSubseqFileWriter`.
+ * */
+template <typename Writer>
+void MergeSortedComSubseqFiles(const std::vector<FilePath>& filepaths,
+                               Writer& writer) {
+  // Create all readers from the files
+  const ComSubseqLess less(GetEnv().getComSubseqOrder());
+  auto cmp_fun = [&less](const ComSubseqFileReader* x,
+                         const ComSubseqFileReader* y) -> bool {
+    return CompareComSubseqFileReaderFirstEntry(*x, *y, less);
+  };
+
+  std::priority_queue<ComSubseqFileReader*, std::vector<ComSubseqFileReader*>,
+                      decltype(cmp_fun)>
+      readers(cmp_fun);
+
+  for (const auto& file : filepaths) {
+    ComSubseqFileReader* reader = new ComSubseqFileReader(file);
+    if (reader->eof())
+      delete reader;
+    else
+      readers.push(reader);
+  }
+
+  // External merge sort and write the result.
+  while (!readers.empty()) {
+    // Find the minimum entry of these files
+    ComSubseqFileReader* reader = readers.top();
+    readers.pop();
+    ComSubseq seq;
+    reader->readSeq(seq);
+
+    // Write the current minimum entry
+    writer.writeSeq(seq);
+
+    // If the reader has another entries, push the reader back to the queue.
+    if (reader->eof()) {
+      reader->close();
+      delete reader;
+      reader = nullptr;
+    } else {
+      readers.push(reader);
+    }
+  }
+}
+
+/**
+ * Merge the sorted files into one sorted file with all threads of the thread
+ * pool.
+ *
+ * The output is split into partitions, about one per worker. The splitters
+ * are selected from samples of the files in proportion to their sizes, and
+ * the range of each partition in each file is found with binary search. Each
+ * partition merges its ranges of all files by itself and writes the result at
+ * its offset of the output file with `pwrite`, so the partitions run in
+ * parallel without any coordination. The result is the same as
+ * `MergeSortedComSubseqFiles`.
+ *
+ * A partition opens all files, so too many files are merged in groups first
+ * (`<ofilepath>_merge_<level>_<n>`). The merged groups are removed after the
+ * final merge.
+ *
+ * @param[in] ifilepaths The list of files. Each file is sorted with
+ *                       `GetEnv().getComSubseqOrder()`.
+ * @param[out] ofilepath The output file. It should not be one of the inputs.
+ *
+ * @return false: a file can not be read or written.
+ * */
+bool ParallelMergeSortedComSubseqFiles(const std::vector<FilePath>& ifilepaths,
+                                       const FilePath& ofilepath);
+
+/**
+ * Merge the sorted files and write the maximum common subseqences with all
+ * threads of the thread pool.
+ *
+ * The partitions are split the same as `ParallelMergeSortedComSubseqFiles`,
+ * but each partition starts at the first ComSubseq of a sequence pair (x, y).
+ * All ComSubseqs of a pair are merged by the same `MaxComSubseqFileWriter`, so
+ * the continuous runs and the selection of each pair are not split. Each
+ * partition writes its own part file and the parts are appended to the output
+ * in order. Too many files are merged in groups first, the same as
+ * `ParallelMergeSortedComSubseqFiles`. The result is the same as
+ * `MergeSortedComSubseqFiles` with a `MaxComSubseqFileWriter`.
+ *
+ * @param[in] ifilepaths The list of files. Each file is sorted with
+ *                       `GetEnv().getComSubseqOrder()`.
+ * @param[out] ofilepath The output file. It should not be one of the inputs.
+ *
+ * @return false: a file can not be read or written.
+ * */
+bool ParallelMergeMaxComSubseqFiles(const std::vector<FilePath>& ifilepaths,
+                                    const FilePath& ofilepath);
+
+/**
+ * Collect ComSubseqs in memory and write them in sorted order.
+ *
+ * The buffer keeps `GetEnv().getBufferSize()` bytes of ComSubseqs at most. The
+ * memory is reserved from the memory budget when the buffer is created, so
+ * the buffer could be shrunk to a quarter of the size. If more ComSubseqs
+ * are written, the buffer is sorted and spilled to a run file
+ * (`<spill_prefix>_run_<n>`). If the prefix is in a temp folder, the runs
+ * are striped on the temp folders (see `GetStripedTempFilePath`). `sortTo`
+ * merges the spilled runs with external merge sort. If nothing is spilled, no
+ * file is touched at all.
+ *
+ * The spilled files are removed when the buffer is destroyed.
+ * */
+class ComSubseqSortBuffer {
+ public:
+  explicit ComSubseqSortBuffer(const FilePath& spill_prefix);
+  ~ComSubseqSortBuffer();
+
+  /// Return true to present a valid write.
+  bool writeSeq(const ComSubseq& seq);
+
+  /// Write all collected ComSubseqs with the writer in sorted order.
+  template <typename Writer>
+  void sortTo(Writer& writer);
+
+  /**
+   * Write the maximum common subseqences of all collected ComSubseqs to the
+   * file. The spilled runs are merged with `ParallelMergeMaxComSubseqFiles`.
+   *
+   * @return false: the file can not be written or a spilled run can not be
+   *         merged.
+   * */
+  bool sortMaxTo(const FilePath& ofilepath);
+
+  /// Get the number of spilled run files.
+  std::size_t getSpillSize() const { return spill_size_; }
+
+  ComSubseqSortBuffer(const ComSubseqSortBuffer&) = delete;
+  ComSubseqSortBuffer& operator=(const ComSubseqSortBuffer&) = delete;
+
+ private:
+  void sort();
+  void spill();
+  void removeSpillFiles();
+
+  const FilePath spill_prefix_;
+  MemoryReservation memory_;
+  std::size_t max_seqs_size_;
+  std::vector<ComSubseq> seqs_;
+  std::vector<FilePath> spill_filepaths_;
+  std::size_t spill_size_;
+};
+
+template <typename Writer>
+void ComSubseqSortBuffer::sortTo(Writer& writer) {
+  if (spill_filepaths_.empty()) {
+    // All ComSubseqs are in memory.
+    sort();
+    for (const auto& seq : seqs_) writer.writeSeq(seq);
+  } else {
+    spill();
+    MergeSortedComSubseqFiles(spill_filepaths_, writer);
+    removeSpillFiles();
+  }
+
+  seqs_.clear();
+  seqs_.shrink_to_fit();
+}
+
 /**
  * Sort ComSubseqs for each file.
  *
  * If the sequence of subseqences are sorted, the program can find the maximum
  * common subseqence by checking the continuous seqence.
  *
+ * The sort keys are decided by `GetEnv().getComSubseqOrder()`. With the
+ * diagonal-major order, all ComSubseqs of the same diagonal are contiguous.
+ *
  * @param[in] input_filepaths The list of input filepaths.
  * @param[out] sorted_filepaths The list of output filepaths. The sequences
  *                              of each file is sorted.
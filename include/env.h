@@ -2,8 +2,11 @@
 
 #include <cstdint>
 #include <thread>
+#include <vector>
 
+#include "com_subseq.h"
 #include "pcpe_util.h"
+#include "temp_folder.h"
 
 namespace pcpe {
 
@@ -12,6 +15,12 @@ class Env;
 /// Collect all parameters for the program.
 extern Env gEnv;
 
+/**
+ * Get the configuration of the current run. It's `gEnv` unless a
+ * `RunContext` is installed on the thread.
+ * */
+const Env& GetEnv();
+
 class Env {
  public:
   Env()
@@ -20,16 +29,43 @@ class Env {
         buffer_size_(100 * 1024 * 1024),    // 100 Mbytes
         small_seq_length_(6),               // 6 chars
         mim_output_length_(10),             // 10 chars
+        pair_top_size_(0),                  // all
         thread_size(std::thread::hardware_concurrency()),
-        temp_folder_("./temp") {}
+        memory_limit_(0),                   // no limit
+        temp_budget_(0),                    // no limit
+        numa_(false),
+        resume_(false),
+        incremental_(false),
+        index_result_(false),
+        sort_result_(false),
+        shard_index_(0),
+        shard_size_(1),
+        comsubseq_order_(ComSubseqOrder::kDiagonal),
+        temp_folders_(1, TempFolder("./temp", 1)),
+        temp_placement_(TempPlacement::kRoundRobin) {}
 
   uint32_t getIOBufferSize() const { return io_buffer_size_; }
   uint32_t getSmallSeqLength() const { return small_seq_length_; }
   uint32_t getCompareSeqenceSize() const { return compare_seq_unit_size_; }
   uint32_t getMinimumOutputLength() const { return mim_output_length_; }
+  uint32_t getPairTopSize() const { return pair_top_size_; }
   uint32_t getBufferSize() const { return buffer_size_; }
   uint32_t getThreadsSize() const { return thread_size; }
-  const FilePath& getTempFolderPath() const { return temp_folder_; }
+  uint64_t getMemoryLimit() const { return memory_limit_; }
+  uint64_t getTempBudget() const { return temp_budget_; }
+  bool getNuma() const { return numa_; }
+  bool getResume() const { return resume_; }
+  bool getIncremental() const { return incremental_; }
+  bool getIndexResult() const { return index_result_; }
+  bool getSortResult() const { return sort_result_; }
+  uint32_t getShardIndex() const { return shard_index_; }
+  uint32_t getShardSize() const { return shard_size_; }
+  ComSubseqOrder getComSubseqOrder() const { return comsubseq_order_; }
+  const FilePath& getTempFolderPath() const { return temp_folders_[0].path; }
+  const std::vector<TempFolder>& getTempFolders() const {
+    return temp_folders_;
+  }
+  TempPlacement getTempPlacement() const { return temp_placement_; }
 
   void setIOBufferSize(uint32_t size) {
     io_buffer_size_ =
@@ -39,10 +75,31 @@ class Env {
     buffer_size_ =
         size / (uint32_t)sizeof(uint32_t) * (uint32_t)sizeof(uint32_t);
   }
-  void setTempFolderPath(const FilePath& path) { temp_folder_ = path; }
+  void setTempFolderPath(const FilePath& path) {
+    temp_folders_.assign(1, TempFolder(path, 1));
+  }
+  void setTempFolders(const std::vector<TempFolder>& folders) {
+    if (!folders.empty()) temp_folders_ = folders;
+  }
+  void setTempPlacement(TempPlacement placement) {
+    temp_placement_ = placement;
+  }
   void setCompareSeqenceSize(uint32_t size) { compare_seq_unit_size_ = size; }
   void setMinimumOutputLength(uint32_t size) { mim_output_length_ = size; }
+  void setPairTopSize(uint32_t size) { pair_top_size_ = size; }
   void setThreadSize(uint32_t size) { thread_size = size; }
+  void setMemoryLimit(uint64_t size) { memory_limit_ = size; }
+  void setTempBudget(uint64_t size) { temp_budget_ = size; }
+  void setNuma(bool numa) { numa_ = numa; }
+  void setResume(bool resume) { resume_ = resume; }
+  void setIncremental(bool incremental) { incremental_ = incremental; }
+  void setIndexResult(bool index_result) { index_result_ = index_result; }
+  void setSortResult(bool sort_result) { sort_result_ = sort_result; }
+  void setShard(uint32_t index, uint32_t size) {
+    shard_index_ = index;
+    shard_size_ = size;
+  }
+  void setComSubseqOrder(ComSubseqOrder order) { comsubseq_order_ = order; }
 
  private:
   /// The IO buffer size. The paramemter is used by FileReader/FileWriter.
@@ -60,11 +117,57 @@ class Env {
   /// The minimum output common subseqence length
   uint32_t mim_output_length_;
 
+  /// The number of the longest common subseqences kept for each sequence
+  /// pair (x, y). The size 0 keeps all. See `PairTopComSubseqs`.
+  uint32_t pair_top_size_;
+
   /// The number of threads to execute in parallel.
   uint32_t thread_size;
 
-  /// The path to save all temps generated during the programing exectuion.
-  FilePath temp_folder_;
+  /// The limit of the memory reserved by all running tasks (unit: byte). The
+  /// limit 0 means no limit. See `MemoryBudget`.
+  uint64_t memory_limit_;
+
+  /// The limit of the projected size of the temp files (unit: byte). The
+  /// limit 0 means no limit. See `TaskGraph::setResourceLimit`.
+  uint64_t temp_budget_;
+
+  /// Bind the workers of the thread pool to NUMA nodes. See `ThreadPool`.
+  bool numa_;
+
+  /// Skip the tasks which are finished in the last run. See `Manifest`.
+  bool resume_;
+
+  /// Compute only the pairs with the sequences appended after the last run.
+  /// See `RunIndex`.
+  bool incremental_;
+
+  /// Sort the result file by the sequence pairs and build its lookup index.
+  /// See `BuildLookupIndex`.
+  bool index_result_;
+
+  /// Merge the outputs of the pairs into a globally sorted result file. See
+  /// `ParallelMergeSortedComSubseqFiles`.
+  bool sort_result_;
+
+  /// Compute the `shard_index_`-th of `shard_size_` parts of the chunk pairs.
+  /// See `FindMaxComSubseqs`.
+  uint32_t shard_index_;
+  uint32_t shard_size_;
+
+  /// The sort keys of ComSubseqs for the sort and merge stages. The default
+  /// is the diagonal-major order so the merge stage can find every
+  /// continuous ComSubseq in one pass.
+  ComSubseqOrder comsubseq_order_;
+
+  /// The folders to save all temps generated during the programing
+  /// exectuion. The first one is the main folder, e.g. for the manifest. The
+  /// intermediate files of the pipeline are placed on all folders. See
+  /// `GetTempFilePath`.
+  std::vector<TempFolder> temp_folders_;
+
+  /// How to place the intermediate files on the temp folders.
+  TempPlacement temp_placement_;
 };
 
 }  // namespace pcpe
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+/// The FNV-1a 64-bit checksum of empty data.
+constexpr uint64_t kEmptyChecksum = 14695981039346656037ULL;
+
+/**
+ * Continue the FNV-1a 64-bit checksum with data.
+ *
+ * @param[in] data the data
+ * @param[in] size the size of the data (unit: byte(s))
+ * @param[in,out] checksum the checksum
+ * */
+void UpdateChecksum(const char* data, std::size_t size, uint64_t& checksum);
+
+/**
+ * Get the size and the FNV-1a 64-bit checksum of a file.
+ *
+ * @param[in] filepath the path of the file
+ * @param[out] size the size of the file (unit: byte(s))
+ * @param[out] checksum the checksum of the file
+ *
+ * @return false: the file does not exist or read file error
+ * */
+bool GetFileChecksum(const FilePath& filepath, uint64_t& size,
+                     uint64_t& checksum);
+
+/**
+ * Continue the size and the checksum with the content of a file, i.e. the
+ * size and the checksum of data after the file is appended to the data.
+ *
+ * @param[in] filepath the path of the file
+ * @param[in] max_size read the first `max_size` bytes of the file at most
+ * @param[in,out] size the size of data (unit: byte(s))
+ * @param[in,out] checksum the checksum of data
+ *
+ * @return false: the file does not exist or read file error
+ * */
+bool UpdateFileChecksum(const FilePath& filepath, uint64_t max_size,
+                        uint64_t& size, uint64_t& checksum);
+
+/**
+ * The record of the finished tasks of a pipeline.
+ *
+ * Each entry is the output file of a finished task with the size and the
+ * checksum of the file. An output could be consumed: all tasks which use it
+ * are finished and the file is removed on purpose. A consumed output is
+ * still done.
+ *
+ * The manifest file is a journal. Each change is appended to the file as a
+ * line and synced to the disk, so a change costs the same however many
+ * entries there are. A later line of the same output overrides the earlier
+ * ones. `save` compacts the journal to one line per entry. It's written to
+ * `<filepath>.tmp` first and renamed to `<filepath>`, so the manifest file is
+ * always complete even if the program is killed. The first change after the
+ * manifest is created or loaded also compacts it.
+ *
+ * The signature describes the inputs and the settings of the pipeline. A
+ * manifest of a different signature is not loaded.
+ *
+ * File format (text):
+ *
+ *   pcpe-manifest 1
+ *   <signature>
+ *   <D|C|R>[+] <size> <checksum> <output filepath>
+ *   ...
+ *
+ * `D` is a done output, `C` is a consumed output and `R` removes the record
+ * of the output. A `+` after the state marks that the next line belongs to
+ * the same change. A change is applied only if all its lines are complete,
+ * so a change torn by a crash is ignored when the manifest is loaded.
+ *
+ * All member functions are thread-safe.
+ * */
+class Manifest {
+ public:
+  Manifest(const FilePath& filepath, const std::string& signature)
+      : filepath_(filepath),
+        signature_(signature),
+        entries_(),
+        fd_(-1),
+        mutex_() {}
+  ~Manifest();
+
+  /**
+   * Load the entries of the manifest file.
+   *
+   * @return false: the file does not exist, the format is invalid or the
+   *                signature is different. The manifest is empty.
+   * */
+  bool load();
+
+  /// Save the manifest file atomically and compact the journal.
+  bool save();
+
+  /// Check the output is consumed, or it's recorded and the file is the same
+  /// as the record.
+  bool isDone(const FilePath& output) const;
+
+  /// Check the output is consumed.
+  bool isConsumed(const FilePath& output) const;
+
+  /// Get the size and the checksum of the record. Return false if the output
+  /// is not recorded.
+  bool getRecord(const FilePath& output, uint64_t& size,
+                 uint64_t& checksum) const;
+
+  /// Record the output of a finished task and append it to the manifest.
+  bool record(const FilePath& output);
+
+  /// Record the output with the known size and checksum.
+  bool record(const FilePath& output, uint64_t size, uint64_t checksum);
+
+  /// Mark the output consumed and append it to the manifest.
+  bool consume(const FilePath& output);
+
+  /**
+   * Record that `input` is appended to `output`. The record of `output` is
+   * updated and `input` is consumed in one change, so the two changes are
+   * never loaded partially.
+   * */
+  bool append(const FilePath& output, uint64_t size, uint64_t checksum,
+              const FilePath& input);
+
+  /// Remove the record of the output and append it to the manifest.
+  bool remove(const FilePath& output);
+
+  /// Get the number of entries.
+  std::size_t size() const;
+
+  Manifest(const Manifest&) = delete;
+  Manifest& operator=(const Manifest&) = delete;
+
+ private:
+  struct Entry {
+    Entry() : size(0), checksum(kEmptyChecksum), consumed(false) {}
+
+    uint64_t size;
+    uint64_t checksum;
+    bool consumed;
+  };
+
+  bool saveLocked();
+
+  /// Append the lines of a change to the journal and sync it.
+  bool appendLocked(const std::string& lines);
+
+  const FilePath filepath_;
+  const std::string signature_;
+  std::map<FilePath, Entry> entries_;
+  int fd_;  // the journal opened for appending, or -1
+  mutable std::mutex mutex_;
+};
+
+}  // namespace pcpe
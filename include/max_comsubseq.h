@@ -1,11 +1,128 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
+#include "com_subseq.h"
 #include "pcpe_util.h"
 
 namespace pcpe {
 
+/**
+ * Select the longest `size` maximum common subseqences of each sequence pair
+ * (x, y) from a stream sorted by the pairs.
+ *
+ * The runs of the current pair are kept in a heap of at most `size` entries
+ * whose top is the shortest one, so a run which is not longer than the top of
+ * a full heap is dropped as soon as it's added. The earlier run wins a tie.
+ * When the pair changes, the selected runs are output in the input order so
+ * the output keeps the order of the stream.
+ * */
+class PairTopComSubseqs {
+ public:
+  /// Select the longest `size` runs of each pair. The size 0 selects all.
+  explicit PairTopComSubseqs(uint32_t size)
+      : size_(size), runs_(), next_index_(0) {}
+
+  uint32_t size() const { return size_; }
+
+  /**
+   * Add a run. If the run is of another pair, the selected runs of the last
+   * pair are appended to `seqs` first.
+   * */
+  void add(const ComSubseq& run, std::vector<ComSubseq>& seqs);
+
+  /// Append the selected runs of the current pair to `seqs`.
+  void flush(std::vector<ComSubseq>& seqs);
+
+ private:
+  struct Run {
+    ComSubseq seq;
+    uint64_t index;  // the position of the run in the stream
+  };
+
+  /// Return true if x is selected before y.
+  static bool isBetter(const Run& x, const Run& y) {
+    if (x.seq.getLength() != y.seq.getLength())
+      return x.seq.getLength() > y.seq.getLength();
+
+    return x.index < y.index;
+  }
+
+  uint32_t size_;
+  std::vector<Run> runs_;  // a heap of the runs. The top is the worst one.
+  uint64_t next_index_;
+};
+
+/**
+ * Merge the continuous ComSubseqs of a sorted array in place.
+ *
+ * The length of the first ComSubseq of each run is set to the length of the
+ * run, and `merges[i]` is set to true if `seqs[i]` is merged into a previous
+ * one.
+ *
+ * @param[in,out] seqs The ComSubseqs sorted with
+ *                     `GetEnv().getComSubseqOrder()`.
+ * @param[out] merges The merged flags of at least `seqs_size` entries.
+ * @param[in] seqs_size The number of the ComSubseqs.
+ * */
+void MergeContineousComSubseqs(ComSubseq* seqs, bool* merges,
+                               std::size_t seqs_size);
+
+/**
+ * Merge the continuous ComSubseqs of a sorted stream and write the maximum
+ * common subseqences to a file.
+ *
+ * The writer keeps only the current run in memory. Each input ComSubseq is
+ * compared with the previous one. If they are continuous, the run is extended.
+ * Otherwise, the run is written when its length is larger than or equal to
+ * `GetEnv().getMinimumOutputLength()` and a new run begins. The result is the
+ * same as `MergeContineousComSubseqs` with `WriteMergedComSubseqs`.
+ *
+ * With `GetEnv().getPairTopSize()`, only the longest runs of each sequence
+ * pair are written. See `PairTopComSubseqs`.
+ *
+ * The interface is the same as `ComSubseqFileWriter` so the writer can be used
+ * as the output of the sort stage directly.
+ * */
+class MaxComSubseqFileWriter {
+ public:
+  /// Construct with filepath
+  explicit MaxComSubseqFileWriter(const FilePath& filepath);
+  ~MaxComSubseqFileWriter();
+
+  /// Return true to present a valid write. The input must be sorted.
+  bool writeSeq(const ComSubseq& seq);
+
+  /// Get the path of output file
+  const FilePath& getFilePath() const { return writer_.getFilePath(); }
+
+  /// Write the last run and close the file. Return false if the file is not
+  /// open or a write error happened.
+  bool close();
+
+  bool is_open() const { return writer_.is_open(); }
+
+  MaxComSubseqFileWriter(const MaxComSubseqFileWriter&) = delete;
+  MaxComSubseqFileWriter& operator=(const MaxComSubseqFileWriter&) = delete;
+
+ private:
+  void writeRun();
+
+  /// Write the selected runs of the last pair.
+  void writeTopRuns();
+
+  ComSubseqFileWriter writer_;
+  const uint32_t min_output_length_;
+
+  PairTopComSubseqs top_;
+  std::vector<ComSubseq> top_runs_;  // the selected runs to write
+
+  bool has_run_;
+  ComSubseq run_;   // the first ComSubseq of the run with the run length.
+  ComSubseq last_;  // the last ComSubseq of the run.
+};
+
 /**
  * Find the maximum common subseqences for each file.
  *
@@ -25,8 +142,13 @@ namespace pcpe {
  *      x    y  x_loc  y_loc  len
  *     (2,   1,     2,    0,    7) "BCDEFGHI"
  *
+ * Only the neighbouring ComSubseqs are checked. With the diagonal-major order
+ * (`ComSubseqOrder::kDiagonal`), each diagonal run is contiguous so every
+ * continuous ComSubseqs are merged in one pass.
+ *
  * @param[in] ifilepaths The list of input filepaths. The sequences of each
- *                       file must be sorted.
+ *                       file must be sorted with
+ *                       `GetEnv().getComSubseqOrder()`.
  * @param[out] ofilepaths The list of output filepaths.
  *
  * */
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace pcpe {
+
+/// The minimum size of the IO buffer of a file reader or writer when the
+/// memory budget is not enough.
+constexpr uint64_t kMinIOBufferSize = 64 * 1024;  // 64 Kbytes
+
+/**
+ * A process-wide memory budget.
+ *
+ * Tasks reserve memory from the budget before they allocate large buffers.
+ * A reservation asks for a range of size [min_size, max_size]:
+ *
+ *   - If the budget has `max_size` bytes available, it gets `max_size` bytes.
+ *   - If the budget has less than `max_size` but at least `min_size` bytes,
+ *     it gets all available bytes. The caller shrinks its buffer.
+ *   - Otherwise the caller blocks until other tasks release enough memory.
+ *     The number of tasks running at the same time is throttled.
+ *
+ * If `min_size` is larger than the limit, it's reduced to the limit.
+ *
+ * A thread that already holds a reservation never blocks. It gets at least
+ * `min_size` bytes even if the budget is exceeded. Otherwise a task which
+ * holds a buffer and opens a reader would wait for itself, or a worker which
+ * runs the subtasks of its task while waiting for them would deadlock. A
+ * waiting worker runs only the subtasks of the group it waits for (see
+ * `WaitGroup`), so an unrelated task never runs as a nested reservation.
+ *
+ * A task reserves its working memory when it starts, before it holds
+ * anything. The buffers it opens later (e.g. the readers and the writers) are
+ * nested reservations. The subtasks of a task (e.g. the fork-join sort) do
+ * not reserve memory, so a task holding memory can always finish.
+ *
+ * The limit 0 means no limit. Every reservation gets `max_size` bytes.
+ * */
+class MemoryBudget {
+ public:
+  explicit MemoryBudget(uint64_t limit)
+      : limit_(limit), used_size_(0), peak_size_(0), mutex_(), cv_() {}
+
+  /**
+   * Reserve memory from the budget.
+   *
+   * @param[in] min_size The minimum size the caller can work with.
+   * @param[in] max_size The size the caller wants.
+   * @param[in] nested The caller already holds a reservation. It never
+   *                   blocks.
+   *
+   * @return The reserved size (unit: byte). It's in [min_size, max_size]
+   *         after `min_size` is reduced to the limit.
+   * */
+  uint64_t reserve(uint64_t min_size, uint64_t max_size, bool nested);
+
+  /// Return the reserved memory to the budget.
+  void release(uint64_t size);
+
+  /// Change the limit. The limit 0 means no limit.
+  void setLimit(uint64_t limit);
+
+  uint64_t getLimit() const;
+  uint64_t getUsedSize() const;
+  uint64_t getPeakSize() const;
+
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+ private:
+  uint64_t limit_;      // unit: byte
+  uint64_t used_size_;  // unit: byte
+  uint64_t peak_size_;  // unit: byte
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+/**
+ * Get the process-wide memory budget. The budget is created with
+ * `gEnv.getMemoryLimit()` when the function is called the first time.
+ * */
+MemoryBudget& GetMemoryBudget();
+
+/**
+ * A reservation of a memory budget. The memory is returned to the budget when
+ * the reservation is destroyed.
+ *
+ * A reservation must be destroyed by the thread which creates it.
+ *
+ * Example:
+ *
+ *   MemoryReservation memory(kMinBufferSize, GetEnv().getBufferSize());
+ *   std::vector<ComSubseq> seqs;
+ *   seqs.reserve(memory.size() / sizeof(ComSubseq));
+ * */
+class MemoryReservation {
+ public:
+  /// Reserve memory from the process-wide budget.
+  MemoryReservation(uint64_t min_size, uint64_t max_size)
+      : MemoryReservation(GetMemoryBudget(), min_size, max_size) {}
+
+  MemoryReservation(MemoryBudget& budget, uint64_t min_size,
+                    uint64_t max_size);
+  ~MemoryReservation() { release(); }
+
+  /// Get the reserved size (unit: byte).
+  uint64_t size() const { return size_; }
+
+  /// Return the memory to the budget before the reservation is destroyed.
+  void release();
+
+  MemoryReservation(const MemoryReservation&) = delete;
+  MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+ private:
+  MemoryBudget& budget_;
+  uint64_t size_;
+  bool released_;
+};
+
+}  // namespace pcpe
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+/// A NUMA node and its CPUs.
+struct NumaNode {
+  NumaNode() : id(0), cpus() {}
+  NumaNode(uint32_t pid, const std::vector<uint32_t>& pcpus)
+      : id(pid), cpus(pcpus) {}
+
+  uint32_t id;
+  std::vector<uint32_t> cpus;
+};
+
+/**
+ * Parse a CPU list of sysfs, e.g. `0-3,8-11` or `0,2,4`.
+ *
+ * @param[in] str the CPU list
+ * @param[out] cpus the CPUs in the list
+ *
+ * @return false: the format is invalid
+ *         true: parse successfully
+ * */
+bool ParseCpuList(const std::string& str, std::vector<uint32_t>& cpus);
+
+/**
+ * Get the NUMA nodes from sysfs (`<sysfs_path>/node<N>/cpulist`). The CPUs
+ * which the process is not allowed to run on are removed. The nodes without
+ * any CPU are ignored.
+ *
+ * It does not depend on libnuma.
+ *
+ * @param[out] nodes the NUMA nodes sorted by the node id. It's empty if the
+ *                   system does not provide the information.
+ * @param[in] sysfs_path the path of the node folder of sysfs
+ * */
+void GetNumaNodes(std::vector<NumaNode>& nodes,
+                  const FilePath& sysfs_path = "/sys/devices/system/node");
+
+/**
+ * Bind the current thread to the CPUs.
+ *
+ * Linux allocates a page on the node of the thread which touches the page
+ * first. After a worker is bound to the CPUs of a node, the buffers the
+ * worker allocates and fills are on the same node.
+ *
+ * @return false: the system does not support it or error happened.
+ * */
+bool BindCurrentThread(const std::vector<uint32_t>& cpus);
+
+}  // namespace pcpe
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "pcpe_util.h"
+#include "pipeline.h"
+#include "query.h"
+#include "run_context.h"
+#include "seq.h"
+
+/**
+ * The public API of `libpcpe`.
+ *
+ * The downstream tools could link the library and find the maximum common
+ * subseqences of the sequences in memory rather than run `max_comsubseq` and
+ * parse the result file. The settings are in `gEnv`, or in a `RunContext`
+ * to run several comparisons at the same time.
+ * */
+
+namespace pcpe {
+
+/// Receive a maximum common subseqence.
+using ComSubseqCallback = std::function<void(const ComSubseq&)>;
+
+/**
+ * Find the maximum common subseqences of the sequences in memory and deliver
+ * them to the callback. The x of a ComSubseq is the index in `xs` and the y
+ * is the index in `ys`. The set of the results is the same as the file
+ * pipeline.
+ *
+ * The small-seq hash table of `ys` is built in memory and `xs` is compared in
+ * batches of `GetEnv().getCompareSeqenceSize()` sequences (see `QueryIndex`).
+ * The results are ordered by x and each x is ordered by
+ * `GetEnv().getComSubseqOrder()`.
+ *
+ * Temp files are used only when the hash table takes more than half of
+ * `GetEnv().getMemoryLimit()`. Then the sequences are written to the temp
+ * folders and compared by the file pipeline. The results are delivered in the
+ * order of the result file, and the temp files are removed.
+ *
+ * Example:
+ *
+ *   std::vector<ComSubseq> seqs;
+ *   FindMaxComSubseqs(xs, ys, [&seqs](const ComSubseq& seq) {
+ *     seqs.push_back(seq);
+ *   });
+ *
+ * @param[in] xs the sequences
+ * @param[in] ys the compared sequences
+ * @param[in] callback called with each result in the calling thread
+ *
+ * @return false: the temp files can not be written or the file pipeline
+ *         failed. No result is delivered then.
+ * */
+bool FindMaxComSubseqs(const SeqList& xs, const SeqList& ys,
+                       const ComSubseqCallback& callback);
+
+/// The same as the above function in a run context. The callback is called
+/// in the calling thread.
+bool FindMaxComSubseqs(RunContext& context, const SeqList& xs,
+                       const SeqList& ys, const ComSubseqCallback& callback);
+
+}  // namespace pcpe
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <fstream>
 #include <string>
 
@@ -63,4 +64,30 @@ bool CreateFolder(const char* path);
  * */
 bool CheckFileNotEmpty(const char* path);
 
+/**
+ * Parse a size with an optional unit, e.g. `4096`, `512K`, `100M`, `8G`. The
+ * units are K, M, G and T (powers of 1024) and the suffix `B` is optional
+ * (`100MB`).
+ *
+ * @param[in] str the string to parse
+ * @param[out] size the size (unit: byte(s))
+ *
+ * @return false: the format is invalid
+ *         ture: parse successfully
+ * */
+bool ParseSize(const char* str, uint64_t& size);
+
+/**
+ * Parse a shard `<index>/<size>`, e.g. `0/4`. The index is less than the
+ * size.
+ *
+ * @param[in] str the string to parse
+ * @param[out] index the index of the shard
+ * @param[out] size the number of shards
+ *
+ * @return false: the format is invalid
+ *         ture: parse successfully
+ * */
+bool ParseShard(const char* str, uint32_t& index, uint32_t& size);
+
 }  // namespace pcpe
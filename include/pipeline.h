@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pcpe_util.h"
+#include "run_context.h"
+
+namespace pcpe {
+
+/**
+ * Find the maximum common subseqences of two sequence files.
+ *
+ * The function builds the small-seq hash tables of the two sequence files.
+ * Each pair of hash tables (x chunk, y chunk) is processed by one task from
+ * the beginning to the end:
+ *
+ *   compare -> sort -> merge continuous ComSubseqs
+ *
+ * All tasks are nodes of a task graph. A pair task starts as soon as its two
+ * hash tables are built. It does not wait for the other hash tables.
+ *
+ * The common subseqences of the pair are collected in memory and sorted in
+ * memory. They are spilled to run files only when they are more than
+ * `GetEnv().getBufferSize()` bytes. The compared and sorted ComSubseqs are
+ * never written otherwise. Only the maximum common subseqences are written.
+ *
+ * @param[in] xfilepath The first sequence file.
+ * @param[in] yfilepath The second sequence file.
+ * @param[out] ofilepaths The list of output filepaths. Each file contains the
+ *                        maximum common subseqences of a chunk pair.
+ *
+ * */
+void FindMaxComSubseqs(const FilePath& xfilepath, const FilePath& yfilepath,
+                       std::vector<FilePath>& ofilepaths);
+
+/**
+ * Find the maximum common subseqences of two sequence files and combine them
+ * into one file.
+ *
+ * It's the same as the above function followed by `CombineComSubSeqFiles`.
+ * The output of each chunk pair is appended to the result file as soon as
+ * the pair and all pairs before it are done.
+ *
+ * After the run, the index of the run is saved to
+ * `GetRunIndexFilePath(ofilepath)`. With `GetEnv().getIncremental()`, if the
+ * sequences of the last run are the prefixes of the sequences and the result
+ * file is not changed, only the pairs with the appended sequences are
+ * computed and appended to the result file. The sequence indexes of the
+ * appended results are the indexes in the grown sequence lists.
+ *
+ * With `GetEnv().getSortResult()`, the outputs of the pairs are not appended.
+ * They are merged into a result sorted with `GetEnv().getComSubseqOrder()`
+ * by `ParallelMergeSortedComSubseqFiles` after all pairs are done. The delta
+ * of an incremental run is merged into the sorted result of the base run.
+ *
+ * With `GetEnv().getIndexResult()`, the result file is sorted by the sequence
+ * pairs and indexed by `BuildLookupIndex` after the run.
+ *
+ * With `GetEnv().getShardSize()` > 1, only the pairs of the shard are computed
+ * and the result is written to `GetShardFilePath(ofilepath, ...)` when it's
+ * complete. The shards could run in different processes or machines with
+ * different temp folders. `MergeShardFiles` combines them. The index is not
+ * saved for a shard.
+ *
+ * If an output of a pair can not be appended to the result, the outputs
+ * after it are kept in the temp folder and the index is not saved, so a
+ * shard file is not created and the next incremental run does not use the
+ * incomplete result.
+ *
+ * @param[in] xfilepath The first sequence file.
+ * @param[in] yfilepath The second sequence file.
+ * @param[out] ofilepath The result file.
+ *
+ * @return false: a task failed, the result can not be written or the index
+ *         can not be built or saved.
+ * */
+bool FindMaxComSubseqs(const FilePath& xfilepath, const FilePath& yfilepath,
+                       const FilePath& ofilepath);
+
+/**
+ * Find the maximum common subseqences of two sequence files in a run context
+ * and combine them into one file. The temp folders of the context are
+ * created. The runs of different contexts could run at the same time.
+ *
+ * @return false: the same as the above function.
+ * */
+bool FindMaxComSubseqs(RunContext& context, const FilePath& xfilepath,
+                       const FilePath& yfilepath, const FilePath& ofilepath);
+
+/// Get the run index file of a result file: `<ofilepath>.index`.
+FilePath GetRunIndexFilePath(const FilePath& ofilepath);
+
+/// Get the name of a shard, e.g. `shard-0-of-4`.
+std::string GetShardName(uint32_t index, uint32_t size);
+
+/// Get the result file of a shard: `<ofilepath>.shard-<index>-of-<size>`.
+FilePath GetShardFilePath(const FilePath& ofilepath, uint32_t index,
+                          uint32_t size);
+
+/**
+ * Combine the result files of all shards into the result file in the order
+ * of the shards. The result is the same as the result without shards. With
+ * `GetEnv().getSortResult()`, the sorted shard files are merged instead. With
+ * `GetEnv().getIndexResult()`, the result is indexed by `BuildLookupIndex`.
+ *
+ * @param[in] ofilepath The result file. The shard files are named after it.
+ * @param[in] shard_size The number of shards.
+ *
+ * @return false: a shard file does not exist, the shard files can not be
+ *         combined or the index can not be built.
+ * */
+bool MergeShardFiles(const FilePath& ofilepath, uint32_t shard_size);
+
+}  // namespace pcpe
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "com_subseq.h"
+#include "pcpe_util.h"
+#include "seq.h"
+#include "small_seq_hash.h"
+
+namespace pcpe {
+
+/// The maximum common subseqences of a query and its latency.
+struct QueryResult {
+  QueryResult() : seqs(), latency(0) {}
+
+  /// The x of a ComSubseq is the index of the query and the y is the index of
+  /// the reference sequence. The order is `GetEnv().getComSubseqOrder()`.
+  std::vector<ComSubseq> seqs;
+
+  /// The time to compare and merge the query (unit: microsecond(s)). In a
+  /// batch, it includes the scan shared by the batch.
+  uint64_t latency;
+};
+
+/// A query sequence of a batch and the x of its result ComSubseqs.
+struct QuerySeq {
+  QuerySeq() : seq(nullptr), index(0) {}
+  QuerySeq(const Seq* pseq, uint32_t pindex) : seq(pseq), index(pindex) {}
+
+  const Seq* seq;
+  uint32_t index;
+};
+
+/**
+ * A resident in-memory small-seq hash table of the reference sequences for
+ * low-latency queries.
+ *
+ * The index is built once. Each query is compared with the hash table and its
+ * ComSubseqs are sorted and merged in memory, so no temp file is used. The
+ * result of the queries is the same as `FindMaxComSubseqs` with the queries as
+ * the x sequences and the reference as the y sequences. The pipeline is
+ * better for large query sets.
+ *
+ * `query` does not modify the index, so the queries could run in different
+ * threads at the same time.
+ * */
+class QueryIndex {
+ public:
+  QueryIndex() : seqs_(), small_seqs_(), small_seq_size_(0) {}
+
+  /**
+   * Build the index of the sequences of a sequence file.
+   *
+   * @return false: the file does not exist
+   * */
+  bool load(const FilePath& filepath);
+
+  /// Build the index of the reference sequences.
+  void build(const SeqList& seqs);
+
+  /**
+   * Find the maximum common subseqences of a query and the reference.
+   *
+   * @param[in] query the query sequence
+   * @param[in] query_index the x of the result ComSubseqs
+   * @param[out] seqs the maximum common subseqences which are longer than or
+   *                  equal to `GetEnv().getMinimumOutputLength()`
+   * */
+  void query(const Seq& query, uint32_t query_index,
+             std::vector<ComSubseq>& seqs) const;
+
+  /**
+   * Query each sequence of the list one by one, so the latency of a query is
+   * its own. The index of a query is its index in the list.
+   *
+   * @param[in] queries the query sequences
+   * @param[out] results the results of the queries
+   * */
+  void query(const SeqList& queries, std::vector<QueryResult>& results) const;
+
+  /**
+   * Query a batch of sequences with one scan of the index. The small seqences
+   * of all queries are sorted, so each distinct small seqence is looked up
+   * once and the index is visited in order. Then the ComSubseqs of each query
+   * are sorted and merged.
+   *
+   * @param[in] queries the query sequences, e.g. the queries of different
+   *                    requests
+   * @param[out] results the results in the order of the queries
+   * */
+  void query(const std::vector<QuerySeq>& queries,
+             std::vector<QueryResult>& results) const;
+
+  /// Get the reference sequences.
+  const SeqList& getSequences() const { return seqs_; }
+
+  /// Get the number of small seqences in the index.
+  uint64_t getSmallSeqSize() const { return small_seq_size_; }
+
+  QueryIndex(const QueryIndex&) = delete;
+  QueryIndex& operator=(const QueryIndex&) = delete;
+
+ private:
+  SeqList seqs_;
+  SmallSeqList small_seqs_;
+  uint64_t small_seq_size_;
+};
+
+}  // namespace pcpe
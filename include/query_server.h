@@ -0,0 +1,162 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pcpe_util.h"
+#include "query.h"
+#include "seq.h"
+
+namespace pcpe {
+
+/// The magic number of a query request ("PCPQ").
+constexpr uint32_t kQueryRequestMagic = 0x51504350;
+
+/// The maximum number of queries of a request.
+constexpr uint32_t kMaxRequestQuerySize = 1 << 20;
+
+/// The maximum length of a query sequence.
+constexpr uint32_t kMaxQueryLength = 1 << 24;
+
+/// The status of a query response.
+enum class QueryStatus : uint32_t {
+  kOk = 0,
+
+  /// The index id does not exist.
+  kInvalidIndex = 1
+};
+
+/**
+ * A server which holds the query indexes resident and serves the queries over
+ * a Unix domain socket.
+ *
+ * Protocol (binary, native byte order since the socket is local). A client
+ * could send any number of requests on one connection. Each request gets one
+ * response in order.
+ *
+ *   request:  uint32 magic (`kQueryRequestMagic`)
+ *             uint32 index id
+ *             uint32 query size
+ *             for each query: uint32 length, char[length] sequence
+ *
+ *   response: uint32 status (`QueryStatus`)
+ *             uint32 query size
+ *             for each query: uint64 latency (unit: microsecond(s)),
+ *                             uint32 result size, ComSubseq[result size]
+ *
+ * The x of a result ComSubseq is the index of the query in the request. A
+ * malformed request closes the connection.
+ *
+ * Each connection is served by its own thread, which queues the request. One
+ * batch thread takes all queued requests at a time and queries the requests
+ * of the same index as one batch, so the concurrent requests share a single
+ * scan of the index (see `QueryIndex::query`). With a batch window, the batch
+ * thread waits for more requests after the first one of a batch.
+ * */
+class QueryServer {
+ public:
+  explicit QueryServer(const FilePath& socket_path);
+  ~QueryServer() { stop(); }
+
+  /**
+   * Add a resident index. The id of an index is the order it's added, from 0.
+   * The indexes must be added before `start`.
+   * */
+  void addIndex(std::unique_ptr<QueryIndex> index);
+
+  /**
+   * Wait up to `window` (unit: microsecond(s)) after the first request of a
+   * batch, until `max_requests` requests are queued. The window 0 queries the
+   * queued requests at once. It must be set before `start`.
+   * */
+  void setBatchWindow(uint64_t window, std::size_t max_requests);
+
+  /**
+   * Listen on the socket and serve the requests in the background. An
+   * existing file of the socket path is replaced.
+   *
+   * @return false: the socket can not be created
+   * */
+  bool start();
+
+  /// Close the connections, wait for the threads and remove the socket file.
+  void stop();
+
+  /// Get the number of the batches which have been queried.
+  uint64_t getBatchSize() const;
+
+  /// Get the largest number of requests which have been queried in a batch.
+  std::size_t getMaxBatchRequestSize() const;
+
+  QueryServer(const QueryServer&) = delete;
+  QueryServer& operator=(const QueryServer&) = delete;
+
+ private:
+  /// A request waiting for its batch.
+  struct Request {
+    Request() : index_id(0), queries(), results(), done(false) {}
+
+    uint32_t index_id;
+    SeqList queries;
+    std::vector<QueryResult> results;
+    bool done;
+  };
+
+  /// A connection of a client.
+  struct Connection {
+    Connection() : fd(-1), thread(), finished(false) {}
+
+    int fd;
+    std::thread thread;
+    bool finished;
+  };
+
+  void acceptConnections();
+  void serveConnection(Connection* connection);
+  void runBatches();
+
+  /// Wait until the request is queried by a batch.
+  void query(Request& request);
+
+  const FilePath socket_path_;
+  std::vector<std::unique_ptr<QueryIndex>> indexes_;
+
+  int listen_fd_;
+  bool stopped_;
+  bool batch_stopped_;
+  std::thread accept_thread_;
+  std::thread batch_thread_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable request_cv_;
+  std::condition_variable done_cv_;
+  std::deque<Request*> requests_;
+  std::list<Connection> connections_;
+  uint64_t batch_size_;
+
+  uint64_t batch_window_;  // unit: microsecond(s)
+  std::size_t batch_max_requests_;
+  std::size_t max_batch_request_size_;
+};
+
+/**
+ * Send the queries to a `QueryServer` and receive the results, e.g. a
+ * stand-in client of the annotation service.
+ *
+ * @param[in] socket_path the path of the socket of the server
+ * @param[in] index_id the id of the index on the server
+ * @param[in] queries the query sequences
+ * @param[out] results the results of the queries
+ *
+ * @return false: the connection fails or the server rejects the request
+ * */
+bool SendQueries(const FilePath& socket_path, uint32_t index_id,
+                 const SeqList& queries, std::vector<QueryResult>& results);
+
+}  // namespace pcpe
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+/**
+ * Read the ids of the sequences from an id file (`*_id_css.txt`). The first
+ * line is the number of sequences and each line is the ids of a sequence,
+ * e.g. `2 id1 id2`. The ids of a sequence are joined with commas.
+ *
+ * @param[in] filepath the path of the id file
+ * @param[out] ids the ids of each sequence
+ *
+ * @return false: the file does not exist or the format is invalid
+ * */
+bool ReadSequenceIds(const FilePath& filepath, std::vector<std::string>& ids);
+
+/**
+ * Export a result file (an array of ComSubseqs) to TSV. The first line is the
+ * header `x y x_loc y_loc length` and each line is a ComSubseq.
+ *
+ * The result file is memory-mapped and split into chunks. The chunks are
+ * formatted by the thread pool in parallel and written in order, so the
+ * output is the same as a sequential export.
+ *
+ * @param[in] ifilepath the result file
+ * @param[in] x_ids the ids of the x sequences. The x column is the index of
+ *                  the sequence if it's empty.
+ * @param[in] y_ids the ids of the y sequences. The y column is the index of
+ *                  the sequence if it's empty.
+ * @param[in] fd the output file descriptor, e.g. `STDOUT_FILENO`
+ *
+ * @return false: the input can not be read, the output can not be written,
+ *         or an index is out of the range of the ids
+ * */
+bool ExportComSubseqFile(const FilePath& ifilepath,
+                         const std::vector<std::string>& x_ids,
+                         const std::vector<std::string>& y_ids, int fd);
+
+/**
+ * Export a result file to a TSV file. See the above function.
+ *
+ * @param[in] ofilepath the TSV file. `-` is the standard output.
+ * */
+bool ExportComSubseqFile(const FilePath& ifilepath,
+                         const std::vector<std::string>& x_ids,
+                         const std::vector<std::string>& y_ids,
+                         const FilePath& ofilepath);
+
+}  // namespace pcpe
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "com_subseq.h"
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+/// Get the lookup index file of a result file: `<filepath>.lookup`.
+FilePath GetLookupIndexFilePath(const FilePath& filepath);
+
+/**
+ * Sort a result file by the sequence pairs (x, y) in place and build its
+ * lookup index, so the ComSubseqs of a sequence are read without scanning
+ * the file.
+ *
+ * The file is sorted with `ComSubseqSortBuffer`. The spilled runs are placed
+ * next to the file (`<filepath>.sort_run_<n>`). The ComSubseqs of the same
+ * pair keep the order of `GetEnv().getComSubseqOrder()`.
+ *
+ * File format of the index (binary, uint64_t):
+ *
+ *   <the number of ComSubseqs of the result file>
+ *   <offset of x = 0> <offset of x = 1> ... <offset of x = n - 1> <end>
+ *
+ * The offset of x is the index of the first ComSubseq whose x is not less
+ * than x, so the ComSubseqs of x are [offset(x), offset(x + 1)). n is the
+ * maximum x of the result plus one.
+ *
+ * @return false: the file can not be read or written.
+ * */
+bool BuildLookupIndex(const FilePath& filepath);
+
+/**
+ * Read the ComSubseqs of the sequence x from an indexed result file. It reads
+ * two offsets of the index and the ComSubseqs of x only.
+ *
+ * @param[in] filepath the result file. It's indexed by `BuildLookupIndex`.
+ * @param[in] x the index of the x sequence
+ * @param[out] seqs the ComSubseqs of x. It's empty if x has no ComSubseqs.
+ *
+ * @return false: the index does not exist or it's out of date.
+ * */
+bool LookupComSubseqs(const FilePath& filepath, uint32_t x,
+                      std::vector<ComSubseq>& seqs);
+
+/**
+ * Read the ComSubseqs of the sequence pair (x, y) from an indexed result
+ * file. The range of the pair in the ComSubseqs of x is found with binary
+ * search, so only O(log n) ComSubseqs are read besides the result.
+ * */
+bool LookupComSubseqs(const FilePath& filepath, uint32_t x, uint32_t y,
+                      std::vector<ComSubseq>& seqs);
+
+}  // namespace pcpe
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "env.h"
+
+namespace pcpe {
+
+class ThreadPool;
+
+/// The statistics of a run.
+struct RunStats {
+  RunStats() : task_size(0), task_time(0), temp_peak(0) {}
+
+  /// The number of the executed tasks.
+  std::atomic<uint64_t> task_size;
+
+  /// The total execution time of the tasks (unit: microsecond(s)).
+  std::atomic<uint64_t> task_time;
+
+  /// The peak of the projected size of the temp files of the last task graph
+  /// (unit: byte). See `TaskGraph::getResourcePeak`.
+  std::atomic<uint64_t> temp_peak;
+};
+
+/**
+ * The context of a run: the configuration, the temp namespace, the thread
+ * pool and the statistics.
+ *
+ * The stages read the configuration of the current context with `GetEnv()`
+ * rather than `gEnv`. A context is installed on a thread with
+ * `ScopedRunContext`, and `ThreadPool::submit` installs the context of the
+ * submitter for the task, so every task of a run sees the context of the
+ * run. A thread without an installed context uses the default context of
+ * `gEnv` and the process-wide thread pool.
+ *
+ * The runs of different contexts could run in one process at the same time
+ * and share one thread pool. The temp files of a context with a name are in
+ * the subfolder `<temp folder>/<name>` of each temp folder, so the runs do not
+ * clobber the temp files of each other. The memory budget is still
+ * process-wide (see `MemoryBudget`).
+ *
+ * Example:
+ *
+ *   RunContext context("job-1");
+ *   context.getEnv().setMinimumOutputLength(12);
+ *   FindMaxComSubseqs(context, xfilepath, yfilepath, ofilepath);
+ * */
+class RunContext {
+ public:
+  /**
+   * Create a context with a copy of the configuration.
+   *
+   * @param[in] name the temp namespace. The empty name shares the temp
+   *                 folders of `env`.
+   * @param[in] env the configuration
+   * @param[in] pool the thread pool. The process-wide thread pool is used if
+   *                 it's nullptr.
+   * */
+  explicit RunContext(const std::string& name, const Env& env = gEnv,
+                      ThreadPool* pool = nullptr);
+
+  Env& getEnv() { return *env_; }
+  const Env& getEnv() const { return *env_; }
+  const std::string& getName() const { return name_; }
+  RunStats& getStats() { return stats_; }
+  const RunStats& getStats() const { return stats_; }
+
+  /// Get the thread pool of the context.
+  ThreadPool& getThreadPool() const;
+
+  /// Get a new index for the names of the temp files of the context.
+  std::size_t getNextTempIndex() { return temp_index_++; }
+
+  /// Create the temp folders of the configuration if they do not exist.
+  void createTempFolders() const;
+
+  RunContext(const RunContext&) = delete;
+  RunContext& operator=(const RunContext&) = delete;
+
+ private:
+  friend RunContext& GetRunContext();
+
+  /// The default context of `gEnv`.
+  RunContext();
+
+  const std::string name_;
+  std::unique_ptr<Env> own_env_;
+  Env* env_;
+  ThreadPool* pool_;
+  RunStats stats_;
+  std::atomic<std::size_t> temp_index_;
+};
+
+/// Get the context installed on the current thread, or the default context.
+RunContext& GetRunContext();
+
+/// Get the context installed on the current thread, or nullptr.
+RunContext* GetCurrentRunContext();
+
+/**
+ * Install a context on the current thread in a scope. The previous context
+ * is restored when the scope ends.
+ * */
+class ScopedRunContext {
+ public:
+  /// Install the context. nullptr installs the default context.
+  explicit ScopedRunContext(RunContext* context);
+  explicit ScopedRunContext(RunContext& context)
+      : ScopedRunContext(&context) {}
+  ~ScopedRunContext();
+
+  ScopedRunContext(const ScopedRunContext&) = delete;
+  ScopedRunContext& operator=(const ScopedRunContext&) = delete;
+
+ private:
+  RunContext* previous_;
+};
+
+}  // namespace pcpe
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "pcpe_util.h"
+#include "seq.h"
+
+namespace pcpe {
+
+/**
+ * Get the FNV-1a 64-bit checksum of the first `size` sequences of the list.
+ * The sequences are separated by line breaks.
+ * */
+uint64_t GetSeqListChecksum(const SeqList& seqs, std::size_t size);
+
+/**
+ * Get the settings which decide the result of a run, i.e. the small seq
+ * length, the minimum output length, the order of ComSubseqs, the number of
+ * the runs kept for each pair and whether the result is sorted. The chunk
+ * size is not included since the result does not depend on it.
+ * */
+std::string GetRunSettings();
+
+/**
+ * The index of a finished run. It records the sequences which are compared
+ * and the result file, so a later run with appended sequences can compute
+ * only the pairs with the new sequences.
+ *
+ * File format (text):
+ *
+ *   pcpe-index 1
+ *   <settings>
+ *   x <sequence size> <checksum>
+ *   y <sequence size> <checksum>
+ *   result <size> <checksum>
+ * */
+struct RunIndex {
+  RunIndex()
+      : settings(),
+        x_size(0),
+        x_checksum(0),
+        y_size(0),
+        y_checksum(0),
+        result_size(0),
+        result_checksum(0) {}
+
+  /**
+   * Load the index file.
+   *
+   * @return false: the file does not exist or the format is invalid.
+   * */
+  bool load(const FilePath& filepath);
+
+  /// Save the index file atomically.
+  bool save(const FilePath& filepath) const;
+
+  /**
+   * Check the run is the base of a run with the sequences and the result
+   * file: the settings are the same, the recorded sequences are the prefix of
+   * the sequences, and the recorded result is the prefix of the result file.
+   * */
+  bool isBaseOf(const SeqList& xs, const SeqList& ys,
+                const FilePath& result_filepath) const;
+
+  std::string settings;
+
+  std::size_t x_size;
+  uint64_t x_checksum;
+  std::size_t y_size;
+  uint64_t y_checksum;
+
+  uint64_t result_size;
+  uint64_t result_checksum;
+};
+
+}  // namespace pcpe
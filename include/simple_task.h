@@ -2,21 +2,33 @@
 
 /**
  * The purpose of the RunSimpleTasks is to keep eyerything as simple as
- * possible.  The project is not a large project so just to implement a simple
- * thread pool to execute all tasks.
+ * possible. All tasks are submitted to the work-stealing thread pool of the
+ * current run (`RunContext::getThreadPool`). A task can submit subtasks to
+ * the same pool and wait for them with a `WaitGroup`, idle workers steal the
+ * subtasks.
  * */
-#include <atomic>
-#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 #include "env.h"
 #include "logging.h"
+#include "run_context.h"
+#include "thread_pool.h"
 
 namespace pcpe {
 
 /**
  * Run all tasks `exec()` function in parallel.
  *
+ * If the task type has a `uint64_t cost() const` member function, the tasks
+ * are dispatched in the order of the longest processing time first so a large
+ * task picked up last does not decide the wall time of the stage. The
+ * predicted cost and the actual time of each task are logged.
+ *
  * @param[in] tasks The list of tasks. The `Type` is pointer type. It could be
  *                  raw pointer, shared pointer or unique pointer.
  *
@@ -40,39 +52,85 @@ void RunSimpleTasks(ContainerType<Type, AllocType>& tasks);
 void GetStepsToNumber(const std::size_t n, const std::size_t step,
                       std::vector<std::size_t>& steps);
 
+/// Get the estimated cost of the task if the task has `cost()`.
+template <typename PointerType>
+auto GetTaskCost(const PointerType& task, int)
+    -> decltype(static_cast<uint64_t>(task->cost())) {
+  return static_cast<uint64_t>(task->cost());
+}
+
+template <typename PointerType>
+uint64_t GetTaskCost(const PointerType&, long) {
+  return 0;
+}
+
+/// Return true if the task has `cost()`.
+template <typename PointerType>
+auto HasTaskCost(const PointerType& task, int)
+    -> decltype(static_cast<void>(task->cost()), true) {
+  return true;
+}
+
+template <typename PointerType>
+bool HasTaskCost(const PointerType&, long) {
+  return false;
+}
+
 template <typename Type, typename AllocType,
           template <typename, typename> class ContainerType>
-void RunSimpleTasksInternal(ContainerType<Type, AllocType>& tasks,
-                            std::atomic_uint& curr_max_index) {
+void RunSimpleTasks(ContainerType<Type, AllocType>& tasks) {
   using SizeType = typename ContainerType<Type, AllocType>::size_type;
-  using PointerType = typename std::pointer_traits<Type>::pointer;
 
-  SizeType tasks_size = tasks.size();
-  SizeType curr_index = 0;
+  // Estimate the costs and dispatch the longest task first. The order is
+  // stable so the tasks without cost keep the original order.
+  std::vector<uint64_t> costs(tasks.size(), 0);
+  bool has_cost = false;
+  for (SizeType i = 0; i < tasks.size(); ++i) {
+    if (tasks[i] == nullptr) continue;
 
-  while ((curr_index = curr_max_index.fetch_add(1)) < tasks_size) {
-    PointerType& task = tasks[curr_index];
+    has_cost = HasTaskCost(tasks[i], 0);
+    costs[i] = GetTaskCost(tasks[i], 0);
+  }
+
+  std::vector<SizeType> order(tasks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(),
+      [&costs](SizeType x, SizeType y) { return costs[x] > costs[y]; });
+
+  ThreadPool& pool = GetRunContext().getThreadPool();
+  WaitGroup wg;
 
-    if (task == nullptr) {
+  for (SizeType curr_index : order) {
+    if (tasks[curr_index] == nullptr) {
       LOG_WARNING() << "The job " << curr_index << " is empty." << std::endl;
       continue;
     }
 
-    task->exec();
-  }
-}
+    Type* task = &tasks[curr_index];
+    const uint64_t cost = costs[curr_index];
+    pool.submit(
+        [task, cost, curr_index, has_cost]() {
+          auto start = std::chrono::steady_clock::now();
+          (*task)->exec();
+          auto end = std::chrono::steady_clock::now();
 
-template <typename Type, typename AllocType,
-          template <typename, typename> class ContainerType>
-void RunSimpleTasks(ContainerType<Type, AllocType>& tasks) {
-  std::vector<std::thread> ts(gEnv.getThreadsSize());
-  std::atomic_uint task_index(0);
+          const uint64_t time = static_cast<uint64_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(end -
+                                                                    start)
+                  .count());
+          RunStats& stats = GetRunContext().getStats();
+          stats.task_size++;
+          stats.task_time += time;
 
-  for (auto& t : ts)
-    t = std::thread(RunSimpleTasksInternal<Type, AllocType, ContainerType>,
-                    std::ref(tasks), std::ref(task_index));
+          if (has_cost)
+            LOG_INFO() << "Task " << curr_index << ": predicted cost " << cost
+                       << ", actual time " << time << " us" << std::endl;
+        },
+        wg);
+  }
 
-  for (auto& t : ts) t.join();
+  wg.wait();
 }
 
 }  // namespace pcpe
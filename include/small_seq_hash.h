@@ -1,17 +1,19 @@
 #pragma once
 
 #include <cstdint>
+#include <istream>
 #include <map>
 #include <memory>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "com_subseq.h"
+#include "env.h"
+#include "memory_budget.h"
 #include "pcpe_util.h"
 #include "seq.h"
 
-#include <cstdint>
-
 namespace pcpe {
 
 struct SeqLoc;
@@ -62,6 +64,7 @@ class SmallSeqHashFileReader {
   FileSize file_size_;       // unit: byte
   FileSize curr_read_size_;  // unit: byte
 
+  MemoryReservation memory_;
   const std::size_t max_buffer_size_;  // unit: byte
   std::size_t buffer_size_;
   std::unique_ptr<uint8_t[]> buffer_;
@@ -82,11 +85,13 @@ class SmallSeqHashFileWriter {
   /// Get the path of output file
   const FilePath& getPath() const { return filepath_; }
 
-  void close() {
-    if (!outfile_.is_open()) return;
+  /// Return false if the file is not open or a write error happened.
+  bool close() {
+    if (!outfile_.is_open()) return false;
 
     writeBuffer();
     outfile_.close();
+    return outfile_.good();
   }
 
   bool is_open() { return outfile_.is_open(); }
@@ -97,6 +102,7 @@ class SmallSeqHashFileWriter {
   const FilePath filepath_;
   std::ofstream outfile_;
 
+  MemoryReservation memory_;
   const std::size_t max_buffer_size_;  // unit: byte
   std::size_t buffer_size_;            // unit: byte
   std::unique_ptr<uint8_t[]> buffer_;
@@ -127,6 +133,161 @@ constexpr SmallSeqHashIndex HashSmallSeq(const char* s) {
       (s[5] - 'A') * 11881376); /* 26 ** 5 == 11881376 */
 }
 
+/**
+ * Read the sequences from a sequence file (`*_seq_css.txt`).
+ *
+ * @param[in] filepath the path of the sequence file
+ * @param[out] seqs the sequences
+ * */
+void ReadSequences(const FilePath& filepath, SeqList& seqs);
+
+/**
+ * Write the sequences to a sequence file which `ReadSequences` can read.
+ *
+ * @param[in] filepath the path of the sequence file
+ * @param[in] seqs the sequences
+ *
+ * @return false: the file can not be written
+ * */
+bool WriteSequences(const FilePath& filepath, const SeqList& seqs);
+
+/**
+ * Read the sequences in the format of a sequence file from a stream.
+ *
+ * @param[in] in the stream, e.g. `std::cin`
+ * @param[out] seqs the sequences
+ * */
+void ReadSequences(std::istream& in, SeqList& seqs);
+
+/**
+ * Construct the small-seq hash table of the sequences [seqs_begin, seqs_end)
+ * in memory.
+ *
+ * @param[in] seqs the sequences
+ * @param[in] seqs_begin the index of the first sequence
+ * @param[in] seqs_end the index after the last sequence
+ * @param[out] smallseqs the hash table
+ * */
+void ConstructSmallSeqs(const SeqList& seqs, std::size_t seqs_begin,
+                        std::size_t seqs_end, SmallSeqList& smallseqs);
+
+/**
+ * Get the number of small seqences of the sequences [ss_begin, ss_end). It's
+ * the number of entries of the hash table of the sequences.
+ *
+ * @param[in] ss the sequences
+ * @param[in] ss_begin the index of the first sequence
+ * @param[in] ss_end the index after the last sequence
+ *
+ * @return the number of small seqences
+ * */
+uint64_t GetSmallSeqSize(const SeqList& ss, std::size_t ss_begin,
+                         std::size_t ss_end);
+
+/**
+ * Estimate the memory size of the hash table (`SmallSeqList`) of
+ * `entries_size` small seqences.
+ *
+ * Each key takes a node of the tree and an allocation of its list besides the
+ * entries. The number of keys is the number of entries at most. A list grows
+ * by doubling, so it takes two times of its entries at most.
+ *
+ * @param[in] entries_size the number of small seqences (`GetSmallSeqSize`)
+ *
+ * @return the estimated size (unit: byte)
+ * */
+uint64_t EstimateSmallSeqsMemorySize(uint64_t entries_size);
+
+/**
+ * Estimate the number of entries (`SeqLoc`) of a hash table file from the
+ * file size.
+ *
+ * @param[in] filepath the path of the hash table file
+ *
+ * @return the estimated number of entries. Return 0 if the file does not
+ *         exist.
+ * */
+uint64_t EstimateHashTableFileEntrySize(const FilePath& filepath);
+
+/**
+ * Construct the small-seq hash table file of the sequences [ss_begin, ss_end).
+ *
+ * @param[in] ss the sequences
+ * @param[in] ss_begin the index of the first sequence
+ * @param[in] ss_end the index after the last sequence
+ * @param[out] output the path of the hash table file
+ *
+ * @return false: the hash table file can not be written.
+ * */
+bool CreateHashTableFile(const SeqList& ss, std::size_t ss_begin,
+                         std::size_t ss_end, const FilePath& output);
+
+/**
+ * Construct the small-seq hash table files of a sequence file. Each file
+ * contains `GetEnv().getCompareSeqenceSize()` sequences at most.
+ *
+ * @param[in] filepath the path of the sequence file
+ * @param[out] hash_filepaths the list of hash table files
+ * */
+void ConstructSmallSeqHash(const FilePath& filepath,
+                           std::vector<FilePath>& hash_filepaths);
+
+/**
+ * Find the fix-sized common subseqences of two small-seq hash table files and
+ * write them with the writer.
+ *
+ * The `Writer` could be any type with a `writeSeq(const ComSubseq&)` member
+ * function, e.g. `ComSubseqFileWriter` or `ComSubseqSortBuffer`.
+ *
+ * @param[in] x_filepath the small-seq hash table
+ * @param[in] y_filepath the compared small-seq hash table
+ * @param[out] writer the output of the common subseqences
+ * */
+template <typename Writer>
+void CompareHashTableFiles(const FilePath& x_filepath,
+                           const FilePath& y_filepath, Writer& writer) {
+  const uint32_t small_seq_length = GetEnv().getSmallSeqLength();
+  auto write_comsubseq = [small_seq_length](const SeqLocList& x_value,
+                                            const SeqLocList& y_value,
+                                            Writer& w) {
+    for (const auto& x : x_value) {
+      for (const auto& y : y_value) {
+        w.writeSeq(ComSubseq(x.idx, y.idx, x.loc, y.loc, small_seq_length));
+      }
+    }
+  };
+
+  SmallSeqHashFileReader x_reader(x_filepath);
+  SmallSeqHashFileReader y_reader(y_filepath);
+
+  std::pair<SmallSeqHashIndex, SeqLocList> x_entry;
+  x_reader.readEntry(x_entry);
+
+  std::pair<SmallSeqHashIndex, SeqLocList> y_entry;
+  y_reader.readEntry(y_entry);
+
+  while (!x_reader.eof() || !y_reader.eof()) {
+    if (x_entry.first == y_entry.first) {
+      write_comsubseq(x_entry.second, y_entry.second, writer);
+
+      if (!x_reader.eof()) x_reader.readEntry(x_entry);
+      if (!y_reader.eof()) y_reader.readEntry(y_entry);
+    }
+    else if (x_reader.eof())                y_reader.readEntry(y_entry);
+    else if (y_reader.eof())                x_reader.readEntry(x_entry);
+    else if (x_entry.first > y_entry.first) y_reader.readEntry(y_entry);
+    else if (x_entry.first < y_entry.first) x_reader.readEntry(x_entry);
+  }
+
+  // Deal the last entry
+  if (x_entry.first == y_entry.first) {
+    write_comsubseq(x_entry.second, y_entry.second, writer);
+  }
+
+  x_reader.close();
+  y_reader.close();
+}
+
 /**
  * Find the fix-sized commom subseqences from the two sequence files.
  *
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace pcpe {
+
+class ThreadPool;
+class WaitGroup;
+
+/**
+ * A directed acyclic graph of tasks.
+ *
+ * Each task runs after all tasks it depends on are done. When a task is done,
+ * the successors whose dependencies are all done are submitted to the thread
+ * pool immediately. There is no barrier between the stages of a pipeline: a
+ * downstream task starts as soon as its own inputs exist.
+ *
+ * Each task has an optional estimated cost. When a worker is free, it runs
+ * the ready task with the largest cost (longest processing time first). The
+ * predicted cost and the actual time of each task with a cost are logged.
+ *
+ * A released task prefers the NUMA node of the worker which finished its
+ * last dependency, i.e. the node which produced its input. A free worker
+ * runs the largest ready task of its own node or without a preference
+ * before the tasks of the other nodes.
+ *
+ * Each task could also hold a size of a limited resource, e.g. the temp disk
+ * space of its output. The size is held from the start of the task until the
+ * caller releases it by `releaseResource`, e.g. when the output is deleted.
+ * With a resource limit, a ready task which does not fit is postponed until
+ * a running task finishes. If no task is running, the largest postponed task
+ * runs anyway so the graph never stalls.
+ *
+ * Example:
+ *
+ *   TaskGraph graph;
+ *   auto a = graph.addTask([]() { ... });
+ *   auto b = graph.addTask([]() { ... });
+ *   auto c = graph.addTask([]() { ... });
+ *   graph.addDependency(a, c);  // c runs after a
+ *   graph.addDependency(b, c);  // c runs after b
+ *   graph.run();
+ * */
+class TaskGraph {
+ public:
+  using NodeId = std::size_t;
+  using Task = std::function<void()>;
+
+  TaskGraph()
+      : nodes_(),
+        ready_mutex_(),
+        ready_(),
+        postponed_(),
+        running_size_(0),
+        deferred_size_(0),
+        resource_limit_(0),
+        resource_size_(0),
+        resource_peak_(0) {}
+
+  /**
+   * Add a task and return the id of the node.
+   *
+   * @param[in] task The task.
+   * @param[in] cost The estimated cost of the task. The unit is decided by
+   *                 the caller. It's only compared with the costs of the
+   *                 other tasks.
+   * @param[in] resource The size of the resource held by the task.
+   * */
+  NodeId addTask(Task task, uint64_t cost = 0, uint64_t resource = 0);
+
+  /// The task `to` runs after the task `from` is done.
+  void addDependency(NodeId from, NodeId to);
+
+  /// Get the number of tasks.
+  std::size_t size() const { return nodes_.size(); }
+
+  /// Set the limit of the resource held by the tasks. The limit 0 means no
+  /// limit.
+  void setResourceLimit(uint64_t limit);
+
+  /// Release the resource held by a task. It's thread-safe.
+  void releaseResource(uint64_t size);
+
+  /// Get the peak size of the held resource.
+  uint64_t getResourcePeak();
+
+  /// Run all tasks on the process-wide thread pool and wait for them.
+  void run();
+
+  /// Run all tasks on the thread pool and wait for them.
+  void run(ThreadPool& pool);
+
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+ private:
+  struct Node {
+    Node(Task t, uint64_t c, uint64_t r)
+        : task(std::move(t)),
+          cost(c),
+          resource(r),
+          successors(),
+          dependency_size(0),
+          remaining(0) {}
+
+    Task task;
+    uint64_t cost;
+    uint64_t resource;
+    std::vector<NodeId> successors;
+    std::size_t dependency_size;
+    std::atomic<std::size_t> remaining;
+  };
+
+  using ReadyEntry = std::pair<uint64_t, NodeId>;
+
+  /// The ready node with larger cost runs first. Ties run in the id order.
+  struct ReadyLess {
+    bool operator()(const ReadyEntry& x, const ReadyEntry& y) const {
+      return x.first < y.first || (x.first == y.first && x.second > y.second);
+    }
+  };
+
+  using ReadyQueue =
+      std::priority_queue<ReadyEntry, std::vector<ReadyEntry>, ReadyLess>;
+
+  /// Put the node to the ready queue of the preferred NUMA node and submit a
+  /// worker task to run it.
+  void submit(ThreadPool& pool, WaitGroup& wg, NodeId id,
+              std::size_t preferred_node);
+
+  /// Submit a worker task which runs the ready node with the largest cost.
+  void dispatch(ThreadPool& pool, WaitGroup& wg);
+
+  /// Pop the ready node with the largest cost which fits the resource limit
+  /// and hold its resource. The nodes of the NUMA node and without a
+  /// preference go first. The nodes which do not fit are postponed. The
+  /// caller holds `ready_mutex_`.
+  ///
+  /// @return false: no ready node fits the resource limit.
+  bool popReady(std::size_t numa_node, NodeId& id);
+
+  /// Finish a running node. The postponed nodes are retried.
+  void finish(ThreadPool& pool, WaitGroup& wg);
+
+  void execute(NodeId id);
+
+  std::vector<std::unique_ptr<Node>> nodes_;
+
+  /// The ready queues of each NUMA node of the pool. The last one is for the
+  /// nodes without a preference.
+  std::mutex ready_mutex_;
+  std::vector<ReadyQueue> ready_;
+
+  /// The ready nodes which do not fit the resource limit.
+  ReadyQueue postponed_;
+
+  /// The number of running nodes.
+  std::size_t running_size_;
+
+  /// The number of worker tasks which found no node to run. They are
+  /// submitted again when a running node finishes.
+  std::size_t deferred_size_;
+
+  uint64_t resource_limit_;
+  uint64_t resource_size_;
+  uint64_t resource_peak_;
+};
+
+}  // namespace pcpe
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+/// A folder for the temp files and its weight.
+struct TempFolder {
+  TempFolder() : path(), weight(1) {}
+  TempFolder(const FilePath& ppath, uint32_t pweight)
+      : path(ppath), weight(pweight) {}
+
+  FilePath path;
+
+  /// The relative share of the temp files placed in the folder.
+  uint32_t weight;
+};
+
+/// How to place a new temp file on the temp folders.
+enum class TempPlacement {
+  /// Weighted round-robin by the index of the file. The placement is the same
+  /// for each execution.
+  kRoundRobin,
+
+  /// The folder with the most free space (multiplied by the weight) when the
+  /// file is placed.
+  kFreeSpace
+};
+
+/// The maximum weight of a temp folder.
+constexpr uint32_t kMaxTempFolderWeight = 1000;
+
+/**
+ * Parse a list of temp folders, e.g. `/scratch0:2,/scratch1,/scratch2:1`.
+ * Each folder has an optional weight (default: 1). The trailing slashes of
+ * the paths are removed.
+ *
+ * @param[in] str the list of folders separated by commas
+ * @param[out] folders the folders in the list
+ *
+ * @return false: the format is invalid
+ * */
+bool ParseTempFolders(const std::string& str, std::vector<TempFolder>& folders);
+
+/**
+ * Parse a temp placement: `round-robin` or `free-space`.
+ *
+ * @return false: the name is invalid
+ * */
+bool ParseTempPlacement(const std::string& str, TempPlacement& placement);
+
+/**
+ * Get the free space of the file system of the path for unprivileged users.
+ *
+ * @param[out] size the free space (unit: byte(s))
+ *
+ * @return false: the path does not exist or error happened
+ * */
+bool GetFreeSpace(const FilePath& path, uint64_t& size);
+
+/**
+ * Select a folder for the index-th temp file.
+ *
+ * The weighted round-robin interleaves the folders, e.g. the weights {2, 1}
+ * place the files on the folders 0, 1, 0, 0, 1, 0, ...
+ *
+ * @return the index of the selected folder
+ * */
+std::size_t SelectTempFolder(const std::vector<TempFolder>& folders,
+                             TempPlacement placement, std::size_t index);
+
+/**
+ * Get the path of the index-th temp file named `name` on the temp folders of
+ * `GetEnv()`.
+ * */
+FilePath GetTempFilePath(const std::string& name, std::size_t index);
+
+/**
+ * Get the path of the k-th file striped after a temp file, e.g. the spill
+ * runs of the output. The k-th file is on the k-th folder after the folder
+ * of `filepath` in the round-robin order, so the files which are read by the
+ * same merge are spread across the folders. With the free-space placement,
+ * the k-th file is on the k-th folder after the folder with the most free
+ * space. The file name is the same.
+ *
+ * If `filepath` is not in a temp folder of `GetEnv()`, it's returned unchanged.
+ * */
+FilePath GetStripedTempFilePath(const FilePath& filepath, std::size_t k);
+
+}  // namespace pcpe
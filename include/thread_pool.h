@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "numa.h"
+
+namespace pcpe {
+
+class ThreadPool;
+
+/**
+ * Count the unfinished tasks of a group.
+ *
+ * `ThreadPool::submit` adds a task to the group and the task marks itself
+ * done after it's executed. `wait()` blocks until all tasks of the group are
+ * done. If `wait()` is called by a worker of a thread pool, the worker keeps
+ * executing the pending tasks of the group while waiting so a task can wait
+ * for the subtasks it spawns without blocking the worker.
+ *
+ * Only the tasks of the group are executed. An unrelated task (e.g. another
+ * task of a task graph) would run inside the waiting task and hold its memory
+ * reservations, so the memory budget could not bound the tasks running at the
+ * same time.
+ * */
+class WaitGroup {
+ public:
+  WaitGroup() : count_(0), mutex_(), cv_() {}
+
+  void add(std::size_t n = 1);
+  void done();
+  void wait();
+
+  bool finished() const { return count_.load() == 0; }
+
+  WaitGroup(const WaitGroup&) = delete;
+  WaitGroup& operator=(const WaitGroup&) = delete;
+
+ private:
+  std::atomic<std::size_t> count_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+};
+
+/**
+ * A persistent work-stealing thread pool.
+ *
+ * Each worker has its own deque. A task submitted by a worker is pushed to
+ * the back of the worker's deque and the worker pops tasks from the back.
+ * Tasks submitted by other threads are pushed to a shared queue in FIFO
+ * order. An idle worker takes tasks from the shared queue first and then
+ * steals from the front of the other workers' deques.
+ *
+ * In NUMA mode, the workers are distributed to the NUMA nodes round-robin and
+ * each worker is bound to the CPUs of its node. The buffers a task allocates
+ * are on the node of the worker (first-touch). An idle worker steals from the
+ * workers of the same node first. Without NUMA mode, all workers are in one
+ * node.
+ * */
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(std::size_t threads_size, bool numa = false);
+  ~ThreadPool();
+
+  /// Submit a task of the wait group.
+  void submit(Task task, WaitGroup& wg);
+
+  /// Execute one pending task of the wait group in the current thread. The
+  /// group nullptr executes any pending task. Return false if there is no
+  /// such pending task.
+  bool runPendingTask(const WaitGroup* group = nullptr);
+
+  /// Get the number of workers.
+  std::size_t size() const { return threads_.size(); }
+
+  /// Get the number of NUMA nodes of the workers. It's 1 without NUMA mode.
+  std::size_t getNodeSize() const { return node_size_; }
+
+  /// Get the pool of the current worker. Return nullptr if the current thread
+  /// is not a worker.
+  static ThreadPool* getCurrentPool();
+
+  /// Get the index of the current worker. Only valid in a worker.
+  static std::size_t getCurrentWorker();
+
+  /// Get the NUMA node index (`[0, getNodeSize())`) of the current worker.
+  /// Return 0 if the current thread is not a worker.
+  static std::size_t getCurrentNode();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+ private:
+  /// A pending task and the wait group it belongs to.
+  struct PendingTask {
+    Task task;
+    const WaitGroup* group;
+  };
+
+  struct WorkerQueue {
+    std::deque<PendingTask> tasks;
+    std::mutex mutex;
+  };
+
+  void workerLoop(std::size_t idx);
+  void push(Task task, const WaitGroup* group);
+
+  /// Take a pending task of the group. The group nullptr takes any task.
+  bool getTask(const WaitGroup* group, Task& task);
+  bool popTask(std::size_t idx, const WaitGroup* group, Task& task);
+  bool stealTask(std::size_t idx, const WaitGroup* group, Task& task);
+
+  std::vector<NumaNode> numa_nodes_;
+  std::size_t node_size_;
+  std::vector<std::size_t> worker_nodes_;
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::deque<PendingTask> shared_tasks_;
+  std::mutex shared_mutex_;
+
+  std::atomic<std::size_t> pending_size_;
+  std::atomic<bool> stop_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+
+  std::vector<std::thread> threads_;
+};
+
+/**
+ * Get the process-wide thread pool. The pool is created with
+ * `gEnv.getThreadsSize()` workers (and NUMA mode if `gEnv.getNuma()`) when
+ * it's used the first time.
+ * */
+ThreadPool& GetThreadPool();
+
+}  // namespace pcpe
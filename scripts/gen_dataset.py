@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+#
+# Generate a synthetic protein dataset for scale, skew and correctness tests.
+#
+# The outputs of `gen_dataset.py <prefix>` are
+#
+#   <prefix>_x_seq_css.txt, <prefix>_y_seq_css.txt  the sequence files
+#   <prefix>_x_id_css.txt, <prefix>_y_id_css.txt    the id files
+#   <prefix>_planted.bin                             the planted segments
+#
+# The planted segments are shared by a x sequence and a y sequence. The file
+# is in the format of the result of max_comsubseq (5 uint32 in native byte
+# order per record: x, y, x_loc, y_loc, len) so it can be read by
+# `max_comsubseq export`. The result of max_comsubseq contains a common
+# subsequence which covers each planted segment whose length is at least the
+# minimum output length. The common subsequence could be longer since the
+# neighbouring residues could match by chance.
+#
+# The sequences are written one by one, so the memory usage depends on the
+# number of the planted segments rather than the size of the dataset. The
+# output is the same for the same arguments and seed.
+
+import argparse
+import math
+import random
+import struct
+
+AMINO_ACIDS = "ACDEFGHIKLMNPQRSTVWY"
+
+# The background frequencies (%) of UniProtKB/Swiss-Prot.
+NATURAL_COMPOSITION = [8.25, 1.37, 5.45, 6.75, 3.86, 7.07, 2.27, 5.96, 5.84,
+                       9.66, 2.42, 4.06, 4.70, 3.93, 5.53, 6.56, 5.34, 6.87,
+                       1.08, 2.92]
+
+# The minimum length of a sequence. It's the length of a small seq.
+MIN_SEQ_LENGTH = 6
+
+getSeqFilename = lambda prefix, side: prefix + "_" + side + "_seq_css.txt"
+getIDFilename = lambda prefix, side: prefix + "_" + side + "_id_css.txt"
+getPlantedFilename = lambda prefix: prefix + "_planted.bin"
+
+
+def parseComposition(s):
+    if s == "uniform":
+        return [1.0] * len(AMINO_ACIDS)
+    if s == "natural":
+        return NATURAL_COMPOSITION
+    if s.startswith("zipf:"):
+        skew = float(s[len("zipf:"):])
+        return [1.0 / math.pow(rank + 1, skew)
+                for rank in range(len(AMINO_ACIDS))]
+
+    raise argparse.ArgumentTypeError("invalid composition - " + s)
+
+
+def parseLength(s):
+    items = s.split(':')
+    try:
+        if items[0] == "fixed" and len(items) == 2:
+            length = int(items[1])
+            return lambda rng: length
+        if items[0] == "uniform" and len(items) == 3:
+            low, high = int(items[1]), int(items[2])
+            if low <= high:
+                return lambda rng: rng.randint(low, high)
+        if items[0] == "lognormal" and len(items) == 3:
+            mu, sigma = math.log(float(items[1])), float(items[2])
+            return lambda rng: int(rng.lognormvariate(mu, sigma))
+    except ValueError:
+        pass
+
+    raise argparse.ArgumentTypeError("invalid length distribution - " + s)
+
+
+def parsePlant(s):
+    items = s.split(':')
+    try:
+        if len(items) == 2 and int(items[0]) >= 0 and int(items[1]) > 0:
+            return int(items[0]), int(items[1])
+    except ValueError:
+        pass
+
+    raise argparse.ArgumentTypeError("invalid planted segments - " + s)
+
+
+def parseFraction(s):
+    fraction = float(s)
+    if fraction < 0.0 or fraction > 1.0:
+        raise argparse.ArgumentTypeError("invalid fraction - " + s)
+
+    return fraction
+
+
+class Generator:
+    def __init__(self, args, rng):
+        self.args = args
+        self.rng = rng
+        self.cum_weights = []
+        total = 0.0
+        for weight in args.composition:
+            total += weight
+            self.cum_weights.append(total)
+
+    def randomResidues(self, length):
+        return "".join(self.rng.choices(AMINO_ACIDS,
+                                        cum_weights=self.cum_weights,
+                                        k=length))
+
+    def lowComplexityRegion(self):
+        # A homopolymer or a short-period repeat, e.g. QQQQ or PAPAPA.
+        length = self.rng.randint(10, 40)
+        unit = self.randomResidues(self.rng.randint(1, 3))
+        return (unit * (length // len(unit) + 1))[:length]
+
+    def tandemRepeat(self):
+        unit = self.randomResidues(self.rng.randint(10, 50))
+        return unit * self.rng.randint(2, 5)
+
+    # Generate a sequence with the planted segments. `segments` is a list of
+    # (index, residues). Return the sequence and the locations of the
+    # segments.
+    def sequence(self, segments):
+        length = max(MIN_SEQ_LENGTH, self.args.length(self.rng))
+        parts = [self.randomResidues(length)]
+
+        # The low-complexity regions and the repeats replace a part of the
+        # background.
+        for fraction, region in ((self.args.low_complexity,
+                                  self.lowComplexityRegion),
+                                 (self.args.repeat, self.tandemRepeat)):
+            if self.rng.random() < fraction:
+                s = region()[:length]
+                loc = self.rng.randint(0, length - len(s))
+                parts[0] = parts[0][:loc] + s + parts[0][loc + len(s):]
+
+        # The planted segments are inserted at distinct cut points of the
+        # background, so they never overlap.
+        background = parts[0]
+        cuts = sorted(self.rng.randint(0, length) for _ in segments)
+        parts = []
+        locs = {}
+        prev = 0
+        size = 0
+        for cut, (index, residues) in zip(cuts, segments):
+            parts.append(background[prev:cut])
+            size += cut - prev
+            locs[index] = size
+            parts.append(residues)
+            size += len(residues)
+            prev = cut
+        parts.append(background[prev:])
+
+        return "".join(parts), locs
+
+
+# Write the sequence file and the id file of a side. `plants` maps the index
+# of a sequence to its planted segments. Return the locations of the planted
+# segments.
+def writeSequences(prefix, side, size, plants, generator):
+    locs = {}
+    with open(getSeqFilename(prefix, side), 'w') as f_seq, \
+            open(getIDFilename(prefix, side), 'w') as f_id:
+        f_seq.write(str(size) + "\n")
+        f_id.write(str(size) + "\n")
+
+        for idx in range(size):
+            seq, seq_locs = generator.sequence(plants.get(idx, []))
+            locs.update(seq_locs)
+            f_seq.write(str(len(seq)) + " " + seq + "\n")
+            f_id.write("1 " + side + str(idx) + "\n")
+
+    print("Write file " + getSeqFilename(prefix, side))
+    return locs
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Generate a synthetic protein dataset.")
+    parser.add_argument("prefix", help="the prefix of the output files")
+    parser.add_argument("--x-size", type=int, default=1000,
+                        help="the number of x sequences (default: 1000)")
+    parser.add_argument("--y-size", type=int, default=1000,
+                        help="the number of y sequences (default: 1000)")
+    parser.add_argument("--length", type=parseLength,
+                        default=parseLength("lognormal:300:0.6"),
+                        help="the length distribution of the sequences: "
+                             "fixed:<len>, uniform:<min>:<max> or "
+                             "lognormal:<median>:<sigma> "
+                             "(default: lognormal:300:0.6)")
+    parser.add_argument("--composition", type=parseComposition,
+                        default=NATURAL_COMPOSITION,
+                        help="the amino-acid composition: uniform, natural "
+                             "or zipf:<skew> (default: natural)")
+    parser.add_argument("--plant", type=parsePlant, default=(0, 0),
+                        help="plant <n> segments of <len> residues shared "
+                             "by random sequence pairs, as <n>:<len>")
+    parser.add_argument("--low-complexity", type=parseFraction, default=0.0,
+                        help="the fraction of the sequences with a "
+                             "low-complexity region (default: 0)")
+    parser.add_argument("--repeat", type=parseFraction, default=0.0,
+                        help="the fraction of the sequences with a tandem "
+                             "repeat (default: 0)")
+    parser.add_argument("--seed", type=int, default=0,
+                        help="the seed of the random generator (default: 0)")
+    args = parser.parse_args()
+
+    if args.x_size <= 0 or args.y_size <= 0:
+        parser.error("the number of sequences must be positive")
+
+    rng = random.Random(args.seed)
+    generator = Generator(args, rng)
+
+    # Select the sequence pairs and the residues of the planted segments.
+    plant_size, plant_length = args.plant
+    pairs = []
+    x_plants = {}
+    y_plants = {}
+    for i in range(plant_size):
+        x, y = rng.randrange(args.x_size), rng.randrange(args.y_size)
+        residues = generator.randomResidues(plant_length)
+        pairs.append((x, y))
+        x_plants.setdefault(x, []).append((i, residues))
+        y_plants.setdefault(y, []).append((i, residues))
+
+    x_locs = writeSequences(args.prefix, "x", args.x_size, x_plants, generator)
+    y_locs = writeSequences(args.prefix, "y", args.y_size, y_plants, generator)
+
+    # The planted segments are sorted by the sequence pairs.
+    records = sorted((x, y, x_locs[i], y_locs[i], plant_length)
+                     for i, (x, y) in enumerate(pairs))
+    with open(getPlantedFilename(args.prefix), 'wb') as f:
+        for record in records:
+            f.write(struct.pack("=5I", *record))
+
+    print("Write file " + getPlantedFilename(args.prefix))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,14 @@
 #include "com_subseq.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <iostream>
 
@@ -41,6 +49,17 @@ bool ComSubseq::operator<(const ComSubseq& rhs) const {
   return y_loc_ < rhs.y_loc_;
 }
 
+bool ComSubseq::lessByDiagonal(const ComSubseq& rhs) const {
+  if (x_ != rhs.x_) return x_ < rhs.x_;
+
+  if (y_ != rhs.y_) return y_ < rhs.y_;
+
+  if (getDiagonal() != rhs.getDiagonal())
+    return getDiagonal() < rhs.getDiagonal();
+
+  return x_loc_ < rhs.x_loc_;
+}
+
 bool ComSubseq::operator>(const ComSubseq& rhs) const {
   if (x_ != rhs.x_) return x_ > rhs.x_;
 
@@ -56,7 +75,10 @@ ComSubseqFileReader::ComSubseqFileReader(const FilePath& filepath)
       infile_(filepath_.c_str(), std::ifstream::in | std::ifstream::binary),
       file_size_(0),
       curr_read_size_(0),
-      max_buffer_size_(gEnv.getIOBufferSize() / sizeof(ComSubseq)),
+      memory_(kMinIOBufferSize, GetEnv().getIOBufferSize()),
+      max_buffer_size_(std::max<std::streamsize>(
+          static_cast<std::streamsize>(memory_.size() / sizeof(ComSubseq)),
+          1)),
       buffer_(new ComSubseq[(std::size_t)max_buffer_size_]),
       buffer_size_(0),
       buffer_idx_((std::size_t)max_buffer_size_) {
@@ -160,9 +182,14 @@ bool ReadComSubseqFile(const FilePath& filepath,
 ComSubseqFileWriter::ComSubseqFileWriter(FilePath filepath)
     : filepath_(filepath),
       outfile_(filepath_.c_str(), std::ofstream::out | std::ofstream::binary),
-      buffer_(new ComSubseq[gEnv.getIOBufferSize() / sizeof(ComSubseq)]),
-      buffer_size_(gEnv.getIOBufferSize() / sizeof(ComSubseq)),
-      buffer_idx_(0) {}
+      memory_(kMinIOBufferSize, GetEnv().getIOBufferSize()),
+      buffer_(),
+      buffer_size_(std::max<std::streamsize>(
+          static_cast<std::streamsize>(memory_.size() / sizeof(ComSubseq)),
+          1)),
+      buffer_idx_(0) {
+  buffer_.reset(new ComSubseq[static_cast<std::size_t>(buffer_size_)]);
+}
 
 ComSubseqFileWriter::~ComSubseqFileWriter() {
   if (is_open()) {
@@ -216,6 +243,11 @@ bool WriteComSubseqFile(const std::vector<ComSubseq>& com_list,
 
 void SplitComSubseqFile(const FilePath& ifilepath,
                         std::vector<FilePath>& ofilepaths) {
+  SplitComSubseqFile(ifilepath, GetEnv().getBufferSize(), ofilepaths);
+}
+
+void SplitComSubseqFile(const FilePath& ifilepath, std::size_t split_size,
+                        std::vector<FilePath>& ofilepaths) {
   if (!CheckFileNotEmpty(ifilepath.c_str())) {
     LOG_ERROR() << "Get file error. Please check the file exists or not."
                 << std::endl;
@@ -226,7 +258,8 @@ void SplitComSubseqFile(const FilePath& ifilepath,
   GetFileSize(ifilepath.c_str(), file_size);
 
   const FileSize buffer_size =
-      gEnv.getBufferSize() / sizeof(ComSubseq) * sizeof(ComSubseq);
+      std::max<std::size_t>(split_size / sizeof(ComSubseq), 1) *
+      sizeof(ComSubseq);
   if (file_size <= buffer_size) {
     ofilepaths.push_back(ifilepath);
     return;
@@ -261,22 +294,144 @@ void SplitComSubseqFile(const FilePath& ifilepath,
   infile.close();
 }
 
-void CombineComSubSeqFiles(const std::vector<FilePath>& ifilepaths,
+bool ReadComSubseqAt(std::ifstream& ifile, uint64_t idx, ComSubseq& seq) {
+  ifile.clear();
+  ifile.seekg(static_cast<std::streamoff>(idx * sizeof(ComSubseq)));
+  ifile.read(reinterpret_cast<char*>(&seq), sizeof(ComSubseq));
+
+  return ifile.gcount() == static_cast<std::streamsize>(sizeof(ComSubseq));
+}
+
+/**
+ * Copy `size` bytes from the offset of `ifd` to the offset of `ofd`.
+ *
+ * The data is copied in the kernel with `copy_file_range`, which could share
+ * the extents on a file system with reflinks, or with `sendfile`. If neither
+ * is supported, e.g. two file systems on an old kernel, the rest is copied
+ * with a bounded buffer.
+ *
+ * @return false: the input is shorter than the size or error happened.
+ * */
+static bool CopyFileData(int ifd, int ofd, uint64_t size) {
+  // The maximum size of one system call.
+  const uint64_t kMaxCopySize = 1ULL << 30;
+
+#ifdef __linux__
+  while (size > 0) {
+    const ssize_t copy_size =
+        copy_file_range(ifd, nullptr, ofd, nullptr,
+                        static_cast<std::size_t>(std::min(size, kMaxCopySize)),
+                        0);
+    if (copy_size < 0 && errno == EINTR) continue;
+    if (copy_size == 0) return false;
+    if (copy_size < 0) break;
+
+    size -= static_cast<uint64_t>(copy_size);
+  }
+
+  while (size > 0) {
+    const ssize_t copy_size = sendfile(
+        ofd, ifd, nullptr,
+        static_cast<std::size_t>(std::min(size, kMaxCopySize)));
+    if (copy_size < 0 && errno == EINTR) continue;
+    if (copy_size == 0) return false;
+    if (copy_size < 0) break;
+
+    size -= static_cast<uint64_t>(copy_size);
+  }
+#endif
+
+  if (size == 0) return true;
+
+  MemoryReservation memory(kMinIOBufferSize, GetEnv().getIOBufferSize());
+  const std::size_t buffer_size = static_cast<std::size_t>(memory.size());
+  std::unique_ptr<char[]> buffer(new char[buffer_size]);
+
+  while (size > 0) {
+    const ssize_t read_size =
+        read(ifd, buffer.get(),
+             static_cast<std::size_t>(std::min<uint64_t>(size, buffer_size)));
+    if (read_size < 0 && errno == EINTR) continue;
+    if (read_size <= 0) return false;
+
+    for (ssize_t written = 0; written < read_size;) {
+      const ssize_t write_size =
+          write(ofd, buffer.get() + written,
+                static_cast<std::size_t>(read_size - written));
+      if (write_size < 0 && errno == EINTR) continue;
+      if (write_size <= 0) return false;
+
+      written += write_size;
+    }
+    size -= static_cast<uint64_t>(read_size);
+  }
+
+  return true;
+}
+
+/// Copy the whole file to the offset of `ofd`.
+static bool CopyFileData(const FilePath& ifilepath, int ofd) {
+  const int ifd = open(ifilepath.c_str(), O_RDONLY);
+  struct stat stat;
+  if (ifd < 0 || fstat(ifd, &stat) != 0) {
+    LOG_ERROR() << "Open a file error - " << ifilepath << std::endl;
+    if (ifd >= 0) close(ifd);
+    return false;
+  }
+
+  const bool copied =
+      CopyFileData(ifd, ofd, static_cast<uint64_t>(stat.st_size));
+  close(ifd);
+
+  if (!copied)
+    LOG_ERROR() << "Copy the file error - " << ifilepath << std::endl;
+  return copied;
+}
+
+bool AppendComSubseqFile(const FilePath& ifilepath, const FilePath& ofilepath) {
+  // `copy_file_range` does not support `O_APPEND`, so the offset is moved to
+  // the end instead.
+  const int ofd = open(ofilepath.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (ofd < 0 || lseek(ofd, 0, SEEK_END) < 0) {
+    LOG_ERROR() << "Open a file error - " << ofilepath << std::endl;
+    if (ofd >= 0) close(ofd);
+    return false;
+  }
+
+  const bool appended =
+      !CheckFileNotEmpty(ifilepath.c_str()) || CopyFileData(ifilepath, ofd);
+  if (close(ofd) != 0) {
+    LOG_ERROR() << "Close a file error - " << ofilepath << std::endl;
+    return false;
+  }
+
+  return appended;
+}
+
+bool CombineComSubSeqFiles(const std::vector<FilePath>& ifilepaths,
                            const FilePath& ofilepath) {
-  std::ofstream ofile(ofilepath.c_str(),
-                      std::ofstream::out | std::ofstream::binary);
+  const int ofd = open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (ofd < 0) {
+    LOG_ERROR() << "Open a file error - " << ofilepath << std::endl;
+    return false;
+  }
 
+  bool combined = true;
   for (const auto& ifilepath : ifilepaths) {
     if (!CheckFileNotEmpty(ifilepath.c_str())) continue;
+    if (!CopyFileData(ifilepath, ofd)) {
+      LOG_ERROR() << "Combine a file error - " << ifilepath << std::endl;
+      combined = false;
+      break;
+    }
+  }
 
-    std::vector<ComSubseq> seqs;
-    ReadComSubseqFile(ifilepath, seqs);
-
-    ofile.write(reinterpret_cast<const char*>(seqs.data()),
-                static_cast<std::streamsize>(seqs.size() * sizeof(ComSubseq)));
+  if (close(ofd) != 0) {
+    LOG_ERROR() << "Close a file error - " << ofilepath << std::endl;
+    return false;
   }
 
-  ofile.close();
+  return combined;
 }
 
 }  // namespace pcpe
@@ -1,22 +1,34 @@
 #include "com_subseq_sort.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
 #include <memory>
-#include <queue>
 #include <sstream>
 #include <vector>
 
 #include "com_subseq.h"
 #include "env.h"
 #include "logging.h"
+#include "max_comsubseq.h"
+#include "memory_budget.h"
 #include "pcpe_util.h"
+#include "run_context.h"
 #include "simple_task.h"
+#include "temp_folder.h"
+#include "thread_pool.h"
 
 namespace pcpe {
 
 bool CompareComSubseqFileReaderFirstEntry(const ComSubseqFileReader& x,
-                                          const ComSubseqFileReader& y) {
-  return x.buffer_[x.buffer_idx_] > y.buffer_[y.buffer_idx_];
+                                          const ComSubseqFileReader& y,
+                                          const ComSubseqLess& less) {
+  return less(y.buffer_[y.buffer_idx_], x.buffer_[x.buffer_idx_]);
 }
 
 class SortComSubseqsFileTask {
@@ -25,6 +37,13 @@ class SortComSubseqsFileTask {
       : ifilepath_(ifilepath), ofilepath_(ofilepath) {}
   void exec();
 
+  /// The estimated cost is the size of the input file.
+  uint64_t cost() const {
+    FileSize file_size = 0;
+    GetFileSize(ifilepath_.c_str(), file_size);
+    return static_cast<uint64_t>(file_size);
+  }
+
   const FilePath& getOutput() const { return ofilepath_; }
 
  private:
@@ -32,17 +51,161 @@ class SortComSubseqsFileTask {
   FilePath ofilepath_;
 };
 
+/// The minimum size of a range to fork the sort.
+static const std::ptrdiff_t kMinForkSize = 1 << 16;
+
+/**
+ * Sort ComSubseqs with fork-join merge sort.
+ *
+ * If the range is large, the first half is submitted to the thread pool as a
+ * subtask and the second half is sorted by the current thread. Idle workers
+ * steal the subtasks so a huge sort does not keep only one thread busy.
+ *
+ * The halves are merged through `buffer`, which holds half of the range at
+ * least. The two subtasks use the two disjoint parts of the buffer, so one
+ * buffer of half the ComSubseqs serves the whole sort.
+ * */
+static void SortComSubseqs(ComSubseq* begin, ComSubseq* end, ComSubseq* buffer,
+                           const ComSubseqLess& less, std::size_t depth) {
+  if (depth == 0 || end - begin < kMinForkSize) {
+    std::sort(begin, end, less);
+    return;
+  }
+
+  ComSubseq* middle = begin + (end - begin) / 2;
+  ComSubseq* middle_buffer = buffer + (middle - begin) / 2;
+
+  WaitGroup wg;
+  GetRunContext().getThreadPool().submit(
+      [begin, middle, buffer, &less, depth]() {
+        SortComSubseqs(begin, middle, buffer, less, depth - 1);
+      },
+      wg);
+  SortComSubseqs(middle, end, middle_buffer, less, depth - 1);
+  wg.wait();
+
+  // Move the first half out of the way and merge back into the range. The
+  // output never overtakes the unread part of the second half.
+  ComSubseq* buffer_end = std::copy(begin, middle, buffer);
+  std::merge(buffer, buffer_end, middle, end, begin, less);
+}
+
+static void SortComSubseqs(std::vector<ComSubseq>& seqs) {
+  // Fork until each worker has about two subtasks.
+  std::size_t depth = 1;
+  for (std::size_t n = GetRunContext().getThreadPool().size(); n > 1; n /= 2)
+    depth++;
+
+  // The merge buffer is reserved from the memory budget. The caller holds the
+  // reservation of the ComSubseqs, so the reservation never blocks. A small
+  // range is sorted without a merge.
+  const std::size_t buffer_size =
+      seqs.size() < static_cast<std::size_t>(kMinForkSize) ? 0
+                                                           : seqs.size() / 2;
+  MemoryReservation memory(buffer_size * sizeof(ComSubseq),
+                           buffer_size * sizeof(ComSubseq));
+  std::unique_ptr<ComSubseq[]> buffer(new ComSubseq[buffer_size]);
+
+  const ComSubseqLess less(GetEnv().getComSubseqOrder());
+  SortComSubseqs(seqs.data(), seqs.data() + seqs.size(), buffer.get(), less,
+                 depth);
+}
+
+ComSubseqSortBuffer::ComSubseqSortBuffer(const FilePath& spill_prefix)
+    : spill_prefix_(spill_prefix),
+      memory_(GetEnv().getBufferSize() / 4, GetEnv().getBufferSize()),
+      max_seqs_size_(static_cast<std::size_t>(memory_.size()) /
+                     sizeof(ComSubseq)),
+      seqs_(),
+      spill_filepaths_(),
+      spill_size_(0) {
+  if (max_seqs_size_ == 0) max_seqs_size_ = 1;
+}
+
+ComSubseqSortBuffer::~ComSubseqSortBuffer() { removeSpillFiles(); }
+
+bool ComSubseqSortBuffer::writeSeq(const ComSubseq& seq) {
+  if (seqs_.size() >= max_seqs_size_) spill();
+
+  // Grow the buffer manually so the capacity never exceeds the buffer size.
+  if (seqs_.size() == seqs_.capacity())
+    seqs_.reserve(std::min(max_seqs_size_,
+                           std::max<std::size_t>(seqs_.capacity() * 2, 1024)));
+
+  seqs_.push_back(seq);
+  return true;
+}
+
+void ComSubseqSortBuffer::sort() { SortComSubseqs(seqs_); }
+
+void ComSubseqSortBuffer::spill() {
+  if (seqs_.empty()) return;
+
+  // The runs are striped on the temp folders after the folder of the prefix,
+  // so the merge reads them from all folders.
+  std::ostringstream oss;
+  oss << spill_prefix_ << "_run_" << spill_size_;
+  const FilePath filepath = GetStripedTempFilePath(oss.str(), spill_size_ + 1);
+
+  sort();
+  WriteComSubseqFile(seqs_, filepath);
+  seqs_.clear();
+
+  spill_filepaths_.push_back(filepath);
+  spill_size_++;
+}
+
+bool ComSubseqSortBuffer::sortMaxTo(const FilePath& ofilepath) {
+  if (spill_filepaths_.empty()) {
+    MaxComSubseqFileWriter writer(ofilepath);
+    sort();
+    bool written = true;
+    for (const auto& seq : seqs_) {
+      if (!writer.writeSeq(seq)) {
+        written = false;
+        break;
+      }
+    }
+
+    seqs_.clear();
+    seqs_.shrink_to_fit();
+    return writer.close() && written;
+  }
+
+  spill();
+  const bool merged =
+      ParallelMergeMaxComSubseqFiles(spill_filepaths_, ofilepath);
+  removeSpillFiles();
+
+  seqs_.clear();
+  seqs_.shrink_to_fit();
+  return merged;
+}
+
+void ComSubseqSortBuffer::removeSpillFiles() {
+  for (const auto& filepath : spill_filepaths_)
+    std::remove(filepath.c_str());
+
+  spill_filepaths_.clear();
+}
+
 static void SortSingleComSubseqFile(const FilePath& ifilepath,
                                     const FilePath& ofilepath) {
   std::vector<ComSubseq> seqs;
   ReadComSubseqFile(ifilepath, seqs);
-  sort(seqs.begin(), seqs.end());
+  SortComSubseqs(seqs);
   WriteComSubseqFile(seqs, ofilepath);
 }
 
 void SortComSubseqsFileTask::exec() {
+  // Reserve the sort buffer. If the memory budget is not enough, the file is
+  // split to smaller files.
+  MemoryReservation memory(GetEnv().getBufferSize() / 4,
+                           GetEnv().getBufferSize());
+
   std::vector<FilePath> split_files;
-  SplitComSubseqFile(ifilepath_, split_files);
+  SplitComSubseqFile(ifilepath_, static_cast<std::size_t>(memory.size()),
+                     split_files);
 
   if (split_files.empty())
     // The input file is empty or error happens.
@@ -58,49 +221,20 @@ void SortComSubseqsFileTask::exec() {
     // The size of input file is more than buffer size. It would do
     // 1. Sort each files.
     // 2. External merge sort for these files.
-
-    // 1. Sort the split files
+    //
+    // The split files are sorted one by one in the reserved memory. Each
+    // sort is a fork-join sort so idle workers still help.
     for (const auto& filepath : split_files)
       SortSingleComSubseqFile(filepath, filepath);
 
-    // 2. External sort for the split files
-
-    // Create all readers from split files
-    auto cmp_fun = [](const ComSubseqFileReader* x,
-                      const ComSubseqFileReader* y) -> bool {
-      return CompareComSubseqFileReaderFirstEntry(*x, *y);
-    };
-
-    std::priority_queue<ComSubseqFileReader*, std::vector<ComSubseqFileReader*>,
-                        decltype(cmp_fun)>
-        readers(cmp_fun);
-
-    for (const auto& file : split_files)
-      readers.push(new ComSubseqFileReader(file));
-
-    // External merge sort and write the result.
     ComSubseqFileWriter writer(ofilepath_);
-    while (!readers.empty()) {
-      // Find the minimum entry of these files
-      ComSubseqFileReader* reader = readers.top();
-      readers.pop();
-      ComSubseq seq;
-      reader->readSeq(seq);
-
-      // Write the current minimum entry
-      writer.writeSeq(seq);
-
-      // If the reader has another entries, push the reader back to the queue.
-      if (reader->eof()) {
-        reader->close();
-        delete reader;
-        reader = nullptr;
-      } else {
-        readers.push(reader);
-      }
-    }
+    MergeSortedComSubseqFiles(split_files, writer);
     writer.close();
 
+    // The split files are not the input file, so they are not needed after
+    // the merge.
+    for (const auto& filepath : split_files) std::remove(filepath.c_str());
+
     LOG_INFO() << "Sort the file with esort - " << ifilepath_ << " "
                << split_files.size() << std::endl;
   }
@@ -112,7 +246,8 @@ void ConstructSortComSubseqFileTasks(
   std::size_t curr_index = 0;
   for (const auto& input : ifilepaths) {
     std::ostringstream oss;
-    oss << gEnv.getTempFolderPath() << "/sorted_compare_hash_" << curr_index;
+    oss << GetEnv().getTempFolderPath() << "/sorted_compare_hash_"
+        << curr_index;
     curr_index++;
 
     tasks.emplace_back(new SortComSubseqsFileTask(input, oss.str()));
@@ -134,4 +269,490 @@ void SortComSubseqsFiles(const std::vector<FilePath>& ifilepaths,
       ofilepaths.push_back(task->getOutput());
 }
 
+/// Read the ComSubseqs [begin, end) of a file with a buffer.
+class ComSubseqRangeReader {
+ public:
+  ComSubseqRangeReader(const FilePath& filepath, uint64_t begin, uint64_t end,
+                       std::size_t buffer_size)
+      : filepath_(filepath),
+        infile_(filepath.c_str(), std::ifstream::in | std::ifstream::binary),
+        next_(begin),
+        end_(end),
+        max_buffer_size_(std::max<std::size_t>(buffer_size, 1)),
+        buffer_(new ComSubseq[max_buffer_size_]),
+        buffer_size_(0),
+        buffer_idx_(0) {
+    infile_.seekg(static_cast<std::streamoff>(begin * sizeof(ComSubseq)));
+    readBuffer();
+  }
+
+  bool eof() const { return buffer_idx_ >= buffer_size_; }
+
+  /// Get the current ComSubseq. The reader must not be eof.
+  const ComSubseq& front() const { return buffer_[buffer_idx_]; }
+
+  /// Move to the next ComSubseq.
+  void pop() {
+    if (++buffer_idx_ >= buffer_size_) readBuffer();
+  }
+
+  /// Return false if the file is shorter than the range.
+  bool good() const { return next_ >= end_; }
+
+ private:
+  void readBuffer() {
+    buffer_idx_ = 0;
+    buffer_size_ = 0;
+    if (next_ >= end_) return;
+
+    const std::size_t read_size = static_cast<std::size_t>(
+        std::min<uint64_t>(max_buffer_size_, end_ - next_));
+    infile_.read(reinterpret_cast<char*>(buffer_.get()),
+                 static_cast<std::streamsize>(read_size * sizeof(ComSubseq)));
+    buffer_size_ =
+        static_cast<std::size_t>(infile_.gcount()) / sizeof(ComSubseq);
+    next_ += buffer_size_;
+
+    if (buffer_size_ == 0)
+      LOG_ERROR() << "Read file error - " << filepath_ << std::endl;
+  }
+
+  const FilePath filepath_;
+  std::ifstream infile_;
+  uint64_t next_;
+  const uint64_t end_;
+
+  const std::size_t max_buffer_size_;
+  std::unique_ptr<ComSubseq[]> buffer_;
+  std::size_t buffer_size_;
+  std::size_t buffer_idx_;
+};
+
+/// Write all data at the offset of the file.
+static bool PwriteFully(int fd, const char* data, std::size_t size,
+                        uint64_t offset) {
+  while (size > 0) {
+    const ssize_t write_size =
+        pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (write_size < 0 && errno == EINTR) continue;
+    if (write_size <= 0) return false;
+
+    data += write_size;
+    size -= static_cast<std::size_t>(write_size);
+    offset += static_cast<uint64_t>(write_size);
+  }
+
+  return true;
+}
+
+/// Write ComSubseqs at the offset of a file with a buffer.
+class ComSubseqPwriter {
+ public:
+  /**
+   * @param[in] offset the offset of the output (unit: ComSubseq)
+   * @param[in] buffer_size the size of the buffer (unit: ComSubseq)
+   * */
+  ComSubseqPwriter(int fd, uint64_t offset, std::size_t buffer_size)
+      : fd_(fd),
+        offset_(offset),
+        buffer_size_(std::max<std::size_t>(buffer_size, 1)),
+        seqs_(),
+        good_(true) {
+    seqs_.reserve(buffer_size_);
+  }
+
+  /// Return true to present a valid write.
+  bool writeSeq(const ComSubseq& seq) {
+    seqs_.push_back(seq);
+    if (seqs_.size() >= buffer_size_) flush();
+
+    return good_;
+  }
+
+  /// Write the buffered ComSubseqs. Return false if any write fails.
+  bool flush() {
+    if (good_ && !seqs_.empty())
+      good_ = PwriteFully(fd_, reinterpret_cast<const char*>(seqs_.data()),
+                          seqs_.size() * sizeof(ComSubseq),
+                          offset_ * sizeof(ComSubseq));
+
+    offset_ += seqs_.size();
+    seqs_.clear();
+    return good_;
+  }
+
+ private:
+  const int fd_;
+  uint64_t offset_;
+  const std::size_t buffer_size_;
+  std::vector<ComSubseq> seqs_;
+  bool good_;
+};
+
+/// Get the size of each of `parts` buffers which share the reserved memory
+/// (unit: ComSubseq).
+static std::size_t GetSharedBufferSize(const MemoryReservation& memory,
+                                       std::size_t parts) {
+  return std::max<std::size_t>(static_cast<std::size_t>(memory.size()) /
+                                   sizeof(ComSubseq) /
+                                   std::max<std::size_t>(parts, 1),
+                               1);
+}
+
+/**
+ * Merge the ranges [begins[i], ends[i]) of the sorted files and write the
+ * result with the writer.
+ *
+ * @param[in] buffer_size the buffer size of each file (unit: ComSubseq)
+ * */
+template <typename Writer>
+static bool MergeComSubseqFileRanges(const std::vector<FilePath>& filepaths,
+                                     const std::vector<uint64_t>& begins,
+                                     const std::vector<uint64_t>& ends,
+                                     std::size_t buffer_size, Writer& writer) {
+  std::vector<std::unique_ptr<ComSubseqRangeReader>> readers;
+  for (std::size_t i = 0; i < filepaths.size(); ++i)
+    readers.emplace_back(new ComSubseqRangeReader(filepaths[i], begins[i],
+                                                  ends[i], buffer_size));
+
+  const ComSubseqLess less(GetEnv().getComSubseqOrder());
+  auto cmp_fun = [&readers, &less](std::size_t x, std::size_t y) -> bool {
+    return less(readers[y]->front(), readers[x]->front());
+  };
+  std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(cmp_fun)>
+      heads(cmp_fun);
+  for (std::size_t i = 0; i < readers.size(); ++i)
+    if (!readers[i]->eof()) heads.push(i);
+
+  bool written = true;
+  while (!heads.empty() && written) {
+    const std::size_t i = heads.top();
+    heads.pop();
+
+    written = writer.writeSeq(readers[i]->front());
+    readers[i]->pop();
+    if (!readers[i]->eof()) heads.push(i);
+  }
+
+  for (const auto& reader : readers)
+    if (!reader->good()) return false;
+
+  return written;
+}
+
+/**
+ * Get the number of ComSubseqs of each file.
+ *
+ * @param[out] sizes the number of ComSubseqs of each file
+ * @param[out] total_size the number of ComSubseqs of all files
+ * */
+static bool GetComSubseqFileSizes(const std::vector<FilePath>& filepaths,
+                                  std::vector<uint64_t>& sizes,
+                                  uint64_t& total_size) {
+  sizes.clear();
+  total_size = 0;
+  for (const auto& filepath : filepaths) {
+    FileSize file_size = 0;
+    if (!GetFileSize(filepath.c_str(), file_size)) {
+      LOG_ERROR() << "Get the size of the file error - " << filepath
+                  << std::endl;
+      return false;
+    }
+
+    sizes.push_back(static_cast<uint64_t>(file_size) / sizeof(ComSubseq));
+    total_size += sizes.back();
+  }
+
+  return true;
+}
+
+/// Get the number of partitions to merge `total_size` ComSubseqs. Each
+/// partition has an IO buffer of ComSubseqs at least.
+static std::size_t GetMergePartitionsSize(uint64_t total_size) {
+  const uint64_t min_partition_size = std::max<uint64_t>(
+      GetEnv().getIOBufferSize() / sizeof(ComSubseq), 1);
+
+  return static_cast<std::size_t>(std::max<uint64_t>(
+      std::min<uint64_t>(total_size / min_partition_size,
+                         GetRunContext().getThreadPool().size()),
+      1));
+}
+
+/// Return true if the sequence pair (x, y) of `lhs` is less than the one of
+/// `rhs`. All `ComSubseqOrder`s sort by the sequence pair first.
+static bool ComSubseqPairLess(const ComSubseq& lhs, const ComSubseq& rhs) {
+  return lhs.getX() < rhs.getX() ||
+         (lhs.getX() == rhs.getX() && lhs.getY() < rhs.getY());
+}
+
+/**
+ * Split the merge of the sorted files into partitions.
+ *
+ * The splitters are selected from samples of the files in proportion to their
+ * sizes, and the range of each partition in each file is found with binary
+ * search. `bounds[p][i]` is the first ComSubseq of the p-th partition in the
+ * i-th file, i.e. the first one which is not less than the splitter. The
+ * number of partitions is `bounds.size() - 1`. It's 1 if no sample can be
+ * read.
+ *
+ * @param[in] pair_boundary Compare with the sequence pair of the splitter
+ *                          only, so all ComSubseqs of a sequence pair (x, y)
+ *                          are in the same partition.
+ * */
+static bool GetMergePartitions(const std::vector<FilePath>& filepaths,
+                               const std::vector<uint64_t>& sizes,
+                               std::size_t partitions_size, bool pair_boundary,
+                               std::vector<std::vector<uint64_t>>& bounds) {
+  const ComSubseqLess less(GetEnv().getComSubseqOrder());
+
+  uint64_t total_size = 0;
+  for (const auto& size : sizes) total_size += size;
+
+  std::vector<std::ifstream> ifiles;
+  for (const auto& filepath : filepaths)
+    ifiles.emplace_back(filepath.c_str(),
+                        std::ifstream::in | std::ifstream::binary);
+
+  // Sample each file in proportion to its size and select the splitters at
+  // the quantiles of the samples.
+  const uint64_t kSamplesPerPartition = 32;
+  std::vector<ComSubseq> samples;
+  for (std::size_t i = 0; i < filepaths.size() && partitions_size > 1; ++i) {
+    const uint64_t samples_size = std::min(
+        sizes[i], (sizes[i] * partitions_size * kSamplesPerPartition +
+                   total_size - 1) /
+                      total_size);
+    for (uint64_t s = 0; s < samples_size; ++s) {
+      const uint64_t idx = (2 * s + 1) * sizes[i] / (2 * samples_size);
+      ComSubseq seq;
+      if (ReadComSubseqAt(ifiles[i], idx, seq)) samples.push_back(seq);
+    }
+  }
+  std::sort(samples.begin(), samples.end(), less);
+
+  // No sample could be read, so there is no splitter.
+  if (samples.empty()) partitions_size = 1;
+
+  bounds.assign(partitions_size + 1,
+                std::vector<uint64_t>(filepaths.size(), 0));
+  bounds[partitions_size] = sizes;
+  for (std::size_t p = 1; p < partitions_size; ++p) {
+    const ComSubseq& splitter = samples[p * samples.size() / partitions_size];
+    for (std::size_t i = 0; i < filepaths.size(); ++i) {
+      uint64_t low = bounds[p - 1][i];
+      uint64_t high = sizes[i];
+      while (low < high) {
+        const uint64_t mid = low + (high - low) / 2;
+        ComSubseq seq;
+        if (!ReadComSubseqAt(ifiles[i], mid, seq)) {
+          LOG_ERROR() << "Read file error - " << filepaths[i] << std::endl;
+          return false;
+        }
+
+        if (pair_boundary ? ComSubseqPairLess(seq, splitter)
+                          : less(seq, splitter))
+          low = mid + 1;
+        else
+          high = mid;
+      }
+      bounds[p][i] = low;
+    }
+  }
+
+  return true;
+}
+
+/// The maximum number of files merged at a time.
+static const std::size_t kMaxMergeFanIn = 64;
+
+/**
+ * Merge groups of `kMaxMergeFanIn` files until there are `kMaxMergeFanIn`
+ * files at most. Each partition of a merge opens all files and shares an IO
+ * buffer by them, so too many files make too many open files and tiny reads.
+ *
+ * @param[in] ifilepaths The sorted files.
+ * @param[in] prefix The prefix of the merged files.
+ * @param[out] filepaths The files to merge. They are the inputs if there are
+ *                       not too many.
+ * @param[out] temp_filepaths The merged files, which are removed after the
+ *                            final merge.
+ * */
+static bool LimitMergeFanIn(const std::vector<FilePath>& ifilepaths,
+                            const FilePath& prefix,
+                            std::vector<FilePath>& filepaths,
+                            std::vector<FilePath>& temp_filepaths) {
+  filepaths = ifilepaths;
+  for (std::size_t level = 0; filepaths.size() > kMaxMergeFanIn; ++level) {
+    std::vector<FilePath> merged_filepaths;
+    for (std::size_t begin = 0; begin < filepaths.size();
+         begin += kMaxMergeFanIn) {
+      const std::size_t end =
+          std::min(begin + kMaxMergeFanIn, filepaths.size());
+      const std::vector<FilePath> group(filepaths.begin() + begin,
+                                        filepaths.begin() + end);
+
+      std::ostringstream oss;
+      oss << prefix << "_merge_" << level << "_" << merged_filepaths.size();
+      merged_filepaths.push_back(oss.str());
+      temp_filepaths.push_back(oss.str());
+
+      if (!ParallelMergeSortedComSubseqFiles(group, merged_filepaths.back()))
+        return false;
+    }
+
+    LOG_INFO() << "Merge " << filepaths.size() << " sorted files into "
+               << merged_filepaths.size() << " files." << std::endl;
+    filepaths.swap(merged_filepaths);
+  }
+
+  return true;
+}
+
+/// Remove the files.
+static void RemoveFiles(const std::vector<FilePath>& filepaths) {
+  for (const auto& filepath : filepaths) std::remove(filepath.c_str());
+}
+
+static bool MergeSortedComSubseqFilesWithPartitions(
+    const std::vector<FilePath>& ifilepaths, const FilePath& ofilepath) {
+  std::vector<uint64_t> sizes;
+  uint64_t total_size = 0;
+  if (!GetComSubseqFileSizes(ifilepaths, sizes, total_size)) return false;
+
+  std::vector<std::vector<uint64_t>> bounds;
+  if (!GetMergePartitions(ifilepaths, sizes, GetMergePartitionsSize(total_size),
+                          false, bounds))
+    return false;
+  const std::size_t partitions_size = bounds.size() - 1;
+
+  const int fd = open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG_ERROR() << "Open file error - " << ofilepath << std::endl;
+    return false;
+  }
+
+  WaitGroup wg;
+  std::atomic<bool> merged(true);
+  uint64_t offset = 0;
+  for (std::size_t p = 0; p < partitions_size; ++p) {
+    const std::vector<uint64_t>* begins = &bounds[p];
+    const std::vector<uint64_t>* ends = &bounds[p + 1];
+    GetRunContext().getThreadPool().submit(
+        [&ifilepaths, begins, ends, fd, offset, &merged]() {
+          // The buffer is shared by the readers and the output.
+          MemoryReservation memory(kMinIOBufferSize,
+                                   GetEnv().getIOBufferSize());
+          const std::size_t buffer_size =
+              GetSharedBufferSize(memory, ifilepaths.size() + 1);
+
+          ComSubseqPwriter writer(fd, offset, buffer_size);
+          if (!MergeComSubseqFileRanges(ifilepaths, *begins, *ends,
+                                        buffer_size, writer) ||
+              !writer.flush())
+            merged = false;
+        },
+        wg);
+
+    for (std::size_t i = 0; i < ifilepaths.size(); ++i)
+      offset += bounds[p + 1][i] - bounds[p][i];
+  }
+  wg.wait();
+
+  if (close(fd) != 0 || !merged.load()) {
+    LOG_ERROR() << "Merge the sorted files error - " << ofilepath << std::endl;
+    return false;
+  }
+
+  LOG_INFO() << "Merge " << ifilepaths.size() << " sorted files with "
+             << partitions_size << " partitions - " << ofilepath << std::endl;
+  return true;
+}
+
+bool ParallelMergeSortedComSubseqFiles(const std::vector<FilePath>& ifilepaths,
+                                       const FilePath& ofilepath) {
+  std::vector<FilePath> filepaths;
+  std::vector<FilePath> temp_filepaths;
+  const bool merged =
+      LimitMergeFanIn(ifilepaths, ofilepath, filepaths, temp_filepaths) &&
+      MergeSortedComSubseqFilesWithPartitions(filepaths, ofilepath);
+  RemoveFiles(temp_filepaths);
+
+  return merged;
+}
+
+static bool MergeMaxComSubseqFilesWithPartitions(
+    const std::vector<FilePath>& ifilepaths, const FilePath& ofilepath) {
+  std::vector<uint64_t> sizes;
+  uint64_t total_size = 0;
+  if (!GetComSubseqFileSizes(ifilepaths, sizes, total_size)) return false;
+
+  std::vector<std::vector<uint64_t>> bounds;
+  if (!GetMergePartitions(ifilepaths, sizes, GetMergePartitionsSize(total_size),
+                          true, bounds))
+    return false;
+  const std::size_t partitions_size = bounds.size() - 1;
+
+  // The size of the output of a partition is unknown before the merge, so
+  // the first partition writes the output file and the others write their
+  // own part files. The parts are appended in order after the merge.
+  std::vector<FilePath> part_filepaths{ofilepath};
+  for (std::size_t p = 1; p < partitions_size; ++p) {
+    std::ostringstream oss;
+    oss << ofilepath << "_part_" << p;
+    part_filepaths.push_back(oss.str());
+  }
+
+  WaitGroup wg;
+  std::atomic<bool> merged(true);
+  for (std::size_t p = 0; p < partitions_size; ++p) {
+    const std::vector<uint64_t>* begins = &bounds[p];
+    const std::vector<uint64_t>* ends = &bounds[p + 1];
+    const FilePath* part_filepath = &part_filepaths[p];
+    GetRunContext().getThreadPool().submit(
+        [&ifilepaths, begins, ends, part_filepath, &merged]() {
+          MemoryReservation memory(kMinIOBufferSize,
+                                   GetEnv().getIOBufferSize());
+          const std::size_t buffer_size =
+              GetSharedBufferSize(memory, ifilepaths.size());
+
+          MaxComSubseqFileWriter writer(*part_filepath);
+          if (!writer.is_open() ||
+              !MergeComSubseqFileRanges(ifilepaths, *begins, *ends,
+                                        buffer_size, writer) ||
+              !writer.close())
+            merged = false;
+        },
+        wg);
+  }
+  wg.wait();
+
+  for (std::size_t p = 1; p < partitions_size; ++p) {
+    if (merged.load() && !AppendComSubseqFile(part_filepaths[p], ofilepath))
+      merged = false;
+    std::remove(part_filepaths[p].c_str());
+  }
+
+  if (!merged.load()) {
+    LOG_ERROR() << "Merge the max common subseqences error - " << ofilepath
+                << std::endl;
+    return false;
+  }
+
+  LOG_INFO() << "Merge " << ifilepaths.size() << " sorted files with "
+             << partitions_size << " partitions - " << ofilepath << std::endl;
+  return true;
+}
+
+bool ParallelMergeMaxComSubseqFiles(const std::vector<FilePath>& ifilepaths,
+                                    const FilePath& ofilepath) {
+  std::vector<FilePath> filepaths;
+  std::vector<FilePath> temp_filepaths;
+  const bool merged =
+      LimitMergeFanIn(ifilepaths, ofilepath, filepaths, temp_filepaths) &&
+      MergeMaxComSubseqFilesWithPartitions(filepaths, ofilepath);
+  RemoveFiles(temp_filepaths);
+
+  return merged;
+}
+
 }  // namespace pcpe
@@ -1,46 +1,406 @@
+#include <signal.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "com_subseq.h"
-#include "com_subseq_sort.h"
 #include "env.h"
 #include "logging.h"
-#include "max_comsubseq.h"
 #include "pcpe_util.h"
+#include "pipeline.h"
+#include "query.h"
+#include "query_server.h"
+#include "result_lookup.h"
+#include "result_export.h"
 #include "small_seq_hash.h"
+#include "temp_folder.h"
+
+void PrintUsage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " [options] <x_seq_file> <y_seq_file> <output_file>" << std::endl
+            << "       " << program
+            << " merge-shards <output_file> <shard_size>" << std::endl
+            << "       " << program
+            << " query <reference_seq_file> <query_seq_file|->" << std::endl
+            << "       " << program
+            << " serve <socket_path> <reference_seq_file>..." << std::endl
+            << "       " << program
+            << " send-queries <socket_path> <index_id> <query_seq_file|->"
+            << std::endl
+            << "       " << program
+            << " export <result_file> <output_file|-> [<x_id_file> <y_id_file>]"
+            << std::endl
+            << "       " << program << " lookup <result_file> <x> [<y>]"
+            << std::endl
+            << std::endl
+            << "Options:" << std::endl
+            << "  --memory-limit <size>  The memory limit of all running tasks,"
+            << std::endl
+            << "                         e.g. 4G or 512M. The default is no"
+            << std::endl
+            << "                         limit." << std::endl
+            << "  --temp-budget <size>   The limit of the projected size of the"
+            << std::endl
+            << "                         temp files. The default is no limit."
+            << std::endl
+            << "  --temp-dirs <dirs>     The temp folders with optional"
+            << std::endl
+            << "                         weights, e.g. /scratch0:2,/scratch1."
+            << std::endl
+            << "                         The default is ./temp." << std::endl
+            << "  --temp-placement <p>   Place the temp files by round-robin"
+            << std::endl
+            << "                         (default) or free-space." << std::endl
+            << "  --shard <i>/<n>        Compute the i-th of n shards. The"
+            << std::endl
+            << "                         result is"
+            << " <output_file>.shard-<i>-of-<n>." << std::endl
+            << "  --numa                 Bind the workers to NUMA nodes."
+            << std::endl
+            << "  --resume               Skip the tasks finished by the last"
+            << std::endl
+            << "                         run with the same temp folder."
+            << std::endl
+            << "  --incremental          Compute only the sequences appended"
+            << std::endl
+            << "                         after the last run of the output file."
+            << std::endl
+            << "  --best                 Keep only the longest common"
+            << std::endl
+            << "                         subsequence of each sequence pair."
+            << std::endl
+            << "  --top <n>              Keep only the n longest common"
+            << std::endl
+            << "                         subsequences of each sequence pair."
+            << std::endl
+            << "  --sort-result          Merge the result into a globally"
+            << std::endl
+            << "                         sorted file." << std::endl
+            << "  --index-result         Sort the result by the sequences and"
+            << std::endl
+            << "                         build the index for lookup."
+            << std::endl;
+}
+
+/**
+ * Parse the options to `gEnv` and collect the other arguments.
+ *
+ * @return false: an option is invalid.
+ * */
+bool ParseArguments(int argc, char* argv[], std::vector<std::string>& args) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+
+    if (arg == "--memory-limit") {
+      uint64_t size = 0;
+      if (i + 1 >= argc || !pcpe::ParseSize(argv[i + 1], size)) {
+        LOG_ERROR() << "Invalid value of --memory-limit." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setMemoryLimit(size);
+      ++i;
+    } else if (arg == "--temp-budget") {
+      uint64_t size = 0;
+      if (i + 1 >= argc || !pcpe::ParseSize(argv[i + 1], size)) {
+        LOG_ERROR() << "Invalid value of --temp-budget." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setTempBudget(size);
+      ++i;
+    } else if (arg == "--temp-dirs") {
+      std::vector<pcpe::TempFolder> folders;
+      if (i + 1 >= argc || !pcpe::ParseTempFolders(argv[i + 1], folders)) {
+        LOG_ERROR() << "Invalid value of --temp-dirs." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setTempFolders(folders);
+      ++i;
+    } else if (arg == "--temp-placement") {
+      pcpe::TempPlacement placement = pcpe::TempPlacement::kRoundRobin;
+      if (i + 1 >= argc || !pcpe::ParseTempPlacement(argv[i + 1], placement)) {
+        LOG_ERROR() << "Invalid value of --temp-placement." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setTempPlacement(placement);
+      ++i;
+    } else if (arg == "--shard") {
+      uint32_t index = 0;
+      uint32_t size = 0;
+      if (i + 1 >= argc || !pcpe::ParseShard(argv[i + 1], index, size)) {
+        LOG_ERROR() << "Invalid value of --shard." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setShard(index, size);
+      ++i;
+    } else if (arg == "--numa") {
+      pcpe::gEnv.setNuma(true);
+    } else if (arg == "--resume") {
+      pcpe::gEnv.setResume(true);
+    } else if (arg == "--incremental") {
+      pcpe::gEnv.setIncremental(true);
+    } else if (arg == "--sort-result") {
+      pcpe::gEnv.setSortResult(true);
+    } else if (arg == "--index-result") {
+      pcpe::gEnv.setIndexResult(true);
+    } else if (arg == "--best") {
+      pcpe::gEnv.setPairTopSize(1);
+    } else if (arg == "--top") {
+      char* end = nullptr;
+      const unsigned long size =
+          (i + 1 < argc) ? std::strtoul(argv[i + 1], &end, 10) : 0;
+      if (size == 0 || *end != 0 || size > UINT32_MAX) {
+        LOG_ERROR() << "Invalid value of --top." << std::endl;
+        return false;
+      }
+      pcpe::gEnv.setPairTopSize(static_cast<uint32_t>(size));
+      ++i;
+    } else if (arg.compare(0, 2, "--") == 0) {
+      LOG_ERROR() << "Unknown option: " << arg << std::endl;
+      return false;
+    } else {
+      args.push_back(arg);
+    }
+  }
+
+  return true;
+}
 
-void InitEnvironment(int argc, char* argv[]) {
+void InitEnvironment(int argc, char* argv[], std::vector<std::string>& args) {
   // Init the logging environment.
   pcpe::InitLogging(pcpe::LoggingLevel::kDebug);
 
-  // Create temp folder
-  const pcpe::FilePath& temp_folder = pcpe::gEnv.getTempFolderPath();
-  if (!pcpe::CheckFolderExists(temp_folder.c_str()))
-    pcpe::CreateFolder(temp_folder.c_str());
+  if (!ParseArguments(argc, argv, args) || args.empty()) {
+    PrintUsage(argv[0]);
+    exit(1);
+  }
 
-  if (argc <= 3) {
-    LOG_ERROR() << "Need two input file and one output filepath." << std::endl;
+  bool valid_args = (args.size() == 3);
+  if (args[0] == "serve") valid_args = (args.size() >= 3);
+  if (args[0] == "send-queries") valid_args = (args.size() == 4);
+  if (args[0] == "export") valid_args = (args.size() == 3 || args.size() == 5);
+  if (args[0] == "lookup") valid_args = (args.size() == 3 || args.size() == 4);
+  if (!valid_args) {
+    LOG_ERROR() << "Invalid number of arguments." << std::endl;
+    PrintUsage(argv[0]);
     exit(1);
   }
+
+  // The commands do not use the temp folders.
+  if (args[0] == "merge-shards" || args[0] == "query" || args[0] == "serve" ||
+      args[0] == "send-queries" || args[0] == "export" || args[0] == "lookup")
+    return;
+
+  // Each shard has its own temp folders, so the shards could share the same
+  // file system.
+  if (pcpe::gEnv.getShardSize() > 1) {
+    std::vector<pcpe::TempFolder> folders = pcpe::gEnv.getTempFolders();
+    for (auto& folder : folders)
+      folder.path += "/" + pcpe::GetShardName(pcpe::gEnv.getShardIndex(),
+                                              pcpe::gEnv.getShardSize());
+    pcpe::gEnv.setTempFolders(folders);
+  }
+
+  // Create temp folders
+  for (const auto& folder : pcpe::gEnv.getTempFolders())
+    if (!pcpe::CheckFolderExists(folder.path.c_str()))
+      pcpe::CreateFolder(folder.path.c_str());
 }
 
-int main(int argc, char* argv[]) {
-  InitEnvironment(argc, argv);
+/// Combine the shard files of `merge-shards <output_file> <shard_size>`.
+int MergeShards(const std::vector<std::string>& args) {
+  char* end = nullptr;
+  const unsigned long shard_size = std::strtoul(args[2].c_str(), &end, 10);
+  if (args[2].empty() || *end != 0 || shard_size == 0 ||
+      shard_size > UINT32_MAX) {
+    LOG_ERROR() << "Invalid shard size: " << args[2] << std::endl;
+    return 1;
+  }
 
-  pcpe::FilePath xfilepath(argv[1]);
-  pcpe::FilePath yfilepath(argv[2]);
-  pcpe::FilePath ofilepath(argv[3]);
+  return pcpe::MergeShardFiles(args[1], static_cast<uint32_t>(shard_size))
+             ? 0
+             : 1;
+}
+
+/// Read the query sequences from a file, or the standard input with `-`.
+bool ReadQueries(const std::string& filepath, pcpe::SeqList& queries) {
+  if (filepath == "-") {
+    pcpe::ReadSequences(std::cin, queries);
+  } else if (pcpe::CheckFileExists(filepath.c_str())) {
+    pcpe::ReadSequences(filepath, queries);
+  } else {
+    LOG_ERROR() << "The file does not exist - " << filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/// Write the results to the standard output and the latency of each query to
+/// the standard error.
+void PrintQueryResults(const std::vector<pcpe::QueryResult>& results) {
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    for (const auto& seq : results[i].seqs) std::cout << seq << '\n';
 
-  std::vector<pcpe::FilePath> cs_filepaths;
-  pcpe::CompareSmallSeqs(xfilepath, yfilepath, cs_filepaths);
+    std::cerr << "Query " << i << ": " << results[i].seqs.size()
+              << " results, " << results[i].latency << " us" << std::endl;
+  }
+  std::cout.flush();
+}
+
+/**
+ * Query the sequences of `query <reference_seq_file> <query_seq_file|->`
+ * against the in-memory index of the reference. The queries are read from
+ * the standard input with `-`. The results are written to the standard output
+ * and the latency of each query is written to the standard error.
+ * */
+int Query(const std::vector<std::string>& args) {
+  auto start = std::chrono::steady_clock::now();
+  pcpe::QueryIndex index;
+  if (!index.load(args[1])) return 1;
+  auto end = std::chrono::steady_clock::now();
+
+  std::cerr << "Load the index: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                     start)
+                   .count()
+            << " ms" << std::endl;
+
+  pcpe::SeqList queries;
+  if (!ReadQueries(args[2], queries)) return 1;
+
+  std::vector<pcpe::QueryResult> results;
+  index.query(queries, results);
+
+  PrintQueryResults(results);
+
+  return 0;
+}
+
+/**
+ * Serve the queries of `serve <socket_path> <reference_seq_file>...` until
+ * SIGINT or SIGTERM. The id of an index is the position of its reference file
+ * in the arguments, from 0.
+ * */
+int Serve(const std::vector<std::string>& args) {
+  // Block the signals in all threads and wait for them in the main thread.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  pcpe::QueryServer server(args[1]);
+  for (std::size_t i = 2; i < args.size(); ++i) {
+    std::unique_ptr<pcpe::QueryIndex> index(new pcpe::QueryIndex());
+    if (!index->load(args[i])) return 1;
+
+    std::cerr << "Index " << i - 2 << ": " << args[i] << std::endl;
+    server.addIndex(std::move(index));
+  }
+
+  if (!server.start()) return 1;
+
+  int received = 0;
+  sigwait(&signals, &received);
+  server.stop();
+
+  return 0;
+}
+
+/**
+ * Send the queries of
+ * `send-queries <socket_path> <index_id> <query_seq_file|->` to a server. The
+ * output is the same as `query`.
+ * */
+int SendQueries(const std::vector<std::string>& args) {
+  char* end = nullptr;
+  const unsigned long index_id = std::strtoul(args[2].c_str(), &end, 10);
+  if (args[2].empty() || *end != 0 || index_id > UINT32_MAX) {
+    LOG_ERROR() << "Invalid index id: " << args[2] << std::endl;
+    return 1;
+  }
+
+  pcpe::SeqList queries;
+  if (!ReadQueries(args[3], queries)) return 1;
+
+  std::vector<pcpe::QueryResult> results;
+  if (!pcpe::SendQueries(args[1], static_cast<uint32_t>(index_id), queries,
+                         results))
+    return 1;
+
+  PrintQueryResults(results);
+
+  return 0;
+}
+
+/**
+ * Export the result of
+ * `export <result_file> <output_file|-> [<x_id_file> <y_id_file>]` to TSV.
+ * The TSV is written to the standard output with `-`. The sequences are the
+ * ids in the id files (`*_id_css.txt`) if they are given, or the indexes.
+ * */
+int Export(const std::vector<std::string>& args) {
+  std::vector<std::string> x_ids;
+  std::vector<std::string> y_ids;
+  if (args.size() == 5 && (!pcpe::ReadSequenceIds(args[3], x_ids) ||
+                           !pcpe::ReadSequenceIds(args[4], y_ids)))
+    return 1;
+
+  return pcpe::ExportComSubseqFile(args[1], x_ids, y_ids, args[2]) ? 0 : 1;
+}
+
+/**
+ * Print the ComSubseqs of `lookup <result_file> <x> [<y>]` with the lookup
+ * index of the result file, i.e. all ComSubseqs of the x sequence, or the
+ * ComSubseqs of the sequence pair (x, y).
+ * */
+int Lookup(const std::vector<std::string>& args) {
+  uint32_t ids[2] = {0, 0};
+  for (std::size_t i = 2; i < args.size(); ++i) {
+    char* end = nullptr;
+    const unsigned long id = std::strtoul(args[i].c_str(), &end, 10);
+    if (args[i].empty() || *end != 0 || id > UINT32_MAX) {
+      LOG_ERROR() << "Invalid sequence index: " << args[i] << std::endl;
+      return 1;
+    }
+    ids[i - 2] = static_cast<uint32_t>(id);
+  }
+
+  std::vector<pcpe::ComSubseq> seqs;
+  const bool found =
+      (args.size() == 4)
+          ? pcpe::LookupComSubseqs(args[1], ids[0], ids[1], seqs)
+          : pcpe::LookupComSubseqs(args[1], ids[0], seqs);
+  if (!found) return 1;
+
+  for (const auto& seq : seqs) std::cout << seq << '\n';
+  std::cout.flush();
+
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args;
+  InitEnvironment(argc, argv, args);
 
-  std::vector<pcpe::FilePath> cs_sorted_filepaths;
-  pcpe::SortComSubseqsFiles(cs_filepaths, cs_sorted_filepaths);
+  if (args[0] == "merge-shards") return MergeShards(args);
+  if (args[0] == "query") return Query(args);
+  if (args[0] == "serve") return Serve(args);
+  if (args[0] == "send-queries") return SendQueries(args);
+  if (args[0] == "export") return Export(args);
+  if (args[0] == "lookup") return Lookup(args);
 
-  std::vector<pcpe::FilePath> max_comsubseq_filepaths;
-  pcpe::MaxSortedComSubseqs(cs_sorted_filepaths, max_comsubseq_filepaths);
+  pcpe::FilePath xfilepath(args[0]);
+  pcpe::FilePath yfilepath(args[1]);
+  pcpe::FilePath ofilepath(args[2]);
 
-  pcpe::CombineComSubSeqFiles(max_comsubseq_filepaths, ofilepath);
+  if (!pcpe::FindMaxComSubseqs(xfilepath, yfilepath, ofilepath)) return 1;
 
   return 0;
 }
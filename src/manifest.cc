@@ -0,0 +1,317 @@
+#include "manifest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include "env.h"
+#include "logging.h"
+#include "memory_budget.h"
+
+namespace pcpe {
+
+static const char* kManifestMagic = "pcpe-manifest 1";
+
+void UpdateChecksum(const char* data, std::size_t size, uint64_t& checksum) {
+  // FNV-1a 64-bit
+  const uint64_t kPrime = 1099511628211ULL;
+
+  for (std::size_t i = 0; i < size; ++i) {
+    checksum ^= static_cast<uint8_t>(data[i]);
+    checksum *= kPrime;
+  }
+}
+
+bool GetFileChecksum(const FilePath& filepath, uint64_t& size,
+                     uint64_t& checksum) {
+  size = 0;
+  checksum = kEmptyChecksum;
+
+  return UpdateFileChecksum(filepath, UINT64_MAX, size, checksum);
+}
+
+bool UpdateFileChecksum(const FilePath& filepath, uint64_t max_size,
+                        uint64_t& size, uint64_t& checksum) {
+  std::ifstream infile(filepath.c_str(),
+                       std::ifstream::in | std::ifstream::binary);
+  if (!infile) {
+    LOG_ERROR() << "Open file error - " << filepath << std::endl;
+    return false;
+  }
+
+  MemoryReservation memory(kMinIOBufferSize, GetEnv().getIOBufferSize());
+  const std::size_t buffer_size = static_cast<std::size_t>(memory.size());
+  std::unique_ptr<char[]> buffer(new char[buffer_size]);
+
+  while (infile && max_size != 0) {
+    infile.read(buffer.get(), static_cast<std::streamsize>(
+                                  std::min<uint64_t>(buffer_size, max_size)));
+    const std::size_t read_size = static_cast<std::size_t>(infile.gcount());
+
+    UpdateChecksum(buffer.get(), read_size, checksum);
+    size += read_size;
+    max_size -= read_size;
+  }
+
+  return true;
+}
+
+/// Write all data to the file.
+static bool WriteFully(int fd, const char* data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t write_size = write(fd, data, size);
+    if (write_size < 0 && errno == EINTR) continue;
+    if (write_size <= 0) return false;
+
+    data += write_size;
+    size -= static_cast<std::size_t>(write_size);
+  }
+
+  return true;
+}
+
+/**
+ * Get a line of the manifest file.
+ *
+ * @param[in] state 'D', 'C' or 'R'
+ * @param[in] continued the next line belongs to the same change
+ * */
+static std::string GetManifestLine(char state, bool continued, uint64_t size,
+                                   uint64_t checksum, const FilePath& output) {
+  std::ostringstream oss;
+  oss << state << (continued ? "+" : "") << ' ' << size << ' ' << checksum
+      << ' ' << output << '\n';
+  return oss.str();
+}
+
+Manifest::~Manifest() {
+  if (fd_ >= 0) close(fd_);
+}
+
+bool Manifest::load() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+
+  std::ifstream infile(filepath_.c_str());
+  if (!infile) return false;
+
+  std::string magic;
+  std::string signature;
+  if (!std::getline(infile, magic) || magic != kManifestMagic ||
+      !std::getline(infile, signature)) {
+    LOG_WARNING() << "Invalid manifest - " << filepath_ << std::endl;
+    return false;
+  }
+
+  if (signature != signature_) {
+    LOG_WARNING() << "The manifest is of another run - " << filepath_
+                  << std::endl;
+    return false;
+  }
+
+  // The lines of the change which is not complete yet.
+  struct Change {
+    FilePath output;
+    bool removed;
+    Entry entry;
+  };
+  std::vector<Change> changes;
+
+  std::string line;
+  while (std::getline(infile, line)) {
+    // The last line without the line break is torn by a crash.
+    if (infile.eof()) break;
+
+    std::istringstream iss(line);
+    std::string state;
+    Change change;
+    if (!(iss >> state >> change.entry.size >> change.entry.checksum) ||
+        state.empty() || state.size() > 2 ||
+        (state[0] != 'D' && state[0] != 'C' && state[0] != 'R') ||
+        (state.size() == 2 && state[1] != '+') || iss.get() != ' ' ||
+        !std::getline(iss, change.output) || change.output.empty()) {
+      LOG_WARNING() << "Invalid manifest entry - " << line << std::endl;
+      entries_.clear();
+      return false;
+    }
+
+    change.removed = (state[0] == 'R');
+    change.entry.consumed = (state[0] == 'C');
+    changes.push_back(change);
+    if (state.size() == 2) continue;
+
+    for (const auto& c : changes) {
+      if (c.removed)
+        entries_.erase(c.output);
+      else
+        entries_[c.output] = c.entry;
+    }
+    changes.clear();
+  }
+
+  if (!changes.empty() || !line.empty())
+    LOG_WARNING() << "Ignore the torn change of the manifest - " << filepath_
+                  << std::endl;
+
+  return true;
+}
+
+bool Manifest::save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return saveLocked();
+}
+
+bool Manifest::saveLocked() {
+  const FilePath tmp_filepath = filepath_ + ".tmp";
+
+  std::ostringstream oss;
+  oss << kManifestMagic << '\n' << signature_ << '\n';
+  for (const auto& entry : entries_)
+    oss << GetManifestLine(entry.second.consumed ? 'C' : 'D', false,
+                           entry.second.size, entry.second.checksum,
+                           entry.first);
+  const std::string content = oss.str();
+
+  const int tmp_fd =
+      open(tmp_filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (tmp_fd < 0) {
+    LOG_ERROR() << "Open file error - " << tmp_filepath << std::endl;
+    return false;
+  }
+
+  const bool written = WriteFully(tmp_fd, content.data(), content.size()) &&
+                       fsync(tmp_fd) == 0;
+  if (close(tmp_fd) != 0 || !written ||
+      std::rename(tmp_filepath.c_str(), filepath_.c_str()) != 0) {
+    LOG_ERROR() << "Write manifest error - " << filepath_ << std::endl;
+    return false;
+  }
+
+  // The later changes are appended to the new file.
+  if (fd_ >= 0) close(fd_);
+  fd_ = open(filepath_.c_str(), O_WRONLY | O_APPEND);
+  if (fd_ < 0) {
+    LOG_ERROR() << "Open file error - " << filepath_ << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool Manifest::appendLocked(const std::string& lines) {
+  // The first change after the manifest is created or loaded writes the
+  // whole file, which has the change already.
+  if (fd_ < 0) return saveLocked();
+
+  if (!WriteFully(fd_, lines.data(), lines.size()) || fsync(fd_) != 0) {
+    LOG_ERROR() << "Write manifest error - " << filepath_ << std::endl;
+
+    // The file could end with a torn line. The next change rewrites it.
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  return true;
+}
+
+bool Manifest::isDone(const FilePath& output) const {
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto iter = entries_.find(output);
+    if (iter == entries_.end()) return false;
+
+    entry = iter->second;
+  }
+
+  if (entry.consumed) return true;
+  if (!CheckFileExists(output.c_str())) return false;
+
+  uint64_t size = 0;
+  uint64_t checksum = 0;
+  if (!GetFileChecksum(output, size, checksum)) return false;
+
+  return size == entry.size && checksum == entry.checksum;
+}
+
+bool Manifest::isConsumed(const FilePath& output) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = entries_.find(output);
+  return iter != entries_.end() && iter->second.consumed;
+}
+
+bool Manifest::getRecord(const FilePath& output, uint64_t& size,
+                         uint64_t& checksum) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = entries_.find(output);
+  if (iter == entries_.end()) return false;
+
+  size = iter->second.size;
+  checksum = iter->second.checksum;
+  return true;
+}
+
+bool Manifest::record(const FilePath& output) {
+  uint64_t size = 0;
+  uint64_t checksum = 0;
+  if (!GetFileChecksum(output, size, checksum)) return false;
+
+  return record(output, size, checksum);
+}
+
+bool Manifest::record(const FilePath& output, uint64_t size,
+                      uint64_t checksum) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[output];
+  entry.size = size;
+  entry.checksum = checksum;
+  entry.consumed = false;
+  return appendLocked(GetManifestLine('D', false, size, checksum, output));
+}
+
+bool Manifest::consume(const FilePath& output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[output];
+  entry.consumed = true;
+  return appendLocked(
+      GetManifestLine('C', false, entry.size, entry.checksum, output));
+}
+
+bool Manifest::append(const FilePath& output, uint64_t size,
+                      uint64_t checksum, const FilePath& input) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[output];
+  entry.size = size;
+  entry.checksum = checksum;
+  entry.consumed = false;
+
+  Entry& input_entry = entries_[input];
+  input_entry.consumed = true;
+  return appendLocked(
+      GetManifestLine('D', true, size, checksum, output) +
+      GetManifestLine('C', false, input_entry.size, input_entry.checksum,
+                      input));
+}
+
+bool Manifest::remove(const FilePath& output) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.erase(output) == 0) return true;
+
+  return appendLocked(GetManifestLine('R', false, 0, 0, output));
+}
+
+std::size_t Manifest::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+}  // namespace pcpe
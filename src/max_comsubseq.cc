@@ -1,5 +1,6 @@
 #include "max_comsubseq.h"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <sstream>
@@ -8,6 +9,7 @@
 #include "com_subseq.h"
 #include "env.h"
 #include "logging.h"
+#include "memory_budget.h"
 #include "pcpe_util.h"
 #include "simple_task.h"
 
@@ -58,16 +60,79 @@ std::size_t RemoveMergedComSubseqs(ComSubseq* seqs, bool* merges,
   return new_seqs_size;
 }
 
-void WriteMergedComSubseqs(ComSubseqFileWriter& writer, ComSubseq* seqs,
-                           bool* merges, std::size_t seqs_size) {
-  const std::size_t min_output_length = gEnv.getMinimumOutputLength();
+void PairTopComSubseqs::add(const ComSubseq& run,
+                            std::vector<ComSubseq>& seqs) {
+  if (size_ == 0) {
+    seqs.push_back(run);
+    return;
+  }
+
+  if (!runs_.empty() && !runs_.front().seq.isSameSeqeunce(run)) flush(seqs);
+
+  const Run entry{run, next_index_++};
+  if (runs_.size() < size_) {
+    runs_.push_back(entry);
+    std::push_heap(runs_.begin(), runs_.end(), isBetter);
+  } else if (isBetter(entry, runs_.front())) {
+    std::pop_heap(runs_.begin(), runs_.end(), isBetter);
+    runs_.back() = entry;
+    std::push_heap(runs_.begin(), runs_.end(), isBetter);
+  }
+}
+
+void PairTopComSubseqs::flush(std::vector<ComSubseq>& seqs) {
+  std::sort(runs_.begin(), runs_.end(),
+            [](const Run& x, const Run& y) { return x.index < y.index; });
+
+  for (const auto& run : runs_) seqs.push_back(run.seq);
+  runs_.clear();
+}
+
+/// Write the merged ComSubseqs through the selection of each pair. The
+/// selected runs of the last pair stay in `top` until it's flushed.
+static void WriteMergedComSubseqs(ComSubseqFileWriter& writer,
+                                  PairTopComSubseqs& top, ComSubseq* seqs,
+                                  bool* merges, std::size_t seqs_size) {
+  const std::size_t min_output_length = GetEnv().getMinimumOutputLength();
+
+  std::vector<ComSubseq> top_runs;
+  for (std::size_t i = 0; i < seqs_size; ++i) {
+    if (merges[i] || seqs[i].getLength() < min_output_length) continue;
 
-  for (std::size_t i = 0; i < seqs_size; ++i)
-    if (!merges[i] && seqs[i].getLength() >= min_output_length)
+    if (top.size() == 0) {
       writer.writeSeq(seqs[i]);
+      continue;
+    }
+
+    top.add(seqs[i], top_runs);
+    for (const auto& run : top_runs) writer.writeSeq(run);
+    top_runs.clear();
+  }
+}
+
+/// Write the selected runs of the last pair.
+static void FlushMergedComSubseqs(ComSubseqFileWriter& writer,
+                                  PairTopComSubseqs& top) {
+  std::vector<ComSubseq> top_runs;
+  top.flush(top_runs);
+  for (const auto& run : top_runs) writer.writeSeq(run);
+}
+
+void WriteMergedComSubseqs(ComSubseqFileWriter& writer, ComSubseq* seqs,
+                           bool* merges, std::size_t seqs_size) {
+  PairTopComSubseqs top(GetEnv().getPairTopSize());
+  WriteMergedComSubseqs(writer, top, seqs, merges, seqs_size);
+  FlushMergedComSubseqs(writer, top);
 }
 
 void MergeComSubseqsFile(const FilePath& ifilepath, const FilePath& ofilepath) {
+  FileSize file_size = 0;
+  GetFileSize(ifilepath.c_str(), file_size);
+  const uint64_t seqs_size =
+      static_cast<uint64_t>(file_size) / sizeof(ComSubseq);
+  const uint64_t memory_size = seqs_size * (sizeof(ComSubseq) + sizeof(bool));
+  MemoryReservation memory(memory_size, memory_size);
+
   // Create read buffer and merges
   std::vector<ComSubseq> seqs;
   ReadComSubseqFile(ifilepath, seqs);
@@ -96,8 +161,14 @@ std::size_t GetCurrentProcessSize(ComSubseq* seqs, std::size_t seqs_size) {
 
 void MergeComSubseqsLargeFile(const FilePath& ifilepath,
                               const FilePath& ofilepath) {
-  // Create the read buffer and check list.
-  const std::size_t max_seqs_size = gEnv.getBufferSize() / sizeof(ComSubseq);
+  // Create the read buffer and check list. The buffer could be shrunk when
+  // the memory budget is not enough.
+  MemoryReservation memory(GetEnv().getBufferSize() / 4,
+                           GetEnv().getBufferSize());
+  const std::size_t max_seqs_size = std::max<std::size_t>(
+      static_cast<std::size_t>(memory.size()) /
+          (sizeof(ComSubseq) + sizeof(bool)),
+      2);
   std::unique_ptr<ComSubseq[]> seqs(new ComSubseq[max_seqs_size]);
   std::unique_ptr<bool[]> merges(new bool[max_seqs_size]);
 
@@ -105,6 +176,9 @@ void MergeComSubseqsLargeFile(const FilePath& ifilepath,
                       std::ifstream::in | std::ifstream::binary);
   ComSubseqFileWriter writer(ofilepath);
 
+  // The runs of a pair could span several buffers.
+  PairTopComSubseqs top(GetEnv().getPairTopSize());
+
   FileSize file_size;
   GetFileSize(ifilepath.c_str(), file_size);
 
@@ -152,7 +226,8 @@ void MergeComSubseqsLargeFile(const FilePath& ifilepath,
     }
 
     // Write the result
-    WriteMergedComSubseqs(writer, seqs.get(), merges.get(), process_seqs_size);
+    WriteMergedComSubseqs(writer, top, seqs.get(), merges.get(),
+                          process_seqs_size);
 
     // Move unprocessed seqs to the begin of the buffer.
     unprocess_seqs_size = seqs_size - process_seqs_size;
@@ -161,10 +236,66 @@ void MergeComSubseqsLargeFile(const FilePath& ifilepath,
                 seqs.get());
   }
 
+  FlushMergedComSubseqs(writer, top);
+
   ifile.close();
   writer.close();
 }
 
+MaxComSubseqFileWriter::MaxComSubseqFileWriter(const FilePath& filepath)
+    : writer_(filepath),
+      min_output_length_(GetEnv().getMinimumOutputLength()),
+      top_(GetEnv().getPairTopSize()),
+      top_runs_(),
+      has_run_(false),
+      run_(),
+      last_() {}
+
+MaxComSubseqFileWriter::~MaxComSubseqFileWriter() {
+  if (is_open()) close();
+}
+
+bool MaxComSubseqFileWriter::writeSeq(const ComSubseq& seq) {
+  if (has_run_ && last_.isContinued(seq)) {
+    run_.setLength(run_.getLength() + 1);
+    last_ = seq;
+    return true;
+  }
+
+  writeRun();
+
+  run_ = seq;
+  last_ = seq;
+  has_run_ = true;
+
+  return writer_.is_open();
+}
+
+void MaxComSubseqFileWriter::writeRun() {
+  if (has_run_ && run_.getLength() >= min_output_length_) {
+    if (top_.size() == 0) {
+      writer_.writeSeq(run_);
+    } else {
+      top_.add(run_, top_runs_);
+      writeTopRuns();
+    }
+  }
+
+  has_run_ = false;
+}
+
+void MaxComSubseqFileWriter::writeTopRuns() {
+  for (const auto& run : top_runs_) writer_.writeSeq(run);
+  top_runs_.clear();
+}
+
+bool MaxComSubseqFileWriter::close() {
+  writeRun();
+  top_.flush(top_runs_);
+  writeTopRuns();
+  return writer_.close();
+}
+
 class FindMaxComSubseqTask {
  public:
   FindMaxComSubseqTask(const FilePath& input, const FilePath& output)
@@ -172,6 +303,13 @@ class FindMaxComSubseqTask {
 
   void exec();
 
+  /// The estimated cost is the size of the input file.
+  uint64_t cost() const {
+    FileSize file_size = 0;
+    GetFileSize(ifilepath_.c_str(), file_size);
+    return static_cast<uint64_t>(file_size);
+  }
+
   const FilePath& getOutput() const { return ofilepath_; }
 
  private:
@@ -183,7 +321,7 @@ void FindMaxComSubseqTask::exec() {
   FileSize file_size;
   GetFileSize(ifilepath_.c_str(), file_size);
 
-  if (file_size < gEnv.getBufferSize()) {
+  if (file_size < GetEnv().getBufferSize()) {
     // The file size is less than buffer size so it reads all seqs and merge
     // them in one time.
     MergeComSubseqsFile(ifilepath_, ofilepath_);
@@ -199,7 +337,7 @@ void FindMaxComSubseqTask::exec() {
 static void CreateFindMaxComSubseqTasks(
     const std::vector<FilePath>& ifilepaths,
     std::vector<std::unique_ptr<FindMaxComSubseqTask>>& tasks) {
-  const FilePath& temp_folder = gEnv.getTempFolderPath();
+  const FilePath& temp_folder = GetEnv().getTempFolderPath();
 
   std::size_t curr_index = 0;
   for (const auto& input : ifilepaths) {
@@ -0,0 +1,93 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+
+#include "env.h"
+
+namespace pcpe {
+
+/// The number of reservations held by the current thread.
+static thread_local std::size_t tReservationSize = 0;
+
+uint64_t MemoryBudget::reserve(uint64_t min_size, uint64_t max_size,
+                               bool nested) {
+  min_size = std::min(min_size, max_size);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  uint64_t size = max_size;
+  if (limit_ != 0) {
+    // A request larger than the whole budget is reduced to the budget.
+    min_size = std::min(min_size, limit_);
+
+    if (!nested)
+      cv_.wait(lock, [this, min_size]() {
+        return limit_ == 0 || used_size_ + min_size <= limit_;
+      });
+
+    if (limit_ != 0) {
+      const uint64_t available =
+          (used_size_ < limit_) ? limit_ - used_size_ : 0;
+      size = std::max(min_size, std::min(max_size, available));
+    }
+  }
+
+  used_size_ += size;
+  peak_size_ = std::max(peak_size_, used_size_);
+
+  return size;
+}
+
+void MemoryBudget::release(uint64_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_size_ = (size < used_size_) ? used_size_ - size : 0;
+  }
+  cv_.notify_all();
+}
+
+void MemoryBudget::setLimit(uint64_t limit) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limit_ = limit;
+  }
+  cv_.notify_all();
+}
+
+uint64_t MemoryBudget::getLimit() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return limit_;
+}
+
+uint64_t MemoryBudget::getUsedSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return used_size_;
+}
+
+uint64_t MemoryBudget::getPeakSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_size_;
+}
+
+MemoryBudget& GetMemoryBudget() {
+  static MemoryBudget budget(gEnv.getMemoryLimit());
+  return budget;
+}
+
+MemoryReservation::MemoryReservation(MemoryBudget& budget, uint64_t min_size,
+                                     uint64_t max_size)
+    : budget_(budget),
+      size_(budget.reserve(min_size, max_size, tReservationSize != 0)),
+      released_(false) {
+  tReservationSize++;
+}
+
+void MemoryReservation::release() {
+  if (released_) return;
+
+  budget_.release(size_);
+  tReservationSize--;
+  released_ = true;
+}
+
+}  // namespace pcpe
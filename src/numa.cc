@@ -0,0 +1,127 @@
+#include "numa.h"
+
+#include <dirent.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "logging.h"
+
+namespace pcpe {
+
+bool ParseCpuList(const std::string& str, std::vector<uint32_t>& cpus) {
+  std::istringstream iss(str);
+  std::string range;
+
+  while (std::getline(iss, range, ',')) {
+    // Remove the line break of the sysfs file.
+    range.erase(std::remove_if(range.begin(), range.end(),
+                               [](char c) { return c == '\n' || c == ' '; }),
+                range.end());
+    if (range.empty()) continue;
+
+    char* end = nullptr;
+    const unsigned long first = std::strtoul(range.c_str(), &end, 10);
+    if (end == range.c_str()) return false;
+
+    unsigned long last = first;
+    if (*end == '-') {
+      const char* last_str = end + 1;
+      last = std::strtoul(last_str, &end, 10);
+      if (end == last_str || last < first) return false;
+    }
+    if (*end != 0) return false;
+
+    for (unsigned long cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(static_cast<uint32_t>(cpu));
+  }
+
+  return true;
+}
+
+/// Get the CPUs which the process is allowed to run on. Return false if the
+/// system does not support it.
+static bool GetAllowedCpus(std::vector<uint32_t>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) return false;
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    if (CPU_ISSET(cpu, &set)) cpus.push_back(static_cast<uint32_t>(cpu));
+
+  return true;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+void GetNumaNodes(std::vector<NumaNode>& nodes, const FilePath& sysfs_path) {
+  DIR* dir = opendir(sysfs_path.c_str());
+  if (dir == nullptr) return;
+
+  std::vector<uint32_t> allowed_cpus;
+  const bool has_allowed_cpus = GetAllowedCpus(allowed_cpus);
+
+  for (struct dirent* entry = readdir(dir); entry != nullptr;
+       entry = readdir(dir)) {
+    // The folder of a node is `node<N>`.
+    const char* name = entry->d_name;
+    if (std::strncmp(name, "node", 4) != 0 || name[4] == 0) continue;
+
+    char* end = nullptr;
+    const unsigned long id = std::strtoul(name + 4, &end, 10);
+    if (*end != 0) continue;
+
+    std::ifstream infile(sysfs_path + "/" + name + "/cpulist");
+    std::string cpulist;
+    if (!infile || !std::getline(infile, cpulist)) continue;
+
+    NumaNode node;
+    node.id = static_cast<uint32_t>(id);
+    if (!ParseCpuList(cpulist, node.cpus)) {
+      LOG_WARNING() << "Invalid CPU list of NUMA node " << id << ": "
+                    << cpulist << std::endl;
+      continue;
+    }
+
+    if (has_allowed_cpus)
+      node.cpus.erase(
+          std::remove_if(node.cpus.begin(), node.cpus.end(),
+                         [&allowed_cpus](uint32_t cpu) {
+                           return !std::binary_search(allowed_cpus.begin(),
+                                                      allowed_cpus.end(), cpu);
+                         }),
+          node.cpus.end());
+
+    if (!node.cpus.empty()) nodes.push_back(node);
+  }
+
+  closedir(dir);
+
+  std::sort(nodes.begin(), nodes.end(),
+            [](const NumaNode& x, const NumaNode& y) { return x.id < y.id; });
+}
+
+bool BindCurrentThread(const std::vector<uint32_t>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (uint32_t cpu : cpus)
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+}  // namespace pcpe
@@ -0,0 +1,93 @@
+#include "pcpe.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+
+#include "logging.h"
+#include "memory_budget.h"
+#include "small_seq_hash.h"
+#include "temp_folder.h"
+
+namespace pcpe {
+
+/**
+ * Find the maximum common subseqences with the file pipeline and read the
+ * result file to the callback.
+ * */
+static bool FindMaxComSubseqsWithFiles(const SeqList& xs, const SeqList& ys,
+                                       const ComSubseqCallback& callback) {
+  // The files of different calls have different names.
+  static std::atomic<uint32_t> call_count(0);
+  std::ostringstream oss;
+  oss << "library_" << call_count++;
+  const std::string name = oss.str();
+
+  GetRunContext().createTempFolders();
+
+  const FilePath xfilepath = GetTempFilePath(name + "_x_seq.txt", 0);
+  const FilePath yfilepath = GetTempFilePath(name + "_y_seq.txt", 1);
+  const FilePath ofilepath = GetTempFilePath(name + "_result.bin", 2);
+
+  // The result of a failed run is incomplete, so it's not delivered.
+  const bool found = WriteSequences(xfilepath, xs) &&
+                     WriteSequences(yfilepath, ys) &&
+                     FindMaxComSubseqs(xfilepath, yfilepath, ofilepath);
+  if (found) {
+    ComSubseqFileReader reader(ofilepath);
+    ComSubseq seq;
+    while (!reader.eof() && reader.readSeq(seq)) callback(seq);
+    reader.close();
+  }
+
+  std::remove(xfilepath.c_str());
+  std::remove(yfilepath.c_str());
+  std::remove(ofilepath.c_str());
+  std::remove(GetRunIndexFilePath(ofilepath).c_str());
+
+  return found;
+}
+
+bool FindMaxComSubseqs(const SeqList& xs, const SeqList& ys,
+                       const ComSubseqCallback& callback) {
+  const uint64_t table_size =
+      EstimateSmallSeqsMemorySize(GetSmallSeqSize(ys, 0, ys.size()));
+  const uint64_t memory_limit = GetEnv().getMemoryLimit();
+  if (memory_limit != 0 && table_size > memory_limit / 2) {
+    LOG_INFO() << "The hash table does not fit the memory limit. Use the temp "
+                  "files."
+               << std::endl;
+    return FindMaxComSubseqsWithFiles(xs, ys, callback);
+  }
+
+  QueryIndex index;
+  index.build(ys);
+
+  const std::size_t batch_size =
+      std::max<std::size_t>(GetEnv().getCompareSeqenceSize(), 1);
+  std::vector<QuerySeq> queries;
+  std::vector<QueryResult> results;
+  for (std::size_t begin = 0; begin < xs.size(); begin += batch_size) {
+    const std::size_t end = std::min(begin + batch_size, xs.size());
+
+    queries.clear();
+    for (std::size_t i = begin; i < end; ++i)
+      queries.emplace_back(&xs[i], static_cast<uint32_t>(i));
+
+    index.query(queries, results);
+    for (const auto& result : results)
+      for (const auto& seq : result.seqs) callback(seq);
+  }
+
+  return true;
+}
+
+bool FindMaxComSubseqs(RunContext& context, const SeqList& xs,
+                       const SeqList& ys, const ComSubseqCallback& callback) {
+  ScopedRunContext scope(context);
+  return FindMaxComSubseqs(xs, ys, callback);
+}
+
+}  // namespace pcpe
@@ -1,5 +1,7 @@
 #include "pcpe_util.h"
 
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <memory>
@@ -70,4 +72,63 @@ bool CheckFileNotEmpty(const char* path) {
   return true;
 }
 
+bool ParseSize(const char* str, uint64_t& size) {
+  if (str == nullptr || !std::isdigit(static_cast<unsigned char>(*str)))
+    return false;
+
+  char* end = nullptr;
+  const unsigned long long value = std::strtoull(str, &end, 10);
+
+  uint64_t unit = 1;
+  switch (std::toupper(static_cast<unsigned char>(*end))) {
+    case 'K':
+      unit = 1ULL << 10;
+      ++end;
+      break;
+    case 'M':
+      unit = 1ULL << 20;
+      ++end;
+      break;
+    case 'G':
+      unit = 1ULL << 30;
+      ++end;
+      break;
+    case 'T':
+      unit = 1ULL << 40;
+      ++end;
+      break;
+    default:
+      break;
+  }
+
+  if (std::toupper(static_cast<unsigned char>(*end)) == 'B') ++end;
+  if (*end != 0) return false;
+
+  // Overflow
+  if (value > UINT64_MAX / unit) return false;
+
+  size = static_cast<uint64_t>(value) * unit;
+  return true;
+}
+
+bool ParseShard(const char* str, uint32_t& index, uint32_t& size) {
+  if (str == nullptr || !std::isdigit(static_cast<unsigned char>(*str)))
+    return false;
+
+  char* end = nullptr;
+  const unsigned long long shard_index = std::strtoull(str, &end, 10);
+  if (*end != '/' || !std::isdigit(static_cast<unsigned char>(end[1])))
+    return false;
+
+  const char* size_str = end + 1;
+  const unsigned long long shard_size = std::strtoull(size_str, &end, 10);
+  if (*end != 0 || shard_size == 0 || shard_size > UINT32_MAX ||
+      shard_index >= shard_size)
+    return false;
+
+  index = static_cast<uint32_t>(shard_index);
+  size = static_cast<uint32_t>(shard_size);
+  return true;
+}
+
 }  // namespace pcpe
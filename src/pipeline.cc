@@ -0,0 +1,861 @@
+#include "pipeline.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "com_subseq.h"
+#include "com_subseq_sort.h"
+#include "env.h"
+#include "logging.h"
+#include "manifest.h"
+#include "max_comsubseq.h"
+#include "memory_budget.h"
+#include "pcpe_util.h"
+#include "run_context.h"
+#include "result_lookup.h"
+#include "run_index.h"
+#include "seq.h"
+#include "small_seq_hash.h"
+#include "task_graph.h"
+#include "temp_folder.h"
+
+namespace pcpe {
+
+class FindMaxComSubseqPairTask {
+ public:
+  FindMaxComSubseqPairTask(const FilePath& x_filepath,
+                           const FilePath& y_filepath, const FilePath& output)
+      : x_filepath_(x_filepath), y_filepath_(y_filepath), output_(output) {}
+
+  /// Return false if the output can not be written.
+  bool exec();
+
+  const FilePath& getOutput() const { return output_; }
+
+ private:
+  FilePath x_filepath_;
+  FilePath y_filepath_;
+
+  FilePath output_;
+};
+
+bool FindMaxComSubseqPairTask::exec() {
+  // There is no common subseqence. The empty output is still written so it
+  // can be recorded.
+  if (!CheckFileNotEmpty(x_filepath_.c_str()) ||
+      !CheckFileNotEmpty(y_filepath_.c_str())) {
+    std::ofstream outfile(output_.c_str(),
+                          std::ofstream::out | std::ofstream::binary);
+    if (!outfile) {
+      LOG_ERROR() << "Open file error - " << output_ << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Compare the two hash tables. The result stays in memory unless it's
+  // larger than the buffer size.
+  ComSubseqSortBuffer buffer(output_);
+  CompareHashTableFiles(x_filepath_, y_filepath_, buffer);
+
+  // Sort and merge the continuous ComSubseqs. A large result is merged from
+  // the spilled runs with all threads.
+  if (!buffer.sortMaxTo(output_)) {
+    LOG_ERROR() << "Find max common subseqences error - " << output_
+                << std::endl;
+    return false;
+  }
+
+  LOG_INFO() << "Find max common subseqences of " << x_filepath_ << " and "
+             << y_filepath_ << " - " << output_ << " (" << buffer.getSpillSize()
+             << " spilled runs)" << std::endl;
+  return true;
+}
+
+/**
+ * An intermediate file of the pipeline. The file is deleted as soon as the
+ * last task which consumes it is finished, and it's marked consumed in the
+ * manifest so a resumed run does not create it again.
+ * */
+class IntermediateFile {
+ public:
+  /**
+   * @param[in] filepath the path of the file
+   * @param[in] temp_size the projected size of the file. It's released from
+   *                      the temp budget of the graph after the file is
+   *                      deleted.
+   * */
+  IntermediateFile(const FilePath& filepath, uint64_t temp_size)
+      : filepath_(filepath), temp_size_(temp_size), consumers_(0) {}
+
+  const FilePath& getFilePath() const { return filepath_; }
+  uint64_t getTempSize() const { return temp_size_; }
+
+  /// Add a consumer. All consumers are added before the graph runs.
+  void addConsumer() { consumers_++; }
+
+  /// A consumer is finished. The file is deleted after the last one.
+  void release(Manifest& manifest, TaskGraph& graph);
+
+ private:
+  FilePath filepath_;
+  uint64_t temp_size_;
+  std::atomic<std::size_t> consumers_;
+};
+
+void IntermediateFile::release(Manifest& manifest, TaskGraph& graph) {
+  if (consumers_.fetch_sub(1) != 1) return;
+
+  manifest.consume(filepath_);
+  std::remove(filepath_.c_str());
+  graph.releaseResource(temp_size_);
+
+  LOG_DEBUG() << "Delete the consumed file - " << filepath_ << std::endl;
+}
+
+/// The inputs and the outputs of a run of the task graph.
+struct PipelineRun {
+  PipelineRun()
+      : xs(),
+        ys(),
+        x_base_size(0),
+        y_base_size(0),
+        result_filepath(nullptr),
+        result_size(0),
+        result_checksum(kEmptyChecksum),
+        result_failed(false),
+        ofilepaths() {}
+
+  SeqList xs;
+  SeqList ys;
+
+  /// The numbers of the sequences compared by the base run. Only the pairs
+  /// with the other sequences are computed.
+  std::size_t x_base_size;
+  std::size_t y_base_size;
+
+  /// The result file. If it's null, the outputs of the pairs are kept.
+  const FilePath* result_filepath;
+
+  /// The size and the checksum of the result file after the run.
+  uint64_t result_size;
+  uint64_t result_checksum;
+
+  /// A task failed or an output can not be appended or merged to the result
+  /// file, so the result is incomplete. The outputs which are not appended
+  /// are kept for the next run.
+  std::atomic<bool> result_failed;
+
+  /// The outputs of the pairs if there is no result file.
+  std::vector<FilePath> ofilepaths;
+};
+
+/**
+ * Get the signature of the pipeline for the manifest. It contains the inputs
+ * and the settings which decide the temp files.
+ * */
+static std::string GetPipelineSignature(const PipelineRun& run) {
+  std::ostringstream oss;
+  oss << run.xs.size() << ":" << GetSeqListChecksum(run.xs, run.xs.size())
+      << " " << run.ys.size() << ":"
+      << GetSeqListChecksum(run.ys, run.ys.size()) << " " << run.x_base_size
+      << " " << run.y_base_size << " " << GetEnv().getCompareSeqenceSize()
+      << " " << GetRunSettings() << " "
+      << (run.result_filepath == nullptr
+              ? "separate"
+              : (GetEnv().getSortResult() ? "sorted" : "combine"))
+      << " "
+      << GetEnv().getShardIndex() << "/" << GetEnv().getShardSize();
+
+  return oss.str();
+}
+
+/**
+ * Split the sequences to chunks of `GetEnv().getCompareSeqenceSize()`
+ * sequences. The sequences of the base run and the other sequences are split
+ * separately, so the chunks of the base run are the same as the base run.
+ *
+ * @param[out] steps the first sequence of each chunk and the end
+ *
+ * @return the number of the chunks of the base run
+ * */
+static std::size_t GetChunkSteps(std::size_t base_size, std::size_t size,
+                                 std::vector<std::size_t>& steps) {
+  const std::size_t unit = GetEnv().getCompareSeqenceSize();
+
+  steps.push_back(0);
+  for (std::size_t curr = unit; curr < base_size; curr += unit)
+    steps.push_back(curr);
+  if (base_size != 0) steps.push_back(base_size);
+
+  const std::size_t base_chunk_size = steps.size() - 1;
+  for (std::size_t curr = base_size + unit; curr < size; curr += unit)
+    steps.push_back(curr);
+  if (size > base_size) steps.push_back(size);
+
+  return base_chunk_size;
+}
+
+/**
+ * Wrap the task with the manifest. If the output of the task is recorded and
+ * the file is the same as the record, the task is skipped. Otherwise the task
+ * runs and the output is recorded if the task returns true.
+ *
+ * If a task fails, `failed` is set and the tasks which are not started yet
+ * do not run, since they may use the incomplete output.
+ * */
+static TaskGraph::Task CheckpointTask(Manifest& manifest,
+                                      std::atomic<std::size_t>& skip_size,
+                                      std::atomic<bool>& failed,
+                                      const FilePath* output,
+                                      std::function<bool()> task) {
+  return [&manifest, &skip_size, &failed, output, task]() {
+    if (manifest.isDone(*output)) {
+      skip_size++;
+      LOG_INFO() << "Skip the finished task - " << *output << std::endl;
+      return;
+    }
+
+    if (failed.load()) return;
+
+    if (!task()) {
+      LOG_ERROR() << "The task failed - " << *output << std::endl;
+      failed = true;
+      return;
+    }
+    manifest.record(*output);
+  };
+}
+
+/**
+ * Place an intermediate file on the temp folders. A file recorded in the
+ * manifest stays on the folder of the last run so it can be resumed.
+ * */
+static FilePath PlaceTempFile(const Manifest& manifest, const std::string& name,
+                              std::size_t index) {
+  for (const auto& folder : GetEnv().getTempFolders()) {
+    const FilePath filepath = folder.path + "/" + name;
+
+    uint64_t size = 0;
+    uint64_t checksum = 0;
+    if (manifest.getRecord(filepath, size, checksum)) return filepath;
+  }
+
+  return GetTempFilePath(name, index);
+}
+
+/**
+ * Add the tasks to construct the small-seq hash table files of the sequences.
+ * Each file contains `GetEnv().getCompareSeqenceSize()` sequences at most.
+ *
+ * The cost of each task is the number of entries of the hash table. The
+ * costs are also used to estimate the cost of the pair tasks. The projected
+ * temp size of each task is the size of the entries.
+ *
+ * The i-th hash table is the (2 * i + parity)-th temp file. The x tables take
+ * the even indexes and the y tables take the odd ones, so the two tables of a
+ * pair are on different temp folders when there are two folders.
+ *
+ * The tables which are not used by any pair of the shard are not built. Their
+ * entries of `hash_files` are null.
+ * */
+static void AddHashTableTasks(
+    TaskGraph& graph, Manifest& manifest, std::atomic<std::size_t>& skip_size,
+    std::atomic<bool>& failed, const SeqList& ss,
+    const std::vector<std::size_t>& steps, const std::vector<bool>& used,
+    const char* name, std::size_t parity,
+    std::vector<std::unique_ptr<IntermediateFile>>& hash_files,
+    std::vector<TaskGraph::NodeId>& nodes, std::vector<uint64_t>& costs) {
+  for (std::size_t i = 0; i + 1 < steps.size(); ++i) {
+    const std::size_t begin = steps[i];
+    const std::size_t end = steps[i + 1];
+
+    costs.push_back(GetSmallSeqSize(ss, begin, end));
+    if (!used[i]) {
+      hash_files.emplace_back(nullptr);
+      nodes.push_back(0);
+      continue;
+    }
+
+    std::ostringstream oss;
+    oss << "hash_table_" << name << "_" << i;
+
+    hash_files.emplace_back(new IntermediateFile(
+        PlaceTempFile(manifest, oss.str(), 2 * i + parity),
+        costs.back() * sizeof(SeqLoc)));
+
+    const FilePath* output = &hash_files.back()->getFilePath();
+    nodes.push_back(graph.addTask(
+        CheckpointTask(manifest, skip_size, failed, output,
+                       [&ss, begin, end, output]() {
+                         return CreateHashTableFile(ss, begin, end, *output);
+                       }),
+        costs.back(), hash_files.back()->getTempSize()));
+  }
+}
+
+/**
+ * Get the residue composition of each chunk of the sequences. The i-th
+ * composition is the frequencies of 'A' .. 'Z' in the sequences
+ * [steps[i], steps[i + 1]).
+ * */
+static std::vector<std::vector<double>> GetChunkCompositions(
+    const SeqList& ss, const std::vector<std::size_t>& steps) {
+  const std::size_t kResidueSize = 26;
+
+  std::vector<std::vector<double>> compositions;
+  for (std::size_t i = 0; i + 1 < steps.size(); ++i) {
+    std::vector<uint64_t> counts(kResidueSize, 0);
+    uint64_t total = 0;
+    for (std::size_t sidx = steps[i]; sidx < steps[i + 1]; ++sidx) {
+      for (const char c : ss[sidx]) {
+        if (c < 'A' || c > 'Z') continue;
+
+        counts[static_cast<std::size_t>(c - 'A')]++;
+        total++;
+      }
+    }
+
+    compositions.emplace_back(kResidueSize, 0.0);
+    for (std::size_t r = 0; r < kResidueSize && total != 0; ++r)
+      compositions.back()[r] =
+          static_cast<double>(counts[r]) / static_cast<double>(total);
+  }
+
+  return compositions;
+}
+
+/**
+ * Project the temp size of a pair task: the size of its output and the size
+ * of the spilled runs of its sort buffer (unit: byte).
+ *
+ * The number of ComSubseqs is projected from the entry sizes of the two hash
+ * tables and the residue compositions of the two chunks. With independent
+ * residues, two small seqs are the same with the probability
+ * `(sum of px(a) * py(a)) ^ small_seq_length`. In the worst case no
+ * ComSubseq is merged, so the output is charged for all ComSubseqs. They are
+ * spilled as well if they are more than the smallest sort buffer holds.
+ * */
+static void GetPairTempSize(uint64_t x_entries,
+                            const std::vector<double>& x_composition,
+                            uint64_t y_entries,
+                            const std::vector<double>& y_composition,
+                            uint64_t& output_size, uint64_t& spill_size) {
+  double match = 0.0;
+  for (std::size_t r = 0; r < x_composition.size(); ++r)
+    match += x_composition[r] * y_composition[r];
+
+  const double seqs_size =
+      static_cast<double>(x_entries) * static_cast<double>(y_entries) *
+      std::pow(match, GetEnv().getSmallSeqLength());
+  output_size = static_cast<uint64_t>(seqs_size) * sizeof(ComSubseq);
+  spill_size = output_size > GetEnv().getBufferSize() / 4 ? output_size : 0;
+}
+
+/**
+ * Prepare the result file to append the outputs of the pairs. The result
+ * file is kept to the size of the manifest record if the content is the same
+ * as the record. Otherwise it's truncated to empty.
+ *
+ * @param[out] size the size of the result file
+ * @param[out] checksum the checksum of the result file
+ *
+ * @return false: the result file is not the same as the record. The consumed
+ *                pair outputs of the last run are lost.
+ * */
+static bool PrepareResultFile(Manifest& manifest, const FilePath& filepath,
+                              uint64_t& size, uint64_t& checksum) {
+  size = 0;
+  checksum = kEmptyChecksum;
+
+  uint64_t record_size = 0;
+  uint64_t record_checksum = 0;
+  const bool same = manifest.getRecord(filepath, record_size,
+                                       record_checksum) &&
+                    UpdateFileChecksum(filepath, record_size, size, checksum) &&
+                    size == record_size && checksum == record_checksum;
+  if (!same) {
+    size = 0;
+    checksum = kEmptyChecksum;
+  }
+
+  // Drop the data appended after the last record, e.g. the program is killed
+  // during appending.
+  std::ofstream(filepath.c_str(), std::ofstream::out | std::ofstream::binary |
+                                      std::ofstream::app)
+      .close();
+  if (truncate(filepath.c_str(), static_cast<off_t>(size)) != 0)
+    LOG_ERROR() << "Truncate file error - " << filepath << std::endl;
+
+  manifest.record(filepath, size, checksum);
+  return same;
+}
+
+/**
+ * Merge the outputs of the pairs into the sorted result file with
+ * `ParallelMergeSortedComSubseqFiles`.
+ *
+ * The outputs are marked consumed before the result is recorded. If the
+ * program is killed in between, the result is not the same as the record, so
+ * the next run computes all pairs again instead of merging a part twice.
+ *
+ * If all outputs are consumed, the result of the last run is complete and is
+ * kept.
+ * */
+static void MergeSortedResultFile(
+    Manifest& manifest,
+    const std::vector<std::unique_ptr<FindMaxComSubseqPairTask>>& tasks,
+    PipelineRun& run) {
+  const FilePath& result_filepath = *run.result_filepath;
+
+  std::vector<FilePath> outputs;
+  std::vector<FilePath> ifilepaths;
+  for (const auto& task : tasks) {
+    const FilePath& output = task->getOutput();
+    if (manifest.isConsumed(output)) continue;
+
+    outputs.push_back(output);
+    if (CheckFileNotEmpty(output.c_str())) ifilepaths.push_back(output);
+  }
+
+  if (outputs.empty()) return;
+
+  const FilePath sorted_filepath = result_filepath + ".sorted";
+  if (!ParallelMergeSortedComSubseqFiles(ifilepaths, sorted_filepath) ||
+      std::rename(sorted_filepath.c_str(), result_filepath.c_str()) != 0) {
+    LOG_ERROR() << "Merge the sorted result error - " << result_filepath
+                << std::endl;
+    run.result_failed = true;
+    return;
+  }
+
+  for (const auto& output : outputs) manifest.consume(output);
+  if (GetFileChecksum(result_filepath, run.result_size, run.result_checksum))
+    manifest.record(result_filepath, run.result_size, run.result_checksum);
+
+  for (const auto& output : outputs) std::remove(output.c_str());
+}
+
+/**
+ * Build and run the task graph of the whole pipeline:
+ *
+ *   hash table (x_i) ---+
+ *                       +--> pair (x_i, y_j) --> append to the result
+ *   hash table (y_j) ---+
+ *
+ * The appending tasks are chained in the order of the pairs so the result is
+ * the same for each execution. With `GetEnv().getSortResult()`, the outputs
+ * are merged into the result after the graph instead (see
+ * `MergeSortedResultFile`).
+ *
+ * The hash tables do not exist when the graph is built, so the cost of a pair
+ * task is estimated from the sequences: the product of the entry sizes of the
+ * two hash tables.
+ *
+ * Each hash table is deleted as soon as its last pair task is finished. The
+ * output of a pair is deleted after it's appended to the result file. With
+ * `GetEnv().getTempBudget()`, a task is postponed while the projected size of
+ * the temp files which are not deleted is over the budget. A hash table task
+ * is charged for its table. A pair task is charged for its output and its
+ * spilled runs (see `GetPairTempSize`). The runs are released when the pair
+ * task is finished and the output is released when it's appended.
+ *
+ * Each finished hash table and pair task is recorded in the manifest of the
+ * temp folder. The deleted files are marked consumed, and the result file is
+ * recorded after each appending. The manifest is compacted when the graph is
+ * finished. With `GetEnv().getResume()`, the recorded
+ * tasks of the last run are skipped. A failed task is not recorded, and the
+ * tasks and the appending after it stop, so a resumed run computes it again.
+ *
+ * The pairs are numbered x-major. The pairs of two chunks of the base run
+ * are skipped. With `GetEnv().getShardSize()` > 1, only a contiguous range of
+ * the other pairs is computed, so the results of the shards in order are the
+ * same as the result of all pairs.
+ * */
+static void RunFindMaxComSubseqsGraph(PipelineRun& run) {
+  const SeqList& xs = run.xs;
+  const SeqList& ys = run.ys;
+  const FilePath* result_filepath = run.result_filepath;
+
+  // Load the finished tasks of the last run or start a new manifest.
+  Manifest manifest(GetEnv().getTempFolderPath() + "/manifest",
+                    GetPipelineSignature(run));
+  if (GetEnv().getResume() && manifest.load())
+    LOG_INFO() << "Resume with " << manifest.size() << " finished outputs."
+               << std::endl;
+  manifest.save();
+
+  std::atomic<std::size_t> skip_size(0);
+  TaskGraph graph;
+  graph.setResourceLimit(GetEnv().getTempBudget());
+
+  // Split the sequences to chunks and select the pairs with new chunks.
+  std::vector<std::size_t> x_steps;
+  const std::size_t x_base_chunk_size =
+      GetChunkSteps(run.x_base_size, xs.size(), x_steps);
+  const std::size_t x_size = x_steps.size() - 1;
+
+  std::vector<std::size_t> y_steps;
+  const std::size_t y_base_chunk_size =
+      GetChunkSteps(run.y_base_size, ys.size(), y_steps);
+  const std::size_t y_size = y_steps.size() - 1;
+
+  std::vector<std::size_t> pairs;
+  for (std::size_t i = 0; i < x_size; ++i)
+    for (std::size_t j = 0; j < y_size; ++j)
+      if (i >= x_base_chunk_size || j >= y_base_chunk_size)
+        pairs.push_back(i * y_size + j);
+
+  // Select the pairs of the shard.
+  const std::size_t pair_begin =
+      pairs.size() * GetEnv().getShardIndex() / GetEnv().getShardSize();
+  const std::size_t pair_end =
+      pairs.size() * (GetEnv().getShardIndex() + 1) / GetEnv().getShardSize();
+
+  std::vector<bool> x_used(x_size, false);
+  std::vector<bool> y_used(y_size, false);
+  for (std::size_t p = pair_begin; p < pair_end; ++p) {
+    x_used[pairs[p] / y_size] = true;
+    y_used[pairs[p] % y_size] = true;
+  }
+
+  if (run.x_base_size != 0 || run.y_base_size != 0)
+    LOG_INFO() << "Incremental run: " << pairs.size() << " of "
+               << x_size * y_size << " pairs have new sequences." << std::endl;
+
+  if (GetEnv().getShardSize() > 1)
+    LOG_INFO() << "Shard " << GetEnv().getShardIndex() << "/"
+               << GetEnv().getShardSize() << ": pairs [" << pair_begin << ", "
+               << pair_end << ") of " << pairs.size() << std::endl;
+
+  // Construct hash tables for the two sequence files.
+  std::vector<std::unique_ptr<IntermediateFile>> x_hash_files;
+  std::vector<TaskGraph::NodeId> x_hash_nodes;
+  std::vector<uint64_t> x_hash_costs;
+  AddHashTableTasks(graph, manifest, skip_size, run.result_failed, xs,
+                    x_steps, x_used, "x", 0, x_hash_files,
+                    x_hash_nodes, x_hash_costs);
+
+  std::vector<std::unique_ptr<IntermediateFile>> y_hash_files;
+  std::vector<TaskGraph::NodeId> y_hash_nodes;
+  std::vector<uint64_t> y_hash_costs;
+  AddHashTableTasks(graph, manifest, skip_size, run.result_failed, ys,
+                    y_steps, y_used, "y", 1, y_hash_files,
+                    y_hash_nodes, y_hash_costs);
+
+  // The appended pair outputs of the last run are deleted. If the result file
+  // is not the same as the record, the pairs are computed again.
+  const bool result_resumed =
+      result_filepath == nullptr ||
+      PrepareResultFile(manifest, *result_filepath, run.result_size,
+                        run.result_checksum);
+
+  const std::vector<std::vector<double>> x_compositions =
+      GetChunkCompositions(xs, x_steps);
+  const std::vector<std::vector<double>> y_compositions =
+      GetChunkCompositions(ys, y_steps);
+
+  // Compare, sort and merge each pair of hash tables as soon as the two hash
+  // tables are built.
+  std::vector<std::unique_ptr<FindMaxComSubseqPairTask>> tasks;
+  std::vector<TaskGraph::NodeId> pair_nodes;
+  std::vector<uint64_t> output_sizes;
+  for (std::size_t p = pair_begin; p < pair_end; ++p) {
+    const std::size_t k = pairs[p];
+    const std::size_t i = k / y_size;
+    const std::size_t j = k % y_size;
+
+    std::ostringstream oss;
+    oss << "max_comsubseq_" << k;
+
+    IntermediateFile* x_file = x_hash_files[i].get();
+    IntermediateFile* y_file = y_hash_files[j].get();
+    tasks.emplace_back(new FindMaxComSubseqPairTask(
+        x_file->getFilePath(), y_file->getFilePath(),
+        PlaceTempFile(manifest, oss.str(), k)));
+
+    // A pair which runs again needs its hash tables even if they are
+    // consumed by the last run.
+    FindMaxComSubseqPairTask* task = tasks.back().get();
+    if (!result_resumed) manifest.remove(task->getOutput());
+    if (!manifest.isDone(task->getOutput())) {
+      if (manifest.isConsumed(x_file->getFilePath()))
+        manifest.remove(x_file->getFilePath());
+      if (manifest.isConsumed(y_file->getFilePath()))
+        manifest.remove(y_file->getFilePath());
+    }
+
+    TaskGraph::Task pair_task =
+        CheckpointTask(manifest, skip_size, run.result_failed,
+                       &task->getOutput(), [task]() { return task->exec(); });
+    x_file->addConsumer();
+    y_file->addConsumer();
+
+    uint64_t output_size = 0;
+    uint64_t spill_size = 0;
+    GetPairTempSize(x_hash_costs[i], x_compositions[i], y_hash_costs[j],
+                    y_compositions[j], output_size, spill_size);
+    output_sizes.push_back(output_size);
+
+    TaskGraph::NodeId node = graph.addTask(
+        [pair_task, x_file, y_file, spill_size, &manifest, &graph]() {
+          pair_task();
+          graph.releaseResource(spill_size);
+          x_file->release(manifest, graph);
+          y_file->release(manifest, graph);
+        },
+        x_hash_costs[i] * y_hash_costs[j], output_size + spill_size);
+    graph.addDependency(x_hash_nodes[i], node);
+    graph.addDependency(y_hash_nodes[j], node);
+    pair_nodes.push_back(node);
+  }
+
+  LOG_INFO() << tasks.size() << " chunk pair tasks are created." << std::endl;
+
+  // Append the result of each pair to the result file and delete it. The
+  // sorted result is merged after all pairs are done.
+  const bool sorted = result_filepath != nullptr && GetEnv().getSortResult();
+  if (result_filepath != nullptr && !sorted) {
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+      FindMaxComSubseqPairTask* task = tasks[i].get();
+      const uint64_t output_size = output_sizes[i];
+      TaskGraph::NodeId node = graph.addTask([task, result_filepath,
+                                              output_size, &manifest, &graph,
+                                              &run]() {
+        const FilePath& output = task->getOutput();
+
+        // The output is appended by the last run.
+        if (manifest.isConsumed(output)) {
+          graph.releaseResource(output_size);
+          return;
+        }
+
+        // The outputs after a failed one are not appended, or the result
+        // would miss the pair in the middle.
+        if (run.result_failed) return;
+
+        // The first output becomes the result file without copying if they
+        // are on the same file system.
+        const bool moved =
+            run.result_size == 0 &&
+            std::rename(output.c_str(), result_filepath->c_str()) == 0;
+        if ((!moved && !AppendComSubseqFile(output, *result_filepath)) ||
+            !UpdateFileChecksum(moved ? *result_filepath : output, UINT64_MAX,
+                                run.result_size, run.result_checksum)) {
+          LOG_ERROR() << "Append the output error - " << output << std::endl;
+          run.result_failed = true;
+          return;
+        }
+
+        manifest.append(*result_filepath, run.result_size,
+                        run.result_checksum, output);
+        std::remove(output.c_str());
+        graph.releaseResource(output_size);
+      });
+
+      graph.addDependency(pair_nodes[i], node);
+      if (i != 0) graph.addDependency(node - 1, node);
+    }
+  }
+
+  graph.run();
+  GetRunContext().getStats().temp_peak = graph.getResourcePeak();
+
+  if (skip_size.load() != 0)
+    LOG_INFO() << skip_size.load() << " finished tasks are skipped."
+               << std::endl;
+
+  if (GetEnv().getTempBudget() != 0)
+    LOG_INFO() << "The peak projected temp size: " << graph.getResourcePeak()
+               << " / " << GetEnv().getTempBudget() << " bytes" << std::endl;
+
+  if (GetMemoryBudget().getLimit() != 0)
+    LOG_INFO() << "The peak reserved memory: "
+               << GetMemoryBudget().getPeakSize() << " / "
+               << GetMemoryBudget().getLimit() << " bytes" << std::endl;
+
+  if (sorted && !run.result_failed) MergeSortedResultFile(manifest, tasks, run);
+
+  // Compact the journal of the manifest.
+  manifest.save();
+
+  if (result_filepath != nullptr) return;
+
+  for (const auto& task : tasks)
+    if (task != nullptr && CheckFileNotEmpty(task->getOutput().c_str()))
+      run.ofilepaths.push_back(task->getOutput());
+}
+
+/// Read the sequences of the two files.
+static void ReadPipelineSequences(const FilePath& xfilepath,
+                                  const FilePath& yfilepath,
+                                  PipelineRun& run) {
+  ReadSequences(xfilepath, run.xs);
+  ReadSequences(yfilepath, run.ys);
+
+  LOG_INFO() << "Read sequences done. " << run.xs.size() << " "
+             << run.ys.size() << std::endl;
+}
+
+void FindMaxComSubseqs(const FilePath& xfilepath, const FilePath& yfilepath,
+                       std::vector<FilePath>& ofilepaths) {
+  PipelineRun run;
+  ReadPipelineSequences(xfilepath, yfilepath, run);
+  RunFindMaxComSubseqsGraph(run);
+
+  ofilepaths.swap(run.ofilepaths);
+}
+
+bool FindMaxComSubseqs(const FilePath& xfilepath, const FilePath& yfilepath,
+                       const FilePath& ofilepath) {
+  PipelineRun run;
+  ReadPipelineSequences(xfilepath, yfilepath, run);
+
+  if (GetEnv().getShardSize() > 1) {
+    // The result of the shard is renamed after it's complete, so a shard file
+    // which exists is always complete.
+    const FilePath shard_filepath = GetShardFilePath(
+        ofilepath, GetEnv().getShardIndex(), GetEnv().getShardSize());
+    const FilePath partial_filepath = shard_filepath + ".partial";
+    run.result_filepath = &partial_filepath;
+    RunFindMaxComSubseqsGraph(run);
+    if (run.result_failed) return false;
+
+    if (std::rename(partial_filepath.c_str(), shard_filepath.c_str()) != 0) {
+      LOG_ERROR() << "Rename file error - " << partial_filepath << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // The order of the result is changed, so the lookup index of the last run
+  // is out of date.
+  std::remove(GetLookupIndexFilePath(ofilepath).c_str());
+
+  const FilePath index_filepath = GetRunIndexFilePath(ofilepath);
+  RunIndex base;
+  const bool incremental = GetEnv().getIncremental() &&
+                           base.load(index_filepath) &&
+                           base.isBaseOf(run.xs, run.ys, ofilepath);
+  if (GetEnv().getIncremental() && !incremental)
+    LOG_WARNING() << "No valid base run. Compute all pairs." << std::endl;
+
+  RunIndex index;
+  if (incremental) {
+    // Compute the pairs with new sequences to a delta file and append it to
+    // the result of the base run.
+    const FilePath delta_filepath = ofilepath + ".delta";
+    run.x_base_size = base.x_size;
+    run.y_base_size = base.y_size;
+    run.result_filepath = &delta_filepath;
+    RunFindMaxComSubseqsGraph(run);
+    if (run.result_failed) return false;
+
+    // Drop the data appended after the base run, e.g. the program is killed
+    // during appending.
+    index.result_size = base.result_size;
+    index.result_checksum = base.result_checksum;
+    bool appended =
+        truncate(ofilepath.c_str(), static_cast<off_t>(base.result_size)) == 0;
+    if (appended && GetEnv().getSortResult()) {
+      // Merge the sorted delta into the sorted result of the base run.
+      const FilePath sorted_filepath = ofilepath + ".sorted";
+      appended =
+          ParallelMergeSortedComSubseqFiles({ofilepath, delta_filepath},
+                                            sorted_filepath) &&
+          std::rename(sorted_filepath.c_str(), ofilepath.c_str()) == 0 &&
+          GetFileChecksum(ofilepath, index.result_size, index.result_checksum);
+    } else if (appended) {
+      appended = AppendComSubseqFile(delta_filepath, ofilepath) &&
+                 UpdateFileChecksum(delta_filepath, UINT64_MAX,
+                                    index.result_size, index.result_checksum);
+    }
+
+    if (!appended) {
+      LOG_ERROR() << "Append the delta error - " << ofilepath << std::endl;
+      return false;
+    }
+    std::remove(delta_filepath.c_str());
+  } else {
+    run.result_filepath = &ofilepath;
+    RunFindMaxComSubseqsGraph(run);
+    if (run.result_failed) return false;
+
+    index.result_size = run.result_size;
+    index.result_checksum = run.result_checksum;
+  }
+
+  // The sorted result is the base of the next incremental run.
+  if (GetEnv().getIndexResult() &&
+      (!BuildLookupIndex(ofilepath) ||
+       !GetFileChecksum(ofilepath, index.result_size,
+                        index.result_checksum)))
+    return false;
+
+  // Record the run for the next incremental run.
+  index.settings = GetRunSettings();
+  index.x_size = run.xs.size();
+  index.x_checksum = GetSeqListChecksum(run.xs, run.xs.size());
+  index.y_size = run.ys.size();
+  index.y_checksum = GetSeqListChecksum(run.ys, run.ys.size());
+  return index.save(index_filepath);
+}
+
+bool FindMaxComSubseqs(RunContext& context, const FilePath& xfilepath,
+                       const FilePath& yfilepath, const FilePath& ofilepath) {
+  ScopedRunContext scope(context);
+  context.createTempFolders();
+
+  return FindMaxComSubseqs(xfilepath, yfilepath, ofilepath);
+}
+
+FilePath GetRunIndexFilePath(const FilePath& ofilepath) {
+  return ofilepath + ".index";
+}
+
+std::string GetShardName(uint32_t index, uint32_t size) {
+  std::ostringstream oss;
+  oss << "shard-" << index << "-of-" << size;
+  return oss.str();
+}
+
+FilePath GetShardFilePath(const FilePath& ofilepath, uint32_t index,
+                          uint32_t size) {
+  return ofilepath + "." + GetShardName(index, size);
+}
+
+bool MergeShardFiles(const FilePath& ofilepath, uint32_t shard_size) {
+  std::vector<FilePath> shard_filepaths;
+  for (uint32_t i = 0; i < shard_size; ++i) {
+    shard_filepaths.push_back(GetShardFilePath(ofilepath, i, shard_size));
+    if (!CheckFileExists(shard_filepaths.back().c_str())) {
+      LOG_ERROR() << "The shard is not finished - " << shard_filepaths.back()
+                  << std::endl;
+      return false;
+    }
+  }
+
+  std::remove(GetLookupIndexFilePath(ofilepath).c_str());
+  if (GetEnv().getSortResult()) {
+    if (!ParallelMergeSortedComSubseqFiles(shard_filepaths, ofilepath))
+      return false;
+  } else if (!CombineComSubSeqFiles(shard_filepaths, ofilepath)) {
+    return false;
+  }
+
+  LOG_INFO() << "Merge " << shard_size << " shards - " << ofilepath
+             << std::endl;
+
+  return !GetEnv().getIndexResult() || BuildLookupIndex(ofilepath);
+}
+
+}  // namespace pcpe
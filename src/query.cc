@@ -0,0 +1,160 @@
+#include "query.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "env.h"
+#include "logging.h"
+#include "max_comsubseq.h"
+#include "memory_budget.h"
+
+namespace pcpe {
+
+bool QueryIndex::load(const FilePath& filepath) {
+  if (!CheckFileExists(filepath.c_str())) {
+    LOG_ERROR() << "The file does not exist - " << filepath << std::endl;
+    return false;
+  }
+
+  SeqList seqs;
+  ReadSequences(filepath, seqs);
+  build(seqs);
+
+  return true;
+}
+
+void QueryIndex::build(const SeqList& seqs) {
+  seqs_ = seqs;
+  small_seqs_.clear();
+  small_seq_size_ = GetSmallSeqSize(seqs_, 0, seqs_.size());
+
+  // The index itself is resident and is not counted after it's built.
+  const uint64_t table_size = EstimateSmallSeqsMemorySize(small_seq_size_);
+  MemoryReservation memory(table_size, table_size);
+
+  ConstructSmallSeqs(seqs_, 0, seqs_.size(), small_seqs_);
+
+  LOG_INFO() << "Build the query index: " << seqs_.size() << " sequences, "
+             << small_seq_size_ << " small seqences." << std::endl;
+}
+
+/**
+ * Sort the ComSubseqs of a query and merge the continuous ComSubseqs the same
+ * as `MaxComSubseqFileWriter`.
+ *
+ * @param[in] com_seqs the fixed-size ComSubseqs. It's sorted in place.
+ * @param[out] seqs the maximum common subseqences which are longer than or
+ *                  equal to `GetEnv().getMinimumOutputLength()`. Only the
+ *                  longest `GetEnv().getPairTopSize()` ones of each pair are
+ *                  kept if the size is not 0.
+ * */
+static void MergeQueryComSubseqs(std::vector<ComSubseq>& com_seqs,
+                                 std::vector<ComSubseq>& seqs) {
+  seqs.clear();
+
+  std::sort(com_seqs.begin(), com_seqs.end(),
+            ComSubseqLess(GetEnv().getComSubseqOrder()));
+
+  const uint32_t min_output_length = GetEnv().getMinimumOutputLength();
+  PairTopComSubseqs top(GetEnv().getPairTopSize());
+  std::size_t run = 0;
+  for (std::size_t i = 0; i < com_seqs.size(); ++i) {
+    if (i != 0 && com_seqs[i - 1].isContinued(com_seqs[i])) {
+      com_seqs[run].setLength(com_seqs[run].getLength() + 1);
+      continue;
+    }
+
+    if (i != 0 && com_seqs[run].getLength() >= min_output_length)
+      top.add(com_seqs[run], seqs);
+    run = i;
+  }
+
+  if (!com_seqs.empty() && com_seqs[run].getLength() >= min_output_length)
+    top.add(com_seqs[run], seqs);
+  top.flush(seqs);
+}
+
+void QueryIndex::query(const Seq& query, uint32_t query_index,
+                       std::vector<ComSubseq>& seqs) const {
+  std::vector<QueryResult> results;
+  this->query(std::vector<QuerySeq>(1, QuerySeq(&query, query_index)),
+              results);
+  seqs.swap(results[0].seqs);
+}
+
+void QueryIndex::query(const SeqList& queries,
+                       std::vector<QueryResult>& results) const {
+  results.clear();
+  results.resize(queries.size());
+
+  std::vector<QueryResult> batch_results;
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    query(std::vector<QuerySeq>(1, QuerySeq(&queries[i],
+                                            static_cast<uint32_t>(i))),
+          batch_results);
+    results[i] = std::move(batch_results[0]);
+  }
+}
+
+/// A small seqence of a query.
+struct QuerySmallSeq {
+  SmallSeqHashIndex key;
+  uint32_t query;  // the position of the query in the batch
+  uint32_t loc;
+};
+
+void QueryIndex::query(const std::vector<QuerySeq>& queries,
+                       std::vector<QueryResult>& results) const {
+  auto start = std::chrono::steady_clock::now();
+
+  results.clear();
+  results.resize(queries.size());
+
+  // Collect and sort the small seqences of the batch.
+  const uint32_t small_seq_length = GetEnv().getSmallSeqLength();
+  std::vector<QuerySmallSeq> small_seqs;
+  for (std::size_t q = 0; q < queries.size(); ++q) {
+    const Seq& seq = *queries[q].seq;
+    if (seq.size() < small_seq_length) continue;
+
+    const std::size_t end_index = seq.size() - small_seq_length;
+    for (std::size_t i = 0; i <= end_index; ++i)
+      small_seqs.push_back({HashSmallSeq(seq.c_str() + i),
+                            static_cast<uint32_t>(q),
+                            static_cast<uint32_t>(i)});
+  }
+
+  std::sort(small_seqs.begin(), small_seqs.end(),
+            [](const QuerySmallSeq& x, const QuerySmallSeq& y) {
+              return x.key < y.key;
+            });
+
+  // Scan the index once in the order of the small seqences.
+  std::vector<std::vector<ComSubseq>> com_seqs(queries.size());
+  auto iter = small_seqs_.begin();
+  for (std::size_t i = 0; i < small_seqs.size(); ++i) {
+    if (i == 0 || small_seqs[i].key != small_seqs[i - 1].key)
+      iter = small_seqs_.lower_bound(small_seqs[i].key);
+    if (iter == small_seqs_.end() || iter->first != small_seqs[i].key)
+      continue;
+
+    const QuerySmallSeq& small_seq = small_seqs[i];
+    for (const auto& loc : iter->second)
+      com_seqs[small_seq.query].emplace_back(queries[small_seq.query].index,
+                                             loc.idx, small_seq.loc, loc.loc,
+                                             small_seq_length);
+  }
+
+  for (std::size_t q = 0; q < queries.size(); ++q) {
+    MergeQueryComSubseqs(com_seqs[q], results[q].seqs);
+    std::vector<ComSubseq>().swap(com_seqs[q]);
+
+    auto end = std::chrono::steady_clock::now();
+    results[q].latency = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+            .count());
+  }
+}
+
+}  // namespace pcpe
@@ -0,0 +1,392 @@
+#include "query_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "com_subseq.h"
+#include "logging.h"
+
+namespace pcpe {
+
+/// Read `size` bytes from the socket. Return false if the connection is
+/// closed or error happened.
+static bool ReadSocket(int fd, void* data, std::size_t size) {
+  char* buffer = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t read_size = recv(fd, buffer, size, 0);
+    if (read_size < 0 && errno == EINTR) continue;
+    if (read_size <= 0) return false;
+
+    buffer += read_size;
+    size -= static_cast<std::size_t>(read_size);
+  }
+
+  return true;
+}
+
+/// Write `size` bytes to the socket. Return false if error happened.
+static bool WriteSocket(int fd, const void* data, std::size_t size) {
+  const char* buffer = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t write_size = send(fd, buffer, size, MSG_NOSIGNAL);
+    if (write_size < 0 && errno == EINTR) continue;
+    if (write_size <= 0) return false;
+
+    buffer += write_size;
+    size -= static_cast<std::size_t>(write_size);
+  }
+
+  return true;
+}
+
+static bool ReadUint32(int fd, uint32_t& value) {
+  return ReadSocket(fd, &value, sizeof(value));
+}
+
+/// Append the bytes of a value to a message.
+template <typename T>
+static void AppendValue(std::vector<char>& message, const T& value) {
+  const char* data = reinterpret_cast<const char*>(&value);
+  message.insert(message.end(), data, data + sizeof(T));
+}
+
+/**
+ * Fill the address of a Unix domain socket.
+ *
+ * @return false: the path is too long
+ * */
+static bool GetSocketAddress(const FilePath& socket_path,
+                             struct sockaddr_un& address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    LOG_ERROR() << "The socket path is too long - " << socket_path
+                << std::endl;
+    return false;
+  }
+
+  std::strncpy(address.sun_path, socket_path.c_str(),
+               sizeof(address.sun_path) - 1);
+  return true;
+}
+
+/// Read the queries of a request after the magic number.
+static bool ReadQueries(int fd, SeqList& queries) {
+  uint32_t query_size = 0;
+  if (!ReadUint32(fd, query_size) || query_size > kMaxRequestQuerySize)
+    return false;
+
+  queries.resize(query_size);
+  for (auto& query : queries) {
+    uint32_t length = 0;
+    if (!ReadUint32(fd, length) || length > kMaxQueryLength) return false;
+
+    query.resize(length);
+    if (length != 0 && !ReadSocket(fd, &query[0], length)) return false;
+  }
+
+  return true;
+}
+
+/// Write the response of a request.
+static bool WriteResponse(int fd, QueryStatus status,
+                          const std::vector<QueryResult>& results) {
+  std::vector<char> message;
+  AppendValue(message, static_cast<uint32_t>(status));
+  AppendValue(message, static_cast<uint32_t>(results.size()));
+  for (const auto& result : results) {
+    AppendValue(message, result.latency);
+    AppendValue(message, static_cast<uint32_t>(result.seqs.size()));
+    const char* data = reinterpret_cast<const char*>(result.seqs.data());
+    message.insert(message.end(), data,
+                   data + result.seqs.size() * sizeof(ComSubseq));
+  }
+
+  return WriteSocket(fd, message.data(), message.size());
+}
+
+QueryServer::QueryServer(const FilePath& socket_path)
+    : socket_path_(socket_path),
+      indexes_(),
+      listen_fd_(-1),
+      stopped_(true),
+      batch_stopped_(true),
+      accept_thread_(),
+      batch_thread_(),
+      mutex_(),
+      request_cv_(),
+      done_cv_(),
+      requests_(),
+      connections_(),
+      batch_size_(0),
+      batch_window_(0),
+      batch_max_requests_(0),
+      max_batch_request_size_(0) {}
+
+void QueryServer::addIndex(std::unique_ptr<QueryIndex> index) {
+  indexes_.push_back(std::move(index));
+}
+
+void QueryServer::setBatchWindow(uint64_t window, std::size_t max_requests) {
+  batch_window_ = window;
+  batch_max_requests_ = max_requests;
+}
+
+bool QueryServer::start() {
+  struct sockaddr_un address;
+  if (!GetSocketAddress(socket_path_, address)) return false;
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    LOG_ERROR() << "Create socket error - " << std::strerror(errno)
+                << std::endl;
+    return false;
+  }
+
+  std::remove(socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    LOG_ERROR() << "Listen on the socket error - " << socket_path_ << ": "
+                << std::strerror(errno) << std::endl;
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  stopped_ = false;
+  batch_stopped_ = false;
+  accept_thread_ = std::thread(&QueryServer::acceptConnections, this);
+  batch_thread_ = std::thread(&QueryServer::runBatches, this);
+
+  LOG_INFO() << "Serve " << indexes_.size() << " indexes on " << socket_path_
+             << std::endl;
+  return true;
+}
+
+void QueryServer::stop() {
+  if (listen_fd_ < 0) return;
+
+  // Wake up the accept thread and the connection threads.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+    shutdown(listen_fd_, SHUT_RDWR);
+    for (auto& connection : connections_)
+      if (connection.fd >= 0) shutdown(connection.fd, SHUT_RDWR);
+  }
+  accept_thread_.join();
+
+  // The requests which are read are still queried.
+  for (auto& connection : connections_) connection.thread.join();
+  connections_.clear();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_stopped_ = true;
+  }
+  request_cv_.notify_all();
+  batch_thread_.join();
+
+  close(listen_fd_);
+  listen_fd_ = -1;
+  std::remove(socket_path_.c_str());
+}
+
+uint64_t QueryServer::getBatchSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batch_size_;
+}
+
+std::size_t QueryServer::getMaxBatchRequestSize() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_batch_request_size_;
+}
+
+void QueryServer::acceptConnections() {
+  while (true) {
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+      if (fd >= 0) close(fd);
+      return;
+    }
+
+    if (fd < 0) {
+      if (errno != EINTR && errno != ECONNABORTED)
+        LOG_WARNING() << "Accept error - " << std::strerror(errno)
+                      << std::endl;
+      continue;
+    }
+
+    // Join the threads of the closed connections.
+    for (auto iter = connections_.begin(); iter != connections_.end();) {
+      if (!iter->finished) {
+        ++iter;
+        continue;
+      }
+
+      iter->thread.join();
+      iter = connections_.erase(iter);
+    }
+
+    connections_.emplace_back();
+    Connection& connection = connections_.back();
+    connection.fd = fd;
+    connection.thread =
+        std::thread(&QueryServer::serveConnection, this, &connection);
+  }
+}
+
+void QueryServer::serveConnection(Connection* connection) {
+  const int fd = connection->fd;
+
+  uint32_t magic = 0;
+  while (ReadUint32(fd, magic) && magic == kQueryRequestMagic) {
+    Request request;
+    if (!ReadUint32(fd, request.index_id) || !ReadQueries(fd, request.queries))
+      break;
+
+    QueryStatus status = QueryStatus::kOk;
+    if (request.index_id < indexes_.size())
+      query(request);
+    else
+      status = QueryStatus::kInvalidIndex;
+
+    if (!WriteResponse(fd, status, request.results)) break;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  close(fd);
+  connection->fd = -1;
+  connection->finished = true;
+}
+
+void QueryServer::query(Request& request) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  requests_.push_back(&request);
+  request_cv_.notify_one();
+
+  done_cv_.wait(lock, [&request]() { return request.done; });
+}
+
+void QueryServer::runBatches() {
+  while (true) {
+    std::deque<Request*> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      request_cv_.wait(
+          lock, [this]() { return !requests_.empty() || batch_stopped_; });
+      if (requests_.empty()) return;
+
+      // Wait for more requests to share the batch.
+      if (batch_window_ != 0)
+        request_cv_.wait_for(
+            lock, std::chrono::microseconds(batch_window_), [this]() {
+              return requests_.size() >= batch_max_requests_ ||
+                     batch_stopped_;
+            });
+
+      batch.swap(requests_);
+      batch_size_++;
+      max_batch_request_size_ = std::max(max_batch_request_size_, batch.size());
+    }
+
+    // Query the requests of each index together. The x of a result is the
+    // index of the query in its request.
+    for (std::size_t id = 0; id < indexes_.size(); ++id) {
+      std::vector<QuerySeq> queries;
+      for (const Request* request : batch) {
+        if (request->index_id != id) continue;
+
+        for (std::size_t i = 0; i < request->queries.size(); ++i)
+          queries.emplace_back(&request->queries[i], static_cast<uint32_t>(i));
+      }
+      if (queries.empty()) continue;
+
+      std::vector<QueryResult> results;
+      indexes_[id]->query(queries, results);
+
+      std::size_t result_index = 0;
+      for (Request* request : batch) {
+        if (request->index_id != id) continue;
+
+        request->results.resize(request->queries.size());
+        for (auto& result : request->results)
+          result = std::move(results[result_index++]);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (Request* request : batch) request->done = true;
+    }
+    done_cv_.notify_all();
+  }
+}
+
+bool SendQueries(const FilePath& socket_path, uint32_t index_id,
+                 const SeqList& queries, std::vector<QueryResult>& results) {
+  results.clear();
+
+  struct sockaddr_un address;
+  if (!GetSocketAddress(socket_path, address)) return false;
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+                        sizeof(address)) != 0) {
+    LOG_ERROR() << "Connect to the server error - " << socket_path << ": "
+                << std::strerror(errno) << std::endl;
+    if (fd >= 0) close(fd);
+    return false;
+  }
+
+  std::vector<char> message;
+  AppendValue(message, kQueryRequestMagic);
+  AppendValue(message, index_id);
+  AppendValue(message, static_cast<uint32_t>(queries.size()));
+  for (const auto& query : queries) {
+    AppendValue(message, static_cast<uint32_t>(query.size()));
+    message.insert(message.end(), query.begin(), query.end());
+  }
+
+  uint32_t status = 0;
+  uint32_t result_size = 0;
+  bool valid = WriteSocket(fd, message.data(), message.size()) &&
+               ReadUint32(fd, status) && ReadUint32(fd, result_size) &&
+               status == static_cast<uint32_t>(QueryStatus::kOk) &&
+               result_size == queries.size();
+
+  results.resize(valid ? result_size : 0);
+  for (std::size_t i = 0; valid && i < results.size(); ++i) {
+    uint32_t seq_size = 0;
+    valid = ReadSocket(fd, &results[i].latency, sizeof(uint64_t)) &&
+            ReadUint32(fd, seq_size);
+    if (!valid) break;
+
+    results[i].seqs.resize(seq_size);
+    valid = ReadSocket(fd, results[i].seqs.data(),
+                       seq_size * sizeof(ComSubseq));
+  }
+  close(fd);
+
+  if (!valid) {
+    LOG_ERROR() << "Invalid response from the server - " << socket_path
+                << " (status: " << status << ")" << std::endl;
+    results.clear();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace pcpe
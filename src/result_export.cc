@@ -0,0 +1,273 @@
+#include "result_export.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "logging.h"
+#include "memory_budget.h"
+#include "run_context.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+/// The maximum size of a line of a ComSubseq without ids: 5 numbers of 10
+/// digits and the separators.
+constexpr std::size_t kMaxTsvLineSize = 5 * 11;
+
+bool ReadSequenceIds(const FilePath& filepath, std::vector<std::string>& ids) {
+  std::ifstream infile(filepath.c_str());
+  if (!infile) {
+    LOG_ERROR() << "Open file error - " << filepath << std::endl;
+    return false;
+  }
+
+  std::size_t seq_size = 0;
+  std::string line;
+  if (!(infile >> seq_size) || !std::getline(infile, line)) {
+    LOG_ERROR() << "Invalid id file - " << filepath << std::endl;
+    return false;
+  }
+
+  ids.assign(seq_size, std::string());
+  for (auto& id : ids) {
+    std::size_t id_size = 0;
+    if (!std::getline(infile, line)) break;
+
+    std::istringstream iss(line);
+    iss >> id_size;
+    std::string item;
+    for (std::size_t i = 0; i < id_size && iss >> item; ++i) {
+      if (i != 0) id += ',';
+      id += item;
+    }
+  }
+
+  if (!infile) {
+    LOG_ERROR() << "The id file has less than " << seq_size
+                << " sequences - " << filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+/// Append the decimal digits of the number to the buffer.
+static char* FormatUint32(uint32_t value, char* out) {
+  char digits[10];
+  std::size_t size = 0;
+  do {
+    digits[size++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  while (size != 0) *out++ = digits[--size];
+  return out;
+}
+
+/// Append the id of the sequence or its index if there are no ids.
+static bool FormatSequence(uint32_t index, const std::vector<std::string>& ids,
+                           std::string& out) {
+  if (ids.empty()) {
+    char buffer[10];
+    out.append(buffer, FormatUint32(index, buffer));
+    return true;
+  }
+
+  if (index >= ids.size()) return false;
+
+  out += ids[index];
+  return true;
+}
+
+/**
+ * Format the ComSubseqs to TSV lines.
+ *
+ * @return false: an index is out of the range of the ids
+ * */
+static bool FormatComSubseqs(const ComSubseq* seqs, std::size_t size,
+                             const std::vector<std::string>& x_ids,
+                             const std::vector<std::string>& y_ids,
+                             std::string& out) {
+  out.clear();
+  if (x_ids.empty() && y_ids.empty()) {
+    // Write the digits directly to the preallocated buffer.
+    out.resize(size * kMaxTsvLineSize);
+    char* begin = &out[0];
+    char* curr = begin;
+    for (std::size_t i = 0; i < size; ++i) {
+      curr = FormatUint32(seqs[i].getX(), curr);
+      *curr++ = '\t';
+      curr = FormatUint32(seqs[i].getY(), curr);
+      *curr++ = '\t';
+      curr = FormatUint32(seqs[i].getXLoc(), curr);
+      *curr++ = '\t';
+      curr = FormatUint32(seqs[i].getYLoc(), curr);
+      *curr++ = '\t';
+      curr = FormatUint32(seqs[i].getLength(), curr);
+      *curr++ = '\n';
+    }
+    out.resize(static_cast<std::size_t>(curr - begin));
+    return true;
+  }
+
+  out.reserve(size * kMaxTsvLineSize);
+  char buffer[kMaxTsvLineSize];
+  for (std::size_t i = 0; i < size; ++i) {
+    if (!FormatSequence(seqs[i].getX(), x_ids, out)) return false;
+    out += '\t';
+    if (!FormatSequence(seqs[i].getY(), y_ids, out)) return false;
+
+    char* curr = buffer;
+    *curr++ = '\t';
+    curr = FormatUint32(seqs[i].getXLoc(), curr);
+    *curr++ = '\t';
+    curr = FormatUint32(seqs[i].getYLoc(), curr);
+    *curr++ = '\t';
+    curr = FormatUint32(seqs[i].getLength(), curr);
+    *curr++ = '\n';
+    out.append(buffer, curr);
+  }
+
+  return true;
+}
+
+/// Write all data to the file descriptor.
+static bool WriteFully(int fd, const char* data, std::size_t size) {
+  while (size > 0) {
+    const ssize_t write_size = write(fd, data, size);
+    if (write_size < 0 && errno == EINTR) continue;
+    if (write_size <= 0) return false;
+
+    data += write_size;
+    size -= static_cast<std::size_t>(write_size);
+  }
+
+  return true;
+}
+
+bool ExportComSubseqFile(const FilePath& ifilepath,
+                         const std::vector<std::string>& x_ids,
+                         const std::vector<std::string>& y_ids, int fd) {
+  static const char kHeader[] = "x\ty\tx_loc\ty_loc\tlength\n";
+  if (!WriteFully(fd, kHeader, sizeof(kHeader) - 1)) {
+    LOG_ERROR() << "Write the output error - " << std::strerror(errno)
+                << std::endl;
+    return false;
+  }
+
+  const int ifd = open(ifilepath.c_str(), O_RDONLY);
+  struct stat stat;
+  if (ifd < 0 || fstat(ifd, &stat) != 0) {
+    LOG_ERROR() << "Open file error - " << ifilepath << std::endl;
+    if (ifd >= 0) close(ifd);
+    return false;
+  }
+
+  const std::size_t file_size = static_cast<std::size_t>(stat.st_size);
+  const std::size_t seqs_size = file_size / sizeof(ComSubseq);
+  if (seqs_size == 0) {
+    close(ifd);
+    return true;
+  }
+
+  void* data = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, ifd, 0);
+  close(ifd);
+  if (data == MAP_FAILED) {
+    LOG_ERROR() << "Map file error - " << ifilepath << std::endl;
+    return false;
+  }
+  madvise(data, file_size, MADV_SEQUENTIAL);
+  const ComSubseq* seqs = static_cast<const ComSubseq*>(data);
+
+  // Each round formats one chunk per worker in parallel and writes them in
+  // order. The output buffers of a round take the reserved memory.
+  ThreadPool& pool = GetRunContext().getThreadPool();
+  const std::size_t chunks_size = std::max<std::size_t>(pool.size(), 1);
+  MemoryReservation memory(kMinIOBufferSize,
+                           static_cast<uint64_t>(GetEnv().getIOBufferSize()) *
+                               chunks_size);
+  const std::size_t chunk_seqs_size = std::max<std::size_t>(
+      static_cast<std::size_t>(memory.size()) / chunks_size / kMaxTsvLineSize,
+      1);
+
+  std::vector<std::string> buffers(chunks_size);
+  std::atomic<bool> valid(true);
+  bool written = true;
+  for (std::size_t begin = 0; begin < seqs_size && valid.load() && written;
+       begin += chunk_seqs_size * chunks_size) {
+    WaitGroup wg;
+    for (std::size_t c = 0; c < chunks_size; ++c) {
+      const std::size_t chunk_begin = begin + c * chunk_seqs_size;
+      if (chunk_begin >= seqs_size) {
+        buffers[c].clear();
+        continue;
+      }
+
+      const std::size_t chunk_size =
+          std::min(chunk_seqs_size, seqs_size - chunk_begin);
+      std::string* buffer = &buffers[c];
+      pool.submit(
+          [seqs, chunk_begin, chunk_size, &x_ids, &y_ids, buffer, &valid]() {
+            if (!FormatComSubseqs(seqs + chunk_begin, chunk_size, x_ids, y_ids,
+                                  *buffer))
+              valid = false;
+          },
+          wg);
+    }
+    wg.wait();
+
+    for (std::size_t c = 0; c < chunks_size && valid.load() && written; ++c)
+      written = WriteFully(fd, buffers[c].data(), buffers[c].size());
+  }
+
+  munmap(data, file_size);
+
+  if (!valid.load()) {
+    LOG_ERROR() << "A sequence index is out of the range of the ids - "
+                << ifilepath << std::endl;
+    return false;
+  }
+
+  if (!written) {
+    LOG_ERROR() << "Write the output error - " << std::strerror(errno)
+                << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool ExportComSubseqFile(const FilePath& ifilepath,
+                         const std::vector<std::string>& x_ids,
+                         const std::vector<std::string>& y_ids,
+                         const FilePath& ofilepath) {
+  if (ofilepath == "-")
+    return ExportComSubseqFile(ifilepath, x_ids, y_ids, STDOUT_FILENO);
+
+  const int fd = open(ofilepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    LOG_ERROR() << "Open file error - " << ofilepath << std::endl;
+    return false;
+  }
+
+  bool exported = ExportComSubseqFile(ifilepath, x_ids, y_ids, fd);
+  if (close(fd) != 0) {
+    LOG_ERROR() << "Close file error - " << ofilepath << std::endl;
+    exported = false;
+  }
+
+  return exported;
+}
+
+}  // namespace pcpe
@@ -0,0 +1,204 @@
+#include "result_lookup.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "com_subseq_sort.h"
+#include "logging.h"
+
+namespace pcpe {
+
+FilePath GetLookupIndexFilePath(const FilePath& filepath) {
+  return filepath + ".lookup";
+}
+
+/**
+ * Write the sorted ComSubseqs and collect the offset of each x. The interface
+ * is the same as `ComSubseqFileWriter`.
+ * */
+class LookupIndexWriter {
+ public:
+  explicit LookupIndexWriter(const FilePath& filepath)
+      : writer_(filepath), offsets_(), size_(0) {}
+
+  bool writeSeq(const ComSubseq& seq) {
+    while (offsets_.size() <= seq.getX()) offsets_.push_back(size_);
+    size_++;
+    return writer_.writeSeq(seq);
+  }
+
+  /// Close the result file and write the index.
+  bool close(const FilePath& index_filepath) {
+    const bool written = writer_.close();
+    offsets_.push_back(size_);
+
+    std::ofstream outfile(index_filepath.c_str(),
+                          std::ofstream::out | std::ofstream::binary |
+                              std::ofstream::trunc);
+    outfile.write(reinterpret_cast<const char*>(&size_), sizeof(size_));
+    outfile.write(reinterpret_cast<const char*>(offsets_.data()),
+                  static_cast<std::streamsize>(offsets_.size() *
+                                               sizeof(uint64_t)));
+    outfile.close();
+
+    return written && static_cast<bool>(outfile);
+  }
+
+ private:
+  ComSubseqFileWriter writer_;
+  std::vector<uint64_t> offsets_;
+  uint64_t size_;
+};
+
+bool BuildLookupIndex(const FilePath& filepath) {
+  const FilePath sorted_filepath = filepath + ".sorted";
+  const FilePath index_filepath = GetLookupIndexFilePath(filepath);
+
+  if (!CheckFileExists(filepath.c_str())) {
+    LOG_ERROR() << "The file does not exist - " << filepath << std::endl;
+    return false;
+  }
+
+  // Both orders of ComSubseqs sort the pairs (x, y) first.
+  ComSubseqSortBuffer buffer(filepath + ".sort");
+  {
+    ComSubseqFileReader reader(filepath);
+    ComSubseq seq;
+    while (!reader.eof() && reader.readSeq(seq)) buffer.writeSeq(seq);
+    reader.close();
+  }
+
+  LookupIndexWriter writer(sorted_filepath);
+  buffer.sortTo(writer);
+  if (!writer.close(index_filepath) ||
+      std::rename(sorted_filepath.c_str(), filepath.c_str()) != 0) {
+    LOG_ERROR() << "Build the lookup index error - " << filepath << std::endl;
+    std::remove(sorted_filepath.c_str());
+    std::remove(index_filepath.c_str());
+    return false;
+  }
+
+  LOG_INFO() << "Build the lookup index - " << index_filepath << " ("
+             << buffer.getSpillSize() << " spilled runs)" << std::endl;
+  return true;
+}
+
+/// Read the uint64_t at the index of the file.
+static bool ReadUint64At(std::ifstream& ifile, uint64_t idx, uint64_t& value) {
+  ifile.seekg(static_cast<std::streamoff>(idx * sizeof(uint64_t)));
+  ifile.read(reinterpret_cast<char*>(&value), sizeof(uint64_t));
+
+  return ifile.gcount() == static_cast<std::streamsize>(sizeof(uint64_t));
+}
+
+/**
+ * Get the range of the ComSubseqs of x in the result file.
+ *
+ * @param[out] begin the index of the first ComSubseq of x
+ * @param[out] end the index after the last ComSubseq of x
+ *
+ * @return false: the index does not exist or it's out of date.
+ * */
+static bool GetLookupRange(const FilePath& filepath, uint32_t x,
+                           uint64_t& begin, uint64_t& end) {
+  const FilePath index_filepath = GetLookupIndexFilePath(filepath);
+  std::ifstream ifile(index_filepath.c_str(),
+                      std::ifstream::in | std::ifstream::binary);
+
+  FileSize file_size = 0;
+  FileSize index_size = 0;
+  uint64_t size = 0;
+  if (!ifile || !ReadUint64At(ifile, 0, size) ||
+      !GetFileSize(filepath.c_str(), file_size) ||
+      !GetFileSize(index_filepath.c_str(), index_size) ||
+      static_cast<uint64_t>(file_size) != size * sizeof(ComSubseq)) {
+    LOG_ERROR() << "The lookup index does not exist or is out of date - "
+                << index_filepath << std::endl;
+    return false;
+  }
+
+  // The offsets of x = 0 ... n - 1 and the end.
+  const uint64_t offsets_size =
+      static_cast<uint64_t>(index_size) / sizeof(uint64_t) - 1;
+  if (static_cast<uint64_t>(x) + 1 >= offsets_size) {
+    begin = end = size;
+    return true;
+  }
+
+  return ReadUint64At(ifile, 1 + static_cast<uint64_t>(x), begin) &&
+         ReadUint64At(ifile, 2 + static_cast<uint64_t>(x), end);
+}
+
+/// Read the ComSubseqs [begin, end) of the file.
+static bool ReadComSubseqRange(std::ifstream& ifile, uint64_t begin,
+                               uint64_t end, std::vector<ComSubseq>& seqs) {
+  seqs.resize(static_cast<std::size_t>(end - begin));
+  if (seqs.empty()) return true;
+
+  const std::streamsize read_size =
+      static_cast<std::streamsize>(seqs.size() * sizeof(ComSubseq));
+  ifile.seekg(static_cast<std::streamoff>(begin * sizeof(ComSubseq)));
+  ifile.read(reinterpret_cast<char*>(seqs.data()), read_size);
+
+  return ifile.gcount() == read_size;
+}
+
+bool LookupComSubseqs(const FilePath& filepath, uint32_t x,
+                      std::vector<ComSubseq>& seqs) {
+  seqs.clear();
+
+  uint64_t begin = 0;
+  uint64_t end = 0;
+  if (!GetLookupRange(filepath, x, begin, end)) return false;
+
+  std::ifstream ifile(filepath.c_str(),
+                      std::ifstream::in | std::ifstream::binary);
+  if (!ReadComSubseqRange(ifile, begin, end, seqs)) {
+    LOG_ERROR() << "Read file error - " << filepath << std::endl;
+    seqs.clear();
+    return false;
+  }
+
+  return true;
+}
+
+/// Find the first ComSubseq in [low, high) whose y is not less than y.
+static uint64_t LowerBoundY(std::ifstream& ifile, uint64_t low, uint64_t high,
+                            uint32_t y) {
+  while (low < high) {
+    const uint64_t mid = low + (high - low) / 2;
+    ComSubseq seq;
+    if (!ReadComSubseqAt(ifile, mid, seq)) return high;
+
+    if (seq.getY() < y)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+bool LookupComSubseqs(const FilePath& filepath, uint32_t x, uint32_t y,
+                      std::vector<ComSubseq>& seqs) {
+  seqs.clear();
+
+  uint64_t begin = 0;
+  uint64_t end = 0;
+  if (!GetLookupRange(filepath, x, begin, end)) return false;
+
+  std::ifstream ifile(filepath.c_str(),
+                      std::ifstream::in | std::ifstream::binary);
+  const uint64_t pair_begin = LowerBoundY(ifile, begin, end, y);
+  const uint64_t pair_end =
+      (y == UINT32_MAX) ? end : LowerBoundY(ifile, pair_begin, end, y + 1);
+  if (!ReadComSubseqRange(ifile, pair_begin, pair_end, seqs)) {
+    LOG_ERROR() << "Read file error - " << filepath << std::endl;
+    seqs.clear();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace pcpe
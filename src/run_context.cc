@@ -0,0 +1,64 @@
+#include "run_context.h"
+
+#include <vector>
+
+#include "pcpe_util.h"
+#include "temp_folder.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+static thread_local RunContext* tCurrentContext = nullptr;
+
+RunContext::RunContext(const std::string& name, const Env& env,
+                       ThreadPool* pool)
+    : name_(name),
+      own_env_(new Env(env)),
+      env_(own_env_.get()),
+      pool_(pool),
+      stats_(),
+      temp_index_(0) {
+  if (name_.empty()) return;
+
+  std::vector<TempFolder> folders = env_->getTempFolders();
+  for (auto& folder : folders) folder.path += "/" + name_;
+  env_->setTempFolders(folders);
+}
+
+RunContext::RunContext()
+    : name_(),
+      own_env_(),
+      env_(&gEnv),
+      pool_(nullptr),
+      stats_(),
+      temp_index_(0) {}
+
+ThreadPool& RunContext::getThreadPool() const {
+  return pool_ != nullptr ? *pool_ : GetThreadPool();
+}
+
+void RunContext::createTempFolders() const {
+  for (const auto& folder : env_->getTempFolders())
+    if (!CheckFolderExists(folder.path.c_str()))
+      CreateFolder(folder.path.c_str());
+}
+
+RunContext& GetRunContext() {
+  if (tCurrentContext != nullptr) return *tCurrentContext;
+
+  static RunContext default_context;
+  return default_context;
+}
+
+RunContext* GetCurrentRunContext() { return tCurrentContext; }
+
+const Env& GetEnv() { return GetRunContext().getEnv(); }
+
+ScopedRunContext::ScopedRunContext(RunContext* context)
+    : previous_(tCurrentContext) {
+  tCurrentContext = context;
+}
+
+ScopedRunContext::~ScopedRunContext() { tCurrentContext = previous_; }
+
+}  // namespace pcpe
@@ -0,0 +1,105 @@
+#include "run_index.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "env.h"
+#include "logging.h"
+#include "manifest.h"
+
+namespace pcpe {
+
+static const char* kRunIndexMagic = "pcpe-index 1";
+
+uint64_t GetSeqListChecksum(const SeqList& seqs, std::size_t size) {
+  uint64_t checksum = kEmptyChecksum;
+  for (std::size_t i = 0; i < size && i < seqs.size(); ++i) {
+    UpdateChecksum(seqs[i].c_str(), seqs[i].size(), checksum);
+    UpdateChecksum("\n", 1, checksum);
+  }
+
+  return checksum;
+}
+
+std::string GetRunSettings() {
+  std::ostringstream oss;
+  const Env& env = GetEnv();
+  oss << env.getSmallSeqLength() << " " << env.getMinimumOutputLength() << " "
+      << static_cast<int>(env.getComSubseqOrder()) << " "
+      << env.getPairTopSize() << " " << (env.getSortResult() ? 1 : 0);
+  return oss.str();
+}
+
+bool RunIndex::load(const FilePath& filepath) {
+  std::ifstream infile(filepath.c_str());
+  if (!infile) return false;
+
+  std::string magic;
+  std::string x_name;
+  std::string y_name;
+  std::string result_name;
+  if (!std::getline(infile, magic) || magic != kRunIndexMagic ||
+      !std::getline(infile, settings) ||
+      !(infile >> x_name >> x_size >> x_checksum) || x_name != "x" ||
+      !(infile >> y_name >> y_size >> y_checksum) || y_name != "y" ||
+      !(infile >> result_name >> result_size >> result_checksum) ||
+      result_name != "result") {
+    LOG_WARNING() << "Invalid run index - " << filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool RunIndex::save(const FilePath& filepath) const {
+  const FilePath tmp_filepath = filepath + ".tmp";
+
+  std::ofstream outfile(tmp_filepath.c_str(),
+                        std::ofstream::out | std::ofstream::trunc);
+  if (!outfile) {
+    LOG_ERROR() << "Open file error - " << tmp_filepath << std::endl;
+    return false;
+  }
+
+  outfile << kRunIndexMagic << '\n'
+          << settings << '\n'
+          << "x " << x_size << ' ' << x_checksum << '\n'
+          << "y " << y_size << ' ' << y_checksum << '\n'
+          << "result " << result_size << ' ' << result_checksum << '\n';
+  outfile.close();
+
+  if (!outfile || std::rename(tmp_filepath.c_str(), filepath.c_str()) != 0) {
+    LOG_ERROR() << "Write run index error - " << filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool RunIndex::isBaseOf(const SeqList& xs, const SeqList& ys,
+                        const FilePath& result_filepath) const {
+  if (settings != GetRunSettings()) {
+    LOG_WARNING() << "The settings are changed." << std::endl;
+    return false;
+  }
+
+  if (xs.size() < x_size || GetSeqListChecksum(xs, x_size) != x_checksum ||
+      ys.size() < y_size || GetSeqListChecksum(ys, y_size) != y_checksum) {
+    LOG_WARNING() << "The sequences of the last run are changed." << std::endl;
+    return false;
+  }
+
+  uint64_t size = 0;
+  uint64_t checksum = kEmptyChecksum;
+  if (!UpdateFileChecksum(result_filepath, result_size, size, checksum) ||
+      size != result_size || checksum != result_checksum) {
+    LOG_WARNING() << "The result of the last run is changed - "
+                  << result_filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace pcpe
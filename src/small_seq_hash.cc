@@ -1,5 +1,6 @@
 #include "small_seq_hash.h"
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 #include <fstream>
@@ -11,7 +12,9 @@
 #include "com_subseq.h"
 #include "env.h"
 #include "logging.h"
+#include "memory_budget.h"
 #include "pcpe_util.h"
+#include "run_context.h"
 #include "simple_task.h"
 
 namespace pcpe {
@@ -24,9 +27,11 @@ SmallSeqHashFileReader::SmallSeqHashFileReader(const FilePath& filepath)
       infile_(filepath_.c_str(), std::ifstream::in | std::ifstream::binary),
       file_size_(0),
       curr_read_size_(0),
+      memory_(kMinIOBufferSize, GetEnv().getIOBufferSize()),
       max_buffer_size_(
-          (gEnv.getIOBufferSize() > kMinimalReadBufferSize)
-              ? (gEnv.getIOBufferSize() / sizeof(uint32_t) * sizeof(uint32_t))
+          (memory_.size() > kMinimalReadBufferSize)
+              ? (static_cast<std::size_t>(memory_.size()) / sizeof(uint32_t) *
+                 sizeof(uint32_t))
               : kMinimalReadBufferSize),
       buffer_size_(0),
       buffer_(new uint8_t[max_buffer_size_]),
@@ -152,8 +157,11 @@ bool SmallSeqHashFileReader::readEntry(SmallSeqHashIndex& key,
 SmallSeqHashFileWriter::SmallSeqHashFileWriter(const FilePath& filepath)
     : filepath_(filepath),
       outfile_(filepath_.c_str(), std::ofstream::out | std::ofstream::binary),
-      max_buffer_size_(gEnv.getIOBufferSize() / sizeof(uint32_t) *
-                       sizeof(uint32_t)),
+      memory_(kMinIOBufferSize, GetEnv().getIOBufferSize()),
+      max_buffer_size_(std::max<std::size_t>(
+          static_cast<std::size_t>(memory_.size()) / sizeof(uint32_t) *
+              sizeof(uint32_t),
+          sizeof(uint32_t))),
       buffer_size_(0),
       buffer_(new uint8_t[max_buffer_size_]) {}
 
@@ -254,7 +262,27 @@ void ReadSequences(const FilePath& filepath, SeqList& seqs) {
   }
 
   std::ifstream in_file(filepath.c_str(), std::ifstream::in);
+  ReadSequences(in_file, seqs);
+  in_file.close();
+}
+
+bool WriteSequences(const FilePath& filepath, const SeqList& seqs) {
+  std::ofstream out_file(filepath.c_str(),
+                         std::ofstream::out | std::ofstream::trunc);
+
+  out_file << seqs.size() << '\n';
+  for (const auto& seq : seqs) out_file << seq.size() << ' ' << seq << '\n';
+  out_file.close();
+
+  if (!out_file) {
+    LOG_ERROR() << "Write the sequences error - " << filepath << std::endl;
+    return false;
+  }
+
+  return true;
+}
 
+void ReadSequences(std::istream& in_file, SeqList& seqs) {
   std::size_t str_read_size = 0;  // the number of seqences of the file.
   in_file >> str_read_size;
 
@@ -267,9 +295,6 @@ void ReadSequences(const FilePath& filepath, SeqList& seqs) {
   std::size_t str_length = 0;  // useless, just for backward compatibility
   for (std::size_t i = 0; i < str_read_size; i++)
     in_file >> str_length >> seqs[i];
-
-  in_file.close();
-  in_file.clear();
 }
 
 void ConstructSmallSeqs(const SeqList& seqs, std::size_t seqs_begin,
@@ -279,11 +304,11 @@ void ConstructSmallSeqs(const SeqList& seqs, std::size_t seqs_begin,
   for (std::size_t sidx = seqs_begin; sidx < seqs_end; ++sidx) {
     // Ignore when the string is less the default size since the value of
     // tiny string is unused in bio research.
-    if (seqs[sidx].size() < gEnv.getSmallSeqLength()) continue;
+    if (seqs[sidx].size() < GetEnv().getSmallSeqLength()) continue;
 
     // Put all fixed-size subseqence with seqeunce index infor to the hash
     // table
-    std::size_t end_index = seqs[sidx].size() - gEnv.getSmallSeqLength();
+    std::size_t end_index = seqs[sidx].size() - GetEnv().getSmallSeqLength();
     for (std::size_t i = 0; i <= end_index; ++i) {
       SmallSeqHashIndex index = HashSmallSeq(seqs[sidx].c_str() + i);
       if (index != noise_hash_index)
@@ -293,6 +318,40 @@ void ConstructSmallSeqs(const SeqList& seqs, std::size_t seqs_begin,
   }
 }
 
+uint64_t GetSmallSeqSize(const SeqList& ss, std::size_t ss_begin,
+                         std::size_t ss_end) {
+  uint64_t size = 0;
+  for (std::size_t sidx = ss_begin; sidx < ss_end; ++sidx)
+    if (ss[sidx].size() >= GetEnv().getSmallSeqLength())
+      size += ss[sidx].size() - GetEnv().getSmallSeqLength() + 1;
+
+  return size;
+}
+
+uint64_t EstimateSmallSeqsMemorySize(uint64_t entries_size) {
+  // The header and the alignment of an allocation of the allocator.
+  const uint64_t kAllocationOverhead = 16;
+  // A node of the red-black tree has three pointers and the color besides the
+  // key and the list.
+  const uint64_t kNodeSize = sizeof(SmallSeqList::value_type) +
+                             4 * sizeof(void*) + kAllocationOverhead;
+  // The number of different hash indexes (26 ** 6).
+  const uint64_t kMaxKeysSize = 308915776;
+
+  const uint64_t keys_size = std::min(entries_size, kMaxKeysSize);
+  return keys_size * (kNodeSize + kAllocationOverhead) +
+         2 * entries_size * sizeof(SeqLoc);
+}
+
+uint64_t EstimateHashTableFileEntrySize(const FilePath& filepath) {
+  FileSize file_size = 0;
+  if (!GetFileSize(filepath.c_str(), file_size)) return 0;
+
+  // Each key also takes the space of the key and the count. The estimation
+  // ignores them.
+  return static_cast<uint64_t>(file_size) / sizeof(SeqLoc);
+}
+
 class CreateHashTableFileTask {
  public:
   CreateHashTableFileTask(const SeqList& ss, std::size_t ss_begin,
@@ -300,6 +359,9 @@ class CreateHashTableFileTask {
       : ss_(ss), ss_begin_(ss_begin), ss_end_(ss_end), output_(output_path) {}
   void exec();
 
+  /// The estimated cost is the number of small seqences.
+  uint64_t cost() const { return GetSmallSeqSize(ss_, ss_begin_, ss_end_); }
+
   const FilePath& getOutput() { return output_; }
 
  private:
@@ -310,23 +372,41 @@ class CreateHashTableFileTask {
   FilePath output_;
 };
 
-void CreateHashTableFileTask::exec() {
+bool CreateHashTableFile(const SeqList& ss, std::size_t ss_begin,
+                         std::size_t ss_end, const FilePath& output) {
+  // The hash table keeps all small seqences in memory.
+  const uint64_t table_size =
+      EstimateSmallSeqsMemorySize(GetSmallSeqSize(ss, ss_begin, ss_end));
+  MemoryReservation memory(table_size, table_size);
+
   SmallSeqList small_seqs;
-  ConstructSmallSeqs(ss_, ss_begin_, ss_end_, small_seqs);
+  ConstructSmallSeqs(ss, ss_begin, ss_end, small_seqs);
 
-  SmallSeqHashFileWriter writer(output_);
+  SmallSeqHashFileWriter writer(output);
+  bool written = true;
   for (const auto& entry : small_seqs) {
-    writer.writeEntry(entry);
+    if (!writer.writeEntry(entry)) {
+      written = false;
+      break;
+    }
+  }
+  if (!writer.close() || !written) {
+    LOG_ERROR() << "Write hash file error - " << output << std::endl;
+    return false;
   }
-  writer.close();
 
-  LOG_INFO() << "Create hash file: " << output_ << " done." << std::endl;
+  LOG_INFO() << "Create hash file: " << output << " done." << std::endl;
+  return true;
+}
+
+void CreateHashTableFileTask::exec() {
+  CreateHashTableFile(ss_, ss_begin_, ss_end_, output_);
 }
 
 void ConstructHashTableFileTasks(
     const SeqList& ss,
     std::vector<std::unique_ptr<CreateHashTableFileTask>>& tasks) {
-  const std::size_t kSeqSize = gEnv.getCompareSeqenceSize();
+  const std::size_t kSeqSize = GetEnv().getCompareSeqenceSize();
 
   std::vector<std::size_t> steps;
   GetStepsToNumber(ss.size(), kSeqSize, steps);
@@ -335,13 +415,13 @@ void ConstructHashTableFileTasks(
     return;
   }
 
-  static std::size_t curr_index = 0;
-  const FilePath& kTempFolderPrefix = gEnv.getTempFolderPath();
+  RunContext& context = GetRunContext();
+  const FilePath& kTempFolderPrefix = GetEnv().getTempFolderPath();
 
   for (std::size_t i = 0; i < steps.size() - 1; ++i) {
     // Generate result filename
     std::ostringstream oss;
-    oss << kTempFolderPrefix << "/hash_table_" << curr_index++;
+    oss << kTempFolderPrefix << "/hash_table_" << context.getNextTempIndex();
     FilePath output(oss.str());
 
     tasks.emplace_back(
@@ -383,6 +463,12 @@ class CompareHashTableFileTask {
 
   void exec();
 
+  /// The estimated cost is the product of the entry sizes of the two files.
+  uint64_t cost() const {
+    return EstimateHashTableFileEntrySize(x_filepath_) *
+           EstimateHashTableFileEntrySize(y_filepath_);
+  }
+
   FilePath& getOutput() { return output_; }
 
  private:
@@ -397,47 +483,8 @@ void CompareHashTableFileTask::exec() {
       !CheckFileNotEmpty(y_filepath_.c_str()))
     return;
 
-  auto write_comsubseq = [](const SeqLocList& x_value,
-                            const SeqLocList& y_value,
-                            ComSubseqFileWriter& writer) {
-    for (const auto& x : x_value) {
-      for (const auto& y : y_value) {
-        writer.writeSeq(
-            ComSubseq(x.idx, y.idx, x.loc, y.loc, gEnv.getSmallSeqLength()));
-      }
-    }
-  };
-
-  SmallSeqHashFileReader x_reader(x_filepath_);
-  SmallSeqHashFileReader y_reader(y_filepath_);
-
-  std::pair<SmallSeqHashIndex, SeqLocList> x_entry;
-  x_reader.readEntry(x_entry);
-
-  std::pair<SmallSeqHashIndex, SeqLocList> y_entry;
-  y_reader.readEntry(y_entry);
-
   ComSubseqFileWriter writer(output_);
-  while (!x_reader.eof() || !y_reader.eof()) {
-    if (x_entry.first == y_entry.first) {
-      write_comsubseq(x_entry.second, y_entry.second, writer);
-
-      if (!x_reader.eof()) x_reader.readEntry(x_entry);
-      if (!y_reader.eof()) y_reader.readEntry(y_entry);
-    }
-    else if (x_reader.eof())                y_reader.readEntry(y_entry);
-    else if (y_reader.eof())                x_reader.readEntry(x_entry);
-    else if (x_entry.first > y_entry.first) y_reader.readEntry(y_entry);
-    else if (x_entry.first < y_entry.first) x_reader.readEntry(x_entry);
-  }
-
-  // Deal the last entry
-  if (x_entry.first == y_entry.first) {
-    write_comsubseq(x_entry.second, y_entry.second, writer);
-  }
-
-  x_reader.close();
-  y_reader.close();
+  CompareHashTableFiles(x_filepath_, y_filepath_, writer);
   writer.close();
 
   LOG_INFO() << "Compare " << x_filepath_ << " and " << y_filepath_ << " done."
@@ -448,7 +495,7 @@ void ConstructCompareHashTableFileTask(
     const std::vector<FilePath>& x_filepaths,
     const std::vector<FilePath>& y_filepaths,
     std::vector<std::unique_ptr<CompareHashTableFileTask>>& tasks) {
-  const FilePath& kTempFolderPrefix = gEnv.getTempFolderPath();
+  const FilePath& kTempFolderPrefix = GetEnv().getTempFolderPath();
   std::size_t curr_index = 0;
   for (const auto& x : x_filepaths) {
     for (const auto& y : y_filepaths) {
@@ -0,0 +1,209 @@
+#include "task_graph.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "logging.h"
+#include "run_context.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+TaskGraph::NodeId TaskGraph::addTask(Task task, uint64_t cost,
+                                     uint64_t resource) {
+  nodes_.emplace_back(new Node(std::move(task), cost, resource));
+  return nodes_.size() - 1;
+}
+
+void TaskGraph::addDependency(NodeId from, NodeId to) {
+  if (from >= nodes_.size() || to >= nodes_.size() || from == to) {
+    LOG_ERROR() << "Invalid dependency: " << from << " -> " << to << std::endl;
+    return;
+  }
+
+  nodes_[from]->successors.push_back(to);
+  nodes_[to]->dependency_size++;
+}
+
+void TaskGraph::setResourceLimit(uint64_t limit) {
+  std::lock_guard<std::mutex> lock(ready_mutex_);
+  resource_limit_ = limit;
+}
+
+void TaskGraph::releaseResource(uint64_t size) {
+  std::lock_guard<std::mutex> lock(ready_mutex_);
+  resource_size_ -= std::min(size, resource_size_);
+}
+
+uint64_t TaskGraph::getResourcePeak() {
+  std::lock_guard<std::mutex> lock(ready_mutex_);
+  return resource_peak_;
+}
+
+void TaskGraph::submit(ThreadPool& pool, WaitGroup& wg, NodeId id,
+                       std::size_t preferred_node) {
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    ready_[preferred_node].emplace(nodes_[id]->cost, id);
+  }
+
+  dispatch(pool, wg);
+}
+
+void TaskGraph::dispatch(ThreadPool& pool, WaitGroup& wg) {
+  // Each worker task runs one ready node, but not necessarily the node
+  // pushed by the caller. It picks the ready node with the largest cost when
+  // it starts.
+  pool.submit(
+      [this, &pool, &wg]() {
+        // The last ready queue is for the nodes without a preference.
+        const std::size_t numa_node = (ThreadPool::getCurrentPool() == &pool)
+                                          ? ThreadPool::getCurrentNode()
+                                          : pool.getNodeSize();
+
+        NodeId curr = 0;
+        {
+          std::lock_guard<std::mutex> lock(ready_mutex_);
+          if (!popReady(numa_node, curr)) {
+            // Wait for a running node to release the resource.
+            deferred_size_++;
+            return;
+          }
+          running_size_++;
+        }
+
+        execute(curr);
+
+        // Release the successors whose dependencies are all done. The
+        // output of the task is on the current node.
+        for (NodeId succ : nodes_[curr]->successors)
+          if (nodes_[succ]->remaining.fetch_sub(1) == 1)
+            submit(pool, wg, succ, numa_node);
+
+        finish(pool, wg);
+      },
+      wg);
+}
+
+bool TaskGraph::popReady(std::size_t numa_node, NodeId& id) {
+  // Find the largest task of the current node and the tasks without a
+  // preference. If there is none, run the largest task of the other nodes.
+  const std::size_t any_node = ready_.size() - 1;
+  const ReadyLess less;
+  for (;;) {
+    ReadyQueue* best = nullptr;
+    for (std::size_t pass = 0; pass < 2 && best == nullptr; ++pass) {
+      for (std::size_t i = 0; i < ready_.size(); ++i) {
+        const bool local = (i == numa_node || i == any_node);
+        if (local != (pass == 0) || ready_[i].empty()) continue;
+
+        if (best == nullptr || less(best->top(), ready_[i].top()))
+          best = &ready_[i];
+      }
+    }
+    if (best == nullptr) break;
+
+    const ReadyEntry entry = best->top();
+    best->pop();
+
+    const uint64_t resource = nodes_[entry.second]->resource;
+    if (resource_limit_ != 0 && resource != 0 &&
+        resource_size_ + resource > resource_limit_) {
+      postponed_.push(entry);
+      continue;
+    }
+
+    id = entry.second;
+    resource_size_ += resource;
+    resource_peak_ = std::max(resource_peak_, resource_size_);
+    return true;
+  }
+
+  // Nothing fits. The running nodes could release the resource. If there is
+  // none, run the largest postponed node over the limit.
+  if (running_size_ != 0 || postponed_.empty()) return false;
+
+  id = postponed_.top().second;
+  postponed_.pop();
+  resource_size_ += nodes_[id]->resource;
+  resource_peak_ = std::max(resource_peak_, resource_size_);
+
+  LOG_WARNING() << "Task " << id << " runs over the resource limit: "
+                << resource_size_ << " / " << resource_limit_ << std::endl;
+  return true;
+}
+
+void TaskGraph::finish(ThreadPool& pool, WaitGroup& wg) {
+  std::size_t retry_size = 0;
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    running_size_--;
+
+    // Retry the postponed nodes. They lose the NUMA preference.
+    for (; !postponed_.empty(); postponed_.pop())
+      ready_.back().push(postponed_.top());
+
+    retry_size = deferred_size_;
+    deferred_size_ = 0;
+  }
+
+  for (std::size_t i = 0; i < retry_size; ++i) dispatch(pool, wg);
+}
+
+void TaskGraph::execute(NodeId id) {
+  Node& node = *nodes_[id];
+
+  auto start = std::chrono::steady_clock::now();
+  node.task();
+  auto end = std::chrono::steady_clock::now();
+
+  const uint64_t time = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+          .count());
+  RunStats& stats = GetRunContext().getStats();
+  stats.task_size++;
+  stats.task_time += time;
+
+  if (node.cost == 0) return;
+
+  LOG_INFO() << "Task " << id << ": predicted cost " << node.cost
+             << ", actual time " << time << " us" << std::endl;
+}
+
+void TaskGraph::run() { run(GetRunContext().getThreadPool()); }
+
+void TaskGraph::run(ThreadPool& pool) {
+  for (auto& node : nodes_) node->remaining = node->dependency_size;
+
+  WaitGroup wg;
+
+  // Queue all ready nodes before the workers pick them so the first picks
+  // are the largest tasks.
+  std::size_t roots_size = 0;
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex_);
+    ready_.assign(pool.getNodeSize() + 1, ReadyQueue());
+    postponed_ = ReadyQueue();
+    running_size_ = 0;
+    deferred_size_ = 0;
+    resource_size_ = 0;
+    resource_peak_ = 0;
+
+    for (NodeId id = 0; id < nodes_.size(); ++id)
+      if (nodes_[id]->dependency_size == 0) {
+        ready_.back().emplace(nodes_[id]->cost, id);
+        roots_size++;
+      }
+  }
+
+  for (std::size_t i = 0; i < roots_size; ++i) dispatch(pool, wg);
+
+  wg.wait();
+
+  for (NodeId id = 0; id < nodes_.size(); ++id)
+    if (nodes_[id]->remaining.load() != 0)
+      LOG_ERROR() << "The task " << id << " is not executed. "
+                  << "Please check the graph has a cycle or not." << std::endl;
+}
+
+}  // namespace pcpe
@@ -0,0 +1,157 @@
+#include "temp_folder.h"
+
+#include <sys/statvfs.h>
+
+#include <cstdlib>
+#include <sstream>
+
+#include "env.h"
+
+namespace pcpe {
+
+/// Remove the trailing slashes of a folder path except the root.
+static FilePath TrimFolderPath(FilePath path) {
+  while (path.size() > 1 && path.back() == '/') path.pop_back();
+  return path;
+}
+
+bool ParseTempFolders(const std::string& str,
+                      std::vector<TempFolder>& folders) {
+  std::vector<TempFolder> result;
+  std::istringstream iss(str);
+  std::string item;
+
+  while (std::getline(iss, item, ',')) {
+    TempFolder folder(item, 1);
+
+    // The weight is the digits after the last colon.
+    const std::size_t colon = item.rfind(':');
+    if (colon != std::string::npos && colon + 1 < item.size() &&
+        item.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+      const unsigned long weight =
+          std::strtoul(item.c_str() + colon + 1, nullptr, 10);
+      if (weight == 0 || weight > kMaxTempFolderWeight) return false;
+
+      folder.path = item.substr(0, colon);
+      folder.weight = static_cast<uint32_t>(weight);
+    }
+
+    folder.path = TrimFolderPath(folder.path);
+    if (folder.path.empty()) return false;
+
+    result.push_back(folder);
+  }
+
+  if (result.empty()) return false;
+
+  folders.swap(result);
+  return true;
+}
+
+bool ParseTempPlacement(const std::string& str, TempPlacement& placement) {
+  if (str == "round-robin") {
+    placement = TempPlacement::kRoundRobin;
+  } else if (str == "free-space") {
+    placement = TempPlacement::kFreeSpace;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+bool GetFreeSpace(const FilePath& path, uint64_t& size) {
+  struct statvfs stat;
+  if (statvfs(path.c_str(), &stat) != 0) return false;
+
+  size = static_cast<uint64_t>(stat.f_bavail) *
+         static_cast<uint64_t>(stat.f_frsize);
+  return true;
+}
+
+/// Get the folder of the position in a cycle of the smooth weighted
+/// round-robin. The length of a cycle is the sum of the weights.
+static std::size_t GetRoundRobinFolder(const std::vector<TempFolder>& folders,
+                                       std::size_t position) {
+  int64_t total = 0;
+  for (const auto& folder : folders) total += folder.weight;
+
+  std::vector<int64_t> current(folders.size(), 0);
+  std::size_t selected = 0;
+  for (std::size_t step = 0;
+       step <= position % static_cast<std::size_t>(total); ++step) {
+    for (std::size_t i = 0; i < folders.size(); ++i)
+      current[i] += folders[i].weight;
+
+    selected = 0;
+    for (std::size_t i = 1; i < folders.size(); ++i)
+      if (current[i] > current[selected]) selected = i;
+
+    current[selected] -= total;
+  }
+
+  return selected;
+}
+
+std::size_t SelectTempFolder(const std::vector<TempFolder>& folders,
+                             TempPlacement placement, std::size_t index) {
+  if (folders.size() <= 1) return 0;
+
+  if (placement == TempPlacement::kRoundRobin)
+    return GetRoundRobinFolder(folders, index);
+
+  std::size_t selected = 0;
+  uint64_t max_space = 0;
+  for (std::size_t i = 0; i < folders.size(); ++i) {
+    uint64_t space = 0;
+    if (!GetFreeSpace(folders[i].path, space)) continue;
+
+    space = (space > UINT64_MAX / folders[i].weight)
+                ? UINT64_MAX
+                : space * folders[i].weight;
+    if (space > max_space) {
+      selected = i;
+      max_space = space;
+    }
+  }
+
+  return selected;
+}
+
+FilePath GetTempFilePath(const std::string& name, std::size_t index) {
+  const std::vector<TempFolder>& folders = GetEnv().getTempFolders();
+  const std::size_t selected =
+      SelectTempFolder(folders, GetEnv().getTempPlacement(), index);
+
+  return folders[selected].path + "/" + name;
+}
+
+FilePath GetStripedTempFilePath(const FilePath& filepath, std::size_t k) {
+  const std::vector<TempFolder>& folders = GetEnv().getTempFolders();
+  const std::size_t slash = filepath.rfind('/');
+  if (folders.size() <= 1 || slash == std::string::npos) return filepath;
+
+  const FilePath folder_path = TrimFolderPath(filepath.substr(0, slash));
+  const std::string name = filepath.substr(slash + 1);
+
+  std::size_t folder = 0;
+  while (folder < folders.size() && folders[folder].path != folder_path)
+    folder++;
+  if (folder == folders.size()) return filepath;
+
+  std::size_t selected = 0;
+  if (GetEnv().getTempPlacement() == TempPlacement::kRoundRobin) {
+    // Start from the first position of the folder in the round-robin cycle.
+    std::size_t position = 0;
+    while (GetRoundRobinFolder(folders, position) != folder) position++;
+    selected = GetRoundRobinFolder(folders, position + k);
+  } else {
+    // Rotate from the folder with the most free space.
+    selected = (SelectTempFolder(folders, TempPlacement::kFreeSpace, 0) + k) %
+               folders.size();
+  }
+
+  return folders[selected].path + "/" + name;
+}
+
+}  // namespace pcpe
@@ -0,0 +1,226 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "env.h"
+#include "logging.h"
+#include "run_context.h"
+
+namespace pcpe {
+
+namespace {
+
+thread_local ThreadPool* tCurrentPool = nullptr;
+thread_local std::size_t tCurrentWorker = 0;
+thread_local std::size_t tCurrentNode = 0;
+
+/**
+ * Take the task of the group nearest to the back (or the front) of the
+ * deque. The group nullptr matches any task.
+ * */
+template <typename PendingTasks, typename Task>
+bool TakeTask(PendingTasks& tasks, const WaitGroup* group, bool back,
+              Task& task) {
+  for (std::size_t i = 0; i < tasks.size(); ++i) {
+    const std::size_t idx = back ? tasks.size() - 1 - i : i;
+    if (group != nullptr && tasks[idx].group != group) continue;
+
+    task = std::move(tasks[idx].task);
+    tasks.erase(tasks.begin() + static_cast<std::ptrdiff_t>(idx));
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace
+
+void WaitGroup::add(std::size_t n) { count_.fetch_add(n); }
+
+void WaitGroup::done() {
+  // Hold the lock so `wait()` can not return and destroy the wait group
+  // before the notification is done.
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (count_.fetch_sub(1) == 1) cv_.notify_all();
+}
+
+void WaitGroup::wait() {
+  ThreadPool* pool = ThreadPool::getCurrentPool();
+
+  while (!finished()) {
+    // A worker helps to execute the pending tasks of the group rather than
+    // blocking.
+    if (pool != nullptr && pool->runPendingTask(this)) continue;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::milliseconds(pool != nullptr ? 1 : 100),
+                 [this]() { return finished(); });
+  }
+
+  // Make sure the last `done()` has released the lock.
+  std::lock_guard<std::mutex> lock(mutex_);
+}
+
+ThreadPool::ThreadPool(std::size_t threads_size, bool numa)
+    : numa_nodes_(),
+      node_size_(1),
+      worker_nodes_(),
+      queues_(),
+      shared_tasks_(),
+      shared_mutex_(),
+      pending_size_(0),
+      stop_(false),
+      sleep_mutex_(),
+      sleep_cv_(),
+      threads_() {
+  if (threads_size == 0) threads_size = 1;
+
+  if (numa) {
+    GetNumaNodes(numa_nodes_);
+    if (numa_nodes_.empty())
+      LOG_WARNING() << "Can not get NUMA nodes. NUMA mode is disabled."
+                    << std::endl;
+    else
+      node_size_ = numa_nodes_.size();
+
+    LOG_INFO() << "Thread pool: " << threads_size << " workers on "
+               << node_size_ << " NUMA node(s)." << std::endl;
+  }
+
+  for (std::size_t i = 0; i < threads_size; ++i) {
+    queues_.emplace_back(new WorkerQueue());
+    worker_nodes_.push_back(i % node_size_);
+  }
+
+  for (std::size_t i = 0; i < threads_size; ++i)
+    threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+
+  for (auto& t : threads_) t.join();
+}
+
+ThreadPool* ThreadPool::getCurrentPool() { return tCurrentPool; }
+
+std::size_t ThreadPool::getCurrentWorker() { return tCurrentWorker; }
+
+std::size_t ThreadPool::getCurrentNode() { return tCurrentNode; }
+
+void ThreadPool::submit(Task task, WaitGroup& wg) {
+  wg.add();
+
+  // The task runs in the context of the submitter.
+  WaitGroup* group = &wg;
+  RunContext* context = GetCurrentRunContext();
+  push(
+      [task, group, context]() {
+        ScopedRunContext scope(context);
+        task();
+        group->done();
+      },
+      group);
+}
+
+void ThreadPool::push(Task task, const WaitGroup* group) {
+  if (tCurrentPool == this) {
+    WorkerQueue& queue = *queues_[tCurrentWorker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(PendingTask{std::move(task), group});
+  } else {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    shared_tasks_.push_back(PendingTask{std::move(task), group});
+  }
+
+  pending_size_.fetch_add(1);
+
+  { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+  sleep_cv_.notify_one();
+}
+
+bool ThreadPool::popTask(std::size_t idx, const WaitGroup* group,
+                         Task& task) {
+  WorkerQueue& queue = *queues_[idx];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  return TakeTask(queue.tasks, group, true, task);
+}
+
+bool ThreadPool::stealTask(std::size_t idx, const WaitGroup* group,
+                           Task& task) {
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    if (TakeTask(shared_tasks_, group, false, task)) return true;
+  }
+
+  // Steal the oldest task of the other workers. The oldest task is usually
+  // the largest one of a fork-join task. The workers of the same node are
+  // checked first since the data of their tasks are on the node.
+  for (int same_node = 1; same_node >= 0; --same_node) {
+    for (std::size_t i = 1; i <= queues_.size(); ++i) {
+      const std::size_t victim = (idx + i) % queues_.size();
+      if ((worker_nodes_[victim] == worker_nodes_[idx]) != (same_node == 1))
+        continue;
+
+      WorkerQueue& queue = *queues_[victim];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (TakeTask(queue.tasks, group, false, task)) return true;
+    }
+  }
+
+  return false;
+}
+
+bool ThreadPool::getTask(const WaitGroup* group, Task& task) {
+  bool found = false;
+  if (tCurrentPool == this)
+    found = popTask(tCurrentWorker, group, task) ||
+            stealTask(tCurrentWorker, group, task);
+  else
+    found = stealTask(0, group, task);
+
+  if (found) pending_size_.fetch_sub(1);
+  return found;
+}
+
+bool ThreadPool::runPendingTask(const WaitGroup* group) {
+  Task task;
+  if (!getTask(group, task)) return false;
+
+  task();
+  return true;
+}
+
+void ThreadPool::workerLoop(std::size_t idx) {
+  tCurrentPool = this;
+  tCurrentWorker = idx;
+  tCurrentNode = worker_nodes_[idx];
+
+  if (!numa_nodes_.empty() &&
+      !BindCurrentThread(numa_nodes_[tCurrentNode].cpus))
+    LOG_WARNING() << "Bind worker " << idx << " to NUMA node "
+                  << numa_nodes_[tCurrentNode].id << " error." << std::endl;
+
+  while (true) {
+    if (runPendingTask()) continue;
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.wait(lock,
+                   [this]() { return stop_ || pending_size_.load() != 0; });
+
+    if (stop_ && pending_size_.load() == 0) break;
+  }
+}
+
+ThreadPool& GetThreadPool() {
+  static ThreadPool pool(std::max<uint32_t>(gEnv.getThreadsSize(), 1),
+                         gEnv.getNuma());
+  return pool;
+}
+
+}  // namespace pcpe
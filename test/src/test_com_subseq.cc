@@ -48,6 +48,30 @@ TEST(com_subseq, compare_operator) {
   ASSERT_TRUE(y >= x);
 }
 
+TEST(com_subseq, diagonal_order) {
+  ComSubseq x(1, 2, 3, 1, 6);  // diagonal: 2
+  ComSubseq y(1, 2, 4, 3, 6);  // diagonal: 1
+  ComSubseq z(1, 2, 4, 2, 6);  // diagonal: 2
+  ComSubseq u(0, 3, 9, 0, 6);
+
+  ASSERT_EQ(x.getDiagonal(), 2);
+  ASSERT_EQ(y.getDiagonal(), 1);
+  ASSERT_EQ(ComSubseq(1, 2, 0, 5, 6).getDiagonal(), -5);
+
+  ASSERT_TRUE(y.lessByDiagonal(x));
+  ASSERT_TRUE(x.lessByDiagonal(z));
+  ASSERT_TRUE(u.lessByDiagonal(y));
+  ASSERT_FALSE(x.lessByDiagonal(y));
+  ASSERT_FALSE(x.lessByDiagonal(x));
+
+  ComSubseqLess diagonal_less(ComSubseqOrder::kDiagonal);
+  ComSubseqLess location_less(ComSubseqOrder::kLocation);
+
+  ASSERT_TRUE(diagonal_less(y, x));
+  ASSERT_FALSE(location_less(y, x));
+  ASSERT_TRUE(location_less(x, y));
+}
+
 TEST(com_subseq, continue_fun) {
   ComSubseq x(1, 2, 3, 4, 6);
   ComSubseq y(1, 2, 3, 4, 7);
@@ -377,7 +401,8 @@ TEST(com_subseq, CombineComSubSeqFiles) {
   };
 
   FilePath ofilepath("./testdata/test_combine_file.out");
-  CombineComSubSeqFiles(ifilepaths, ofilepath);
+  ASSERT_TRUE(CombineComSubSeqFiles(ifilepaths, ofilepath));
+  ASSERT_FALSE(CombineComSubSeqFiles(ifilepaths, "./testdata/none/out"));
 
   std::vector<ComSubseq> ans;
   {
@@ -396,4 +421,33 @@ TEST(com_subseq, CombineComSubSeqFiles) {
     ASSERT_EQ(ans[i], seqs[i]);
 }
 
+TEST(com_subseq, AppendComSubseqFile) {
+  const FilePath ifilepath("./testoutput/test_append_file.in");
+  const FilePath ofilepath("./testoutput/test_append_file.out");
+
+  std::vector<ComSubseq> seqs;
+  for (uint32_t i = 0; i < 100000; ++i)
+    seqs.push_back(ComSubseq(i, i + 1, i + 2, i + 3, i % 100));
+  WriteComSubseqFile(seqs, ifilepath);
+
+  std::vector<ComSubseq> ans{ComSubseq(7, 7, 7, 7, 7)};
+  WriteComSubseqFile(ans, ofilepath);
+
+  ASSERT_TRUE(AppendComSubseqFile(ifilepath, ofilepath));
+  ASSERT_TRUE(AppendComSubseqFile("./testoutput/not_exist_file", ofilepath));
+  ans.insert(ans.end(), seqs.begin(), seqs.end());
+
+  std::vector<ComSubseq> result;
+  ReadComSubseqFile(ofilepath, result);
+
+  ASSERT_EQ(ans.size(), result.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], result[i]);
+    ASSERT_EQ(ans[i].getLength(), result[i].getLength());
+  }
+
+  std::remove(ifilepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
 } // namespace pcpe
@@ -1,11 +1,19 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <vector>
 
 #include "logging.h"
 #include "com_subseq.h"
 #include "com_subseq_sort.h"
 #include "env.h"
+#include "max_comsubseq.h"
+#include "pcpe_util.h"
+#include "run_context.h"
+#include "thread_pool.h"
 
 namespace pcpe {
 
@@ -79,5 +87,309 @@ TEST(com_subseq_sort, SortComSubseqsFiles_small_buffer) {
   ASSERT_TRUE(std::is_sorted(seqs.begin(), seqs.end()));
 }
 
+static void CreateInterleavedDiagonalSeqs(const FilePath& filepath) {
+  std::vector<ComSubseq> seqs{
+      ComSubseq(0, 0, 2, 1, 6), ComSubseq(0, 0, 1, 1, 6),
+      ComSubseq(0, 0, 0, 0, 6), ComSubseq(0, 0, 3, 2, 6),
+      ComSubseq(0, 0, 1, 0, 6), ComSubseq(0, 0, 2, 2, 6),
+  };
+
+  WriteComSubseqFile(seqs, filepath);
+}
+
+TEST(com_subseq_sort, SortComSubseqsFiles_diagonal_order) {
+  std::vector<FilePath> ifilepaths{"./testoutput/test_diagonal_sort.in"};
+  std::vector<FilePath> ofilepaths;
+  CreateInterleavedDiagonalSeqs(ifilepaths[0]);
+
+  {
+    FilePath saved_temp = gEnv.getTempFolderPath();
+    std::size_t saved_buffer_size = gEnv.getBufferSize();
+    ComSubseqOrder saved_order = gEnv.getComSubseqOrder();
+    gEnv.setTempFolderPath("testoutput/");
+    gEnv.setBufferSize(sizeof(ComSubseq) * 4);
+    gEnv.setComSubseqOrder(ComSubseqOrder::kDiagonal);
+
+    SortComSubseqsFiles(ifilepaths, ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp);
+    gEnv.setBufferSize(saved_buffer_size);
+    gEnv.setComSubseqOrder(saved_order);
+  }
+
+  ASSERT_EQ(ifilepaths.size(), ofilepaths.size());
+
+  std::vector<ComSubseq> ans{
+      ComSubseq(0, 0, 0, 0, 6), ComSubseq(0, 0, 1, 1, 6),
+      ComSubseq(0, 0, 2, 2, 6), ComSubseq(0, 0, 1, 0, 6),
+      ComSubseq(0, 0, 2, 1, 6), ComSubseq(0, 0, 3, 2, 6),
+  };
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepaths[0].c_str(), seqs);
+
+  ASSERT_EQ(seqs.size(), ans.size());
+  for (std::size_t i = 0; i < seqs.size(); ++i)
+    ASSERT_EQ(seqs[i], ans[i]);
+}
+
+TEST(com_subseq_sort, SortComSubseqsFiles_location_order) {
+  std::vector<FilePath> ifilepaths{"./testoutput/test_location_sort.in"};
+  std::vector<FilePath> ofilepaths;
+  CreateInterleavedDiagonalSeqs(ifilepaths[0]);
+
+  {
+    FilePath saved_temp = gEnv.getTempFolderPath();
+    ComSubseqOrder saved_order = gEnv.getComSubseqOrder();
+    gEnv.setTempFolderPath("testoutput/");
+    gEnv.setComSubseqOrder(ComSubseqOrder::kLocation);
+
+    SortComSubseqsFiles(ifilepaths, ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp);
+    gEnv.setComSubseqOrder(saved_order);
+  }
+
+  ASSERT_EQ(ifilepaths.size(), ofilepaths.size());
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepaths[0].c_str(), seqs);
+
+  ASSERT_EQ(6UL, seqs.size());
+  ASSERT_TRUE(std::is_sorted(seqs.begin(), seqs.end()));
+}
+
+static void CheckComSubseqSortBuffer(uint32_t buffer_size,
+                                     std::size_t spill_size) {
+  std::vector<ComSubseq> seqs{
+      ComSubseq(2, 1, 3, 1, 6), ComSubseq(0, 0, 1, 0, 6),
+      ComSubseq(2, 0, 1, 0, 6), ComSubseq(1, 1, 2, 0, 6),
+      ComSubseq(2, 1, 2, 0, 6), ComSubseq(1, 0, 1, 0, 6),
+  };
+  FilePath ofilepath("./testoutput/test_sort_buffer.out");
+
+  {
+    uint32_t saved_buffer_size = gEnv.getBufferSize();
+    gEnv.setBufferSize(buffer_size);
+
+    ComSubseqSortBuffer buffer("./testoutput/test_sort_buffer");
+    for (const auto& seq : seqs) ASSERT_TRUE(buffer.writeSeq(seq));
+
+    ComSubseqFileWriter writer(ofilepath);
+    buffer.sortTo(writer);
+    writer.close();
+
+    ASSERT_EQ(spill_size, buffer.getSpillSize());
+    ASSERT_FALSE(CheckFileExists("./testoutput/test_sort_buffer_run_0"));
+
+    gEnv.setBufferSize(saved_buffer_size);
+  }
+
+  std::vector<ComSubseq> sorted_seqs;
+  ReadComSubseqFile(ofilepath, sorted_seqs);
+
+  std::sort(seqs.begin(), seqs.end(), ComSubseqLess(gEnv.getComSubseqOrder()));
+  ASSERT_EQ(seqs.size(), sorted_seqs.size());
+  for (std::size_t i = 0; i < seqs.size(); ++i)
+    ASSERT_EQ(seqs[i], sorted_seqs[i]);
+}
+
+TEST(com_subseq_sort, ComSubseqSortBuffer) {
+  CheckComSubseqSortBuffer(gEnv.getBufferSize(), 0);
+}
+
+TEST(com_subseq_sort, ComSubseqSortBuffer_spill) {
+  CheckComSubseqSortBuffer(sizeof(ComSubseq) * 4, 2);
+}
+
+TEST(com_subseq_sort, ComSubseqSortBuffer_large) {
+  // Large enough to be sorted by the fork-join sort.
+  const uint32_t kSeqsSize = 300000;
+  FilePath ofilepath("./testoutput/test_sort_buffer_large.out");
+
+  {
+    ComSubseqSortBuffer buffer("./testoutput/test_sort_buffer_large");
+    for (uint32_t i = 0; i < kSeqsSize; ++i) {
+      uint32_t v = (i * 7919U) % kSeqsSize;
+      buffer.writeSeq(ComSubseq(v % 13, v % 7, v, v % 101, 6));
+    }
+
+    ComSubseqFileWriter writer(ofilepath);
+    buffer.sortTo(writer);
+    writer.close();
+  }
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+
+  ASSERT_EQ(kSeqsSize, seqs.size());
+  ASSERT_TRUE(std::is_sorted(seqs.begin(), seqs.end(),
+                             ComSubseqLess(gEnv.getComSubseqOrder())));
+}
+
+TEST(com_subseq_sort, ParallelMergeSortedComSubseqFiles) {
+  const ComSubseqLess less(ComSubseqOrder::kDiagonal);
+  std::vector<FilePath> ifilepaths{
+      "testoutput/test_parallel_merge_0.in",
+      "testoutput/test_parallel_merge_1.in",
+      "testoutput/test_parallel_merge_2.in",
+      "testoutput/test_parallel_merge_3.in"};
+  const FilePath ofilepath("testoutput/test_parallel_merge.out");
+
+  // Sorted files of different sizes. The last one is empty.
+  std::mt19937 gen(47);
+  std::vector<ComSubseq> ans;
+  const std::size_t sizes[] = {20000, 7000, 13, 0};
+  uint32_t y_loc = 0;
+  for (std::size_t i = 0; i < ifilepaths.size(); ++i) {
+    std::vector<ComSubseq> seqs;
+    for (std::size_t j = 0; j < sizes[i]; ++j)
+      seqs.emplace_back(gen() % 50, gen() % 50, gen() % 1000, y_loc++,
+                        6 + gen() % 10);
+    std::sort(seqs.begin(), seqs.end(), less);
+    WriteComSubseqFile(seqs, ifilepaths[i]);
+    ans.insert(ans.end(), seqs.begin(), seqs.end());
+  }
+  std::sort(ans.begin(), ans.end(), less);
+
+  // Small buffers and 4 workers so the output is split into 4 partitions.
+  Env env;
+  env.setIOBufferSize(4096);
+  env.setComSubseqOrder(ComSubseqOrder::kDiagonal);
+  ThreadPool pool(4);
+  RunContext context("", env, &pool);
+  {
+    ScopedRunContext scope(context);
+    ASSERT_TRUE(ParallelMergeSortedComSubseqFiles(ifilepaths, ofilepath));
+  }
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]) << i;
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength()) << i;
+  }
+
+  // No input.
+  ASSERT_TRUE(ParallelMergeSortedComSubseqFiles({}, ofilepath));
+  EXPECT_FALSE(CheckFileNotEmpty(ofilepath.c_str()));
+
+  for (const auto& filepath : ifilepaths) std::remove(filepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
+TEST(com_subseq_sort, ParallelMergeSortedComSubseqFiles_many_files) {
+  const ComSubseqLess less(ComSubseqOrder::kDiagonal);
+  const FilePath ofilepath("testoutput/test_parallel_merge_many.out");
+
+  // More files than a partition merges at a time.
+  std::mt19937 gen(47);
+  std::vector<FilePath> ifilepaths;
+  std::vector<ComSubseq> ans;
+  for (uint32_t i = 0; i < 150; ++i) {
+    std::vector<ComSubseq> seqs;
+    for (uint32_t j = 0; j < 100; ++j)
+      seqs.emplace_back(gen() % 50, gen() % 50, gen() % 1000, i * 100 + j, 6);
+    std::sort(seqs.begin(), seqs.end(), less);
+
+    std::ostringstream oss;
+    oss << "testoutput/test_parallel_merge_many_" << i << ".in";
+    ifilepaths.push_back(oss.str());
+    WriteComSubseqFile(seqs, ifilepaths.back());
+    ans.insert(ans.end(), seqs.begin(), seqs.end());
+  }
+  std::sort(ans.begin(), ans.end(), less);
+
+  Env env;
+  env.setIOBufferSize(4096);
+  env.setComSubseqOrder(ComSubseqOrder::kDiagonal);
+  ThreadPool pool(4);
+  RunContext context("", env, &pool);
+  {
+    ScopedRunContext scope(context);
+    ASSERT_TRUE(ParallelMergeSortedComSubseqFiles(ifilepaths, ofilepath));
+  }
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]) << i;
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength()) << i;
+  }
+
+  // The merged groups are removed.
+  ASSERT_FALSE(CheckFileExists((ofilepath + "_merge_0_0").c_str()));
+
+  for (const auto& filepath : ifilepaths) std::remove(filepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
+TEST(com_subseq_sort, ComSubseqSortBuffer_sortMaxTo) {
+  // Continuous runs on the diagonals of 400 sequence pairs in random order.
+  std::mt19937 gen(29);
+  std::vector<ComSubseq> seqs;
+  for (uint32_t x = 0; x < 20; ++x) {
+    for (uint32_t y = 0; y < 20; ++y) {
+      for (uint32_t r = gen() % 5; r > 0; --r) {
+        const uint32_t x_loc = gen() % 1000;
+        const uint32_t y_loc = gen() % 1000;
+        for (uint32_t i = gen() % 20; i > 0; --i)
+          seqs.emplace_back(x, y, x_loc + i, y_loc + i, 6);
+      }
+    }
+  }
+  std::shuffle(seqs.begin(), seqs.end(), gen);
+
+  // Keep the top 2 runs of each pair so a split pair changes the result.
+  Env env;
+  env.setIOBufferSize(4096);
+  env.setMinimumOutputLength(8);
+  env.setPairTopSize(2);
+  ThreadPool pool(4);
+  RunContext context("", env, &pool);
+  ScopedRunContext scope(context);
+
+  const FilePath ans_filepath("testoutput/test_sort_max_to.ans");
+  {
+    ComSubseqSortBuffer buffer("testoutput/test_sort_max_to_ans");
+    for (const auto& seq : seqs) buffer.writeSeq(seq);
+    ASSERT_TRUE(buffer.sortMaxTo(ans_filepath));
+    ASSERT_EQ(0UL, buffer.getSpillSize());
+  }
+
+  // The output can not be opened.
+  {
+    ComSubseqSortBuffer buffer("testoutput/test_sort_max_to_none");
+    for (const auto& seq : seqs) buffer.writeSeq(seq);
+    ASSERT_FALSE(buffer.sortMaxTo("testoutput/none/test_sort_max_to"));
+  }
+
+  // Small buffers so the ComSubseqs are spilled and merged in 4 partitions.
+  const FilePath ofilepath("testoutput/test_sort_max_to.out");
+  context.getEnv().setBufferSize(sizeof(ComSubseq) * 1000);
+  {
+    ComSubseqSortBuffer buffer("testoutput/test_sort_max_to");
+    for (const auto& seq : seqs) buffer.writeSeq(seq);
+    ASSERT_TRUE(buffer.sortMaxTo(ofilepath));
+    ASSERT_LT(1UL, buffer.getSpillSize());
+  }
+
+  std::vector<ComSubseq> ans;
+  std::vector<ComSubseq> result;
+  ReadComSubseqFile(ans_filepath, ans);
+  ReadComSubseqFile(ofilepath, result);
+  ASSERT_LT(0UL, ans.size());
+  ASSERT_EQ(ans.size(), result.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], result[i]) << i;
+    ASSERT_EQ(ans[i].getLength(), result[i].getLength()) << i;
+  }
+
+  std::remove(ans_filepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
 } // namespace pcpe
 
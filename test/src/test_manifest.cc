@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "manifest.h"
+#include "pcpe_util.h"
+
+namespace pcpe {
+
+static void WriteTextFile(const FilePath& filepath, const char* content) {
+  std::ofstream ofile(filepath.c_str(),
+                      std::ofstream::out | std::ofstream::binary);
+  ofile << content;
+}
+
+static std::size_t CountLines(const FilePath& filepath) {
+  std::ifstream infile(filepath.c_str());
+  std::size_t size = 0;
+  std::string line;
+  while (std::getline(infile, line)) size++;
+
+  return size;
+}
+
+TEST(manifest, GetFileChecksum) {
+  const FilePath filepath("testoutput/test_manifest_checksum");
+
+  uint64_t size = 0;
+  uint64_t checksum = 0;
+
+  // The FNV-1a test vectors.
+  WriteTextFile(filepath, "");
+  ASSERT_TRUE(GetFileChecksum(filepath, size, checksum));
+  ASSERT_EQ(0UL, size);
+  ASSERT_EQ(0xcbf29ce484222325ULL, checksum);
+
+  WriteTextFile(filepath, "a");
+  ASSERT_TRUE(GetFileChecksum(filepath, size, checksum));
+  ASSERT_EQ(1UL, size);
+  ASSERT_EQ(0xaf63dc4c8601ec8cULL, checksum);
+
+  WriteTextFile(filepath, "foobar");
+  ASSERT_TRUE(GetFileChecksum(filepath, size, checksum));
+  ASSERT_EQ(6UL, size);
+  ASSERT_EQ(0x85944171f73967e8ULL, checksum);
+
+  // A file which does not exist is not an empty file.
+  ASSERT_FALSE(GetFileChecksum("testoutput/does_not_exist", size, checksum));
+}
+
+TEST(manifest, record_and_load) {
+  const FilePath manifest_filepath("testoutput/test_manifest");
+  const FilePath output1("testoutput/test_manifest_output 1");
+  const FilePath output2("testoutput/test_manifest_output_2");
+  WriteTextFile(output1, "output1");
+  WriteTextFile(output2, "output2");
+
+  {
+    Manifest manifest(manifest_filepath, "x y 10");
+    ASSERT_TRUE(manifest.save());
+    ASSERT_TRUE(manifest.record(output1));
+    ASSERT_TRUE(manifest.record(output2));
+
+    ASSERT_TRUE(manifest.isDone(output1));
+    ASSERT_TRUE(manifest.isDone(output2));
+    ASSERT_FALSE(manifest.isDone("testoutput/test_manifest_output_3"));
+  }
+
+  ASSERT_FALSE(CheckFileExists((manifest_filepath + ".tmp").c_str()));
+
+  // Load the records of the last run.
+  {
+    Manifest manifest(manifest_filepath, "x y 10");
+    ASSERT_TRUE(manifest.load());
+    ASSERT_EQ(2UL, manifest.size());
+    ASSERT_TRUE(manifest.isDone(output1));
+
+    // The file is changed after it's recorded.
+    WriteTextFile(output2, "changed");
+    ASSERT_FALSE(manifest.isDone(output2));
+
+    ASSERT_TRUE(manifest.remove(output1));
+    ASSERT_FALSE(manifest.isDone(output1));
+  }
+
+  {
+    Manifest manifest(manifest_filepath, "x y 10");
+    ASSERT_TRUE(manifest.load());
+    ASSERT_EQ(1UL, manifest.size());
+  }
+
+  // The manifest of another run is not loaded.
+  {
+    Manifest manifest(manifest_filepath, "x y 20");
+    ASSERT_FALSE(manifest.load());
+    ASSERT_EQ(0UL, manifest.size());
+  }
+}
+
+TEST(manifest, consume_and_append) {
+  const FilePath manifest_filepath("testoutput/test_manifest_consume");
+  const FilePath result("testoutput/test_manifest_result");
+  const FilePath output("testoutput/test_manifest_pair");
+  WriteTextFile(result, "foo");
+  WriteTextFile(output, "bar");
+
+  uint64_t size = 0;
+  uint64_t checksum = 0;
+  ASSERT_TRUE(GetFileChecksum(result, size, checksum));
+  ASSERT_TRUE(UpdateFileChecksum(output, UINT64_MAX, size, checksum));
+  ASSERT_EQ(6UL, size);
+  ASSERT_EQ(0x85944171f73967e8ULL, checksum);  // "foobar"
+
+  // Read a part of the file.
+  uint64_t record_size = 0;
+  uint64_t record_checksum = 0;
+  uint64_t part_size = 0;
+  uint64_t part_checksum = kEmptyChecksum;
+  ASSERT_TRUE(UpdateFileChecksum(result, 1, part_size, part_checksum));
+  ASSERT_EQ(1UL, part_size);
+
+  WriteTextFile(output, "f");
+  ASSERT_TRUE(GetFileChecksum(output, record_size, record_checksum));
+  ASSERT_EQ(record_checksum, part_checksum);
+  WriteTextFile(output, "bar");
+
+  {
+    Manifest manifest(manifest_filepath, "sig");
+    ASSERT_TRUE(manifest.record(output));
+    ASSERT_TRUE(manifest.append(result, size, checksum, output));
+    std::remove(output.c_str());
+
+    // The consumed output is done without the file.
+    ASSERT_TRUE(manifest.isConsumed(output));
+    ASSERT_TRUE(manifest.isDone(output));
+  }
+
+  Manifest manifest(manifest_filepath, "sig");
+  ASSERT_TRUE(manifest.load());
+  ASSERT_TRUE(manifest.isConsumed(output));
+  ASSERT_FALSE(manifest.isConsumed(result));
+
+  ASSERT_TRUE(manifest.getRecord(result, record_size, record_checksum));
+  ASSERT_EQ(size, record_size);
+  ASSERT_EQ(checksum, record_checksum);
+}
+
+TEST(manifest, journal) {
+  const FilePath manifest_filepath("testoutput/test_manifest_journal");
+  const FilePath output1("testoutput/test_manifest_journal_1");
+  const FilePath output2("testoutput/test_manifest_journal_2");
+
+  {
+    Manifest manifest(manifest_filepath, "sig");
+    ASSERT_TRUE(manifest.save());
+    ASSERT_EQ(2UL, CountLines(manifest_filepath));
+
+    // Each change appends lines to the file.
+    ASSERT_TRUE(manifest.record(output1, 1, 2));
+    ASSERT_TRUE(manifest.record(output1, 3, 4));
+    ASSERT_TRUE(manifest.append(output1, 5, 6, output2));
+    ASSERT_TRUE(manifest.remove(output2));
+    ASSERT_EQ(7UL, CountLines(manifest_filepath));
+  }
+
+  // A later line overrides the earlier ones.
+  {
+    Manifest manifest(manifest_filepath, "sig");
+    ASSERT_TRUE(manifest.load());
+    ASSERT_EQ(1UL, manifest.size());
+
+    uint64_t size = 0;
+    uint64_t checksum = 0;
+    ASSERT_TRUE(manifest.getRecord(output1, size, checksum));
+    ASSERT_EQ(5UL, size);
+    ASSERT_EQ(6UL, checksum);
+
+    // Compact the journal.
+    ASSERT_TRUE(manifest.save());
+    ASSERT_EQ(3UL, CountLines(manifest_filepath));
+  }
+
+  // A torn change is ignored: the second line of the change is missing and
+  // the last line has no line break.
+  {
+    std::ofstream ofile(manifest_filepath.c_str(), std::ofstream::app);
+    ofile << "D+ 7 8 " << output1 << "\nC 0 0 " << output2;
+  }
+  {
+    Manifest manifest(manifest_filepath, "sig");
+    ASSERT_TRUE(manifest.load());
+    ASSERT_EQ(1UL, manifest.size());
+    ASSERT_FALSE(manifest.isConsumed(output2));
+
+    uint64_t size = 0;
+    uint64_t checksum = 0;
+    ASSERT_TRUE(manifest.getRecord(output1, size, checksum));
+    ASSERT_EQ(5UL, size);
+
+    // The first change rewrites the file without the torn change.
+    ASSERT_TRUE(manifest.consume(output2));
+    ASSERT_EQ(4UL, CountLines(manifest_filepath));
+  }
+  {
+    Manifest manifest(manifest_filepath, "sig");
+    ASSERT_TRUE(manifest.load());
+    ASSERT_EQ(2UL, manifest.size());
+    ASSERT_TRUE(manifest.isConsumed(output2));
+  }
+}
+
+TEST(manifest, load_invalid) {
+  const FilePath manifest_filepath("testoutput/test_manifest_invalid");
+  WriteTextFile(manifest_filepath, "pcpe-manifest 1\nsig\nbroken\n");
+
+  Manifest manifest(manifest_filepath, "sig");
+  ASSERT_FALSE(manifest.load());
+  ASSERT_EQ(0UL, manifest.size());
+
+  Manifest missing("testoutput/does_not_exist", "sig");
+  ASSERT_FALSE(missing.load());
+}
+
+}  // namespace pcpe
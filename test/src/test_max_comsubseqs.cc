@@ -7,14 +7,12 @@
 #include "max_comsubseq.h"
 #include "logging.h"
 #include "com_subseq.h"
+#include "com_subseq_sort.h"
 #include "env.h"
 #include "pcpe_util.h"
 
 namespace pcpe {
 
-extern void MergeContineousComSubseqs(ComSubseq* seqs,
-                                      bool* merges,
-                                      std::size_t seqs_size);
 extern void WriteMergedComSubseqs(ComSubseqFileWriter& writer,
                                   ComSubseq* seqs,
                                   bool* merges,
@@ -335,4 +333,153 @@ TEST(max_comsubseqs, MaxdSortedComSubseqs) {
   }
 }
 
+TEST(max_comsubseqs, MaxComSubseqFileWriter) {
+  FilePath ofilepath("./testoutput/test_max_comsubseq_writer.out");
+
+  {
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setMinimumOutputLength(7);
+
+    std::vector<ComSubseq> seqs;
+    CreateTestSeqs(seqs);
+
+    MaxComSubseqFileWriter writer(ofilepath);
+    for (const auto& seq : seqs) ASSERT_TRUE(writer.writeSeq(seq));
+    writer.close();
+
+    gEnv.setMinimumOutputLength(saved_output_length);
+  }
+
+  std::vector<ComSubseq> ans;
+  CreateAnsSeqs(ans);
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]);
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength());
+  }
+}
+
+TEST(max_comsubseqs, PairTopComSubseqs) {
+  std::vector<ComSubseq> runs{
+      ComSubseq(0, 0, 0, 0, 8),  ComSubseq(0, 0, 1, 5, 12),
+      ComSubseq(0, 0, 2, 9, 8),  ComSubseq(0, 0, 3, 1, 10),
+      ComSubseq(0, 1, 0, 0, 7),  ComSubseq(1, 0, 4, 4, 9),
+      ComSubseq(1, 0, 5, 0, 11),
+  };
+
+  // The longest two of each pair in the input order. The earlier run wins a
+  // tie.
+  {
+    PairTopComSubseqs top(2);
+    std::vector<ComSubseq> seqs;
+    for (const auto& run : runs) top.add(run, seqs);
+    top.flush(seqs);
+
+    std::vector<ComSubseq> ans{runs[1], runs[3], runs[4], runs[5], runs[6]};
+    ASSERT_EQ(ans.size(), seqs.size());
+    for (std::size_t i = 0; i < ans.size(); ++i) {
+      EXPECT_EQ(ans[i], seqs[i]) << i;
+      EXPECT_EQ(ans[i].getLength(), seqs[i].getLength()) << i;
+    }
+  }
+
+  // The size 0 selects all.
+  {
+    PairTopComSubseqs top(0);
+    std::vector<ComSubseq> seqs;
+    for (const auto& run : runs) top.add(run, seqs);
+    top.flush(seqs);
+
+    EXPECT_EQ(runs, seqs);
+  }
+}
+
+TEST(max_comsubseqs, MaxComSubseqFileWriter_pair_top) {
+  FilePath ofilepath("./testoutput/test_max_comsubseq_writer_top.out");
+
+  {
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setMinimumOutputLength(6);
+    gEnv.setPairTopSize(1);
+
+    std::vector<ComSubseq> seqs;
+    CreateTestSeqs(seqs);
+
+    MaxComSubseqFileWriter writer(ofilepath);
+    for (const auto& seq : seqs) ASSERT_TRUE(writer.writeSeq(seq));
+    writer.close();
+
+    gEnv.setMinimumOutputLength(saved_output_length);
+    gEnv.setPairTopSize(0);
+  }
+
+  // The best run of each pair.
+  std::vector<ComSubseq> ans{
+      ComSubseq(0, 0, 1, 0, 6), ComSubseq(1, 0, 1, 0, 6),
+      ComSubseq(1, 1, 2, 0, 6), ComSubseq(2, 0, 1, 0, 6),
+      ComSubseq(2, 1, 2, 0, 7), ComSubseq(3, 2, 2, 0, 8),
+      ComSubseq(4, 1, 0, 0, 6), ComSubseq(5, 0, 1, 0, 6),
+  };
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]);
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength());
+  }
+}
+
+TEST(max_comsubseqs, MaxSortedComSubseqs_diagonal_order) {
+  // Two diagonals of the same sequence pair. In the location order, the hits
+  // of the two diagonals interleave and no one can be merged.
+  std::vector<FilePath> ifilepaths{"./testoutput/test_merged_diagonal"};
+  {
+    std::vector<ComSubseq> seqs{
+        ComSubseq(0, 0, 0, 0, 6), ComSubseq(0, 0, 1, 0, 6),
+        ComSubseq(0, 0, 1, 1, 6), ComSubseq(0, 0, 2, 1, 6),
+        ComSubseq(0, 0, 2, 2, 6), ComSubseq(0, 0, 3, 2, 6),
+    };
+    WriteComSubseqFile(seqs, ifilepaths[0]);
+  }
+
+  std::vector<FilePath> sorted_filepaths;
+  std::vector<FilePath> ofilepaths;
+  {
+    FilePath saved_temp_folder = gEnv.getTempFolderPath();
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    ComSubseqOrder saved_order = gEnv.getComSubseqOrder();
+    gEnv.setTempFolderPath("./testoutput/");
+    gEnv.setMinimumOutputLength(6);
+    gEnv.setComSubseqOrder(ComSubseqOrder::kDiagonal);
+
+    SortComSubseqsFiles(ifilepaths, sorted_filepaths);
+    MaxSortedComSubseqs(sorted_filepaths, ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp_folder);
+    gEnv.setMinimumOutputLength(saved_output_length);
+    gEnv.setComSubseqOrder(saved_order);
+  }
+
+  ASSERT_EQ(1UL, ofilepaths.size());
+
+  std::vector<ComSubseq> ans{
+      ComSubseq(0, 0, 0, 0, 8), ComSubseq(0, 0, 1, 0, 8),
+  };
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepaths[0], seqs);
+
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]);
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength());
+  }
+}
+
 } // namespace pcpe
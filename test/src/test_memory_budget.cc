@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "memory_budget.h"
+
+namespace pcpe {
+
+TEST(memory_budget, no_limit) {
+  MemoryBudget budget(0);
+
+  ASSERT_EQ(1000UL, budget.reserve(10, 1000, false));
+  ASSERT_EQ(2000UL, budget.reserve(10, 2000, false));
+  ASSERT_EQ(3000UL, budget.getUsedSize());
+
+  budget.release(3000);
+  ASSERT_EQ(0UL, budget.getUsedSize());
+  ASSERT_EQ(3000UL, budget.getPeakSize());
+}
+
+TEST(memory_budget, shrink) {
+  MemoryBudget budget(100);
+
+  ASSERT_EQ(80UL, budget.reserve(10, 80, false));
+  ASSERT_EQ(20UL, budget.reserve(10, 80, false));
+  ASSERT_EQ(100UL, budget.getUsedSize());
+
+  budget.release(100);
+  ASSERT_EQ(0UL, budget.getUsedSize());
+}
+
+TEST(memory_budget, min_size_over_limit) {
+  MemoryBudget budget(100);
+
+  ASSERT_EQ(100UL, budget.reserve(500, 1000, false));
+  budget.release(100);
+}
+
+TEST(memory_budget, nested) {
+  MemoryBudget budget(100);
+
+  // The nested reservation gets the minimum size without blocking even if
+  // the budget is exceeded.
+  ASSERT_EQ(100UL, budget.reserve(10, 100, false));
+  ASSERT_EQ(10UL, budget.reserve(10, 100, true));
+  ASSERT_EQ(110UL, budget.getPeakSize());
+
+  budget.release(110);
+}
+
+TEST(memory_budget, throttle) {
+  MemoryBudget budget(100);
+  std::atomic<bool> released(false);
+  std::atomic<bool> reserved_before_release(false);
+
+  MemoryReservation memory(budget, 60, 60);
+
+  std::thread other([&]() {
+    MemoryReservation other_memory(budget, 50, 50);
+    reserved_before_release = !released.load();
+  });
+
+  usleep(50000);
+  released = true;
+  memory.release();
+  other.join();
+
+  ASSERT_FALSE(reserved_before_release.load());
+  ASSERT_EQ(0UL, budget.getUsedSize());
+  ASSERT_EQ(60UL, budget.getPeakSize());
+}
+
+TEST(memory_budget, reservation_in_reservation) {
+  MemoryBudget budget(100);
+
+  MemoryReservation outer(budget, 100, 100);
+  {
+    // The thread holds a reservation so it does not wait for itself.
+    MemoryReservation inner(budget, 10, 50);
+    ASSERT_EQ(10UL, inner.size());
+  }
+
+  ASSERT_EQ(100UL, budget.getUsedSize());
+}
+
+}  // namespace pcpe
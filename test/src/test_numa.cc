@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "numa.h"
+#include "pcpe_util.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+static void WriteCpuList(const FilePath& folder, const std::string& cpulist) {
+  CreateFolder(folder.c_str());
+  std::ofstream ofile(folder + "/cpulist");
+  ofile << cpulist << std::endl;
+}
+
+TEST(numa, ParseCpuList) {
+  {
+    std::vector<uint32_t> cpus;
+    ASSERT_TRUE(ParseCpuList("0-3,8-11\n", cpus));
+
+    std::vector<uint32_t> ans = {0, 1, 2, 3, 8, 9, 10, 11};
+    ASSERT_EQ(ans, cpus);
+  }
+
+  {
+    std::vector<uint32_t> cpus;
+    ASSERT_TRUE(ParseCpuList("0,2,4", cpus));
+
+    std::vector<uint32_t> ans = {0, 2, 4};
+    ASSERT_EQ(ans, cpus);
+  }
+
+  {
+    std::vector<uint32_t> cpus;
+    ASSERT_TRUE(ParseCpuList("", cpus));
+    ASSERT_TRUE(cpus.empty());
+  }
+
+  {
+    std::vector<uint32_t> cpus;
+    ASSERT_FALSE(ParseCpuList("a", cpus));
+    ASSERT_FALSE(ParseCpuList("3-1", cpus));
+    ASSERT_FALSE(ParseCpuList("1-", cpus));
+    ASSERT_FALSE(ParseCpuList("1x", cpus));
+  }
+}
+
+TEST(numa, GetNumaNodes) {
+  const FilePath sysfs_path("testoutput/test_numa_node");
+  WriteCpuList(sysfs_path + "/node2", "0-4095");
+  WriteCpuList(sysfs_path + "/node0", "0-4095");
+  WriteCpuList(sysfs_path + "/node1", "");
+  WriteCpuList(sysfs_path + "/nodex", "0-4095");
+
+  std::vector<NumaNode> nodes;
+  GetNumaNodes(nodes, sysfs_path);
+
+  // node1 has no CPU and nodex is not a node.
+  ASSERT_EQ(2UL, nodes.size());
+  ASSERT_EQ(0U, nodes[0].id);
+  ASSERT_EQ(2U, nodes[1].id);
+  ASSERT_FALSE(nodes[0].cpus.empty());
+  ASSERT_EQ(nodes[0].cpus, nodes[1].cpus);
+}
+
+TEST(numa, GetNumaNodes_not_exist) {
+  std::vector<NumaNode> nodes;
+  GetNumaNodes(nodes, "testoutput/does_not_exist");
+
+  ASSERT_TRUE(nodes.empty());
+}
+
+TEST(numa, thread_pool) {
+  ThreadPool pool(2, true);
+  ASSERT_LE(1UL, pool.getNodeSize());
+
+  std::atomic<std::size_t> count(0);
+  std::atomic<bool> valid_node(true);
+
+  WaitGroup wg;
+  for (int i = 0; i < 100; ++i)
+    pool.submit(
+        [&pool, &count, &valid_node]() {
+          if (ThreadPool::getCurrentNode() >= pool.getNodeSize())
+            valid_node = false;
+          count++;
+        },
+        wg);
+  wg.wait();
+
+  ASSERT_EQ(100UL, count.load());
+  ASSERT_TRUE(valid_node.load());
+}
+
+}  // namespace pcpe
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "pcpe.h"
+#include "pcpe_util.h"
+#include "small_seq_hash.h"
+
+namespace pcpe {
+
+TEST(pcpe, FindMaxComSubseqs_in_memory) {
+  const FilePath temp_folder("testoutput/test_pcpe");
+  const FilePath ofilepath("testoutput/test_pcpe.bin");
+  CreateFolder(temp_folder.c_str());
+
+  FilePath saved_temp = gEnv.getTempFolderPath();
+  uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+  uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  uint64_t saved_memory_limit = gEnv.getMemoryLimit();
+  gEnv.setTempFolderPath(temp_folder);
+  gEnv.setCompareSeqenceSize(2);
+  gEnv.setMinimumOutputLength(6);
+
+  FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                    ofilepath);
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+  std::sort(ans.begin(), ans.end());
+  ASSERT_FALSE(ans.empty());
+
+  SeqList xs;
+  SeqList ys;
+  ReadSequences("testdata/test_seq1.txt", xs);
+  ReadSequences("testdata/test_seq2.txt", ys);
+
+  std::vector<ComSubseq> seqs;
+  ASSERT_TRUE(FindMaxComSubseqs(
+      xs, ys, [&seqs](const ComSubseq& seq) { seqs.push_back(seq); }));
+
+  // The results are ordered by x.
+  ASSERT_TRUE(std::is_sorted(seqs.begin(), seqs.end()));
+  ASSERT_EQ(ans, seqs);
+
+  // The hash table exceeds the memory limit, so the temp files are used.
+  gEnv.setMemoryLimit(1);
+  seqs.clear();
+  ASSERT_TRUE(FindMaxComSubseqs(
+      xs, ys, [&seqs](const ComSubseq& seq) { seqs.push_back(seq); }));
+  std::sort(seqs.begin(), seqs.end());
+  ASSERT_EQ(ans, seqs);
+
+  gEnv.setTempFolderPath(saved_temp);
+  gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+  gEnv.setMinimumOutputLength(saved_output_length);
+  gEnv.setMemoryLimit(saved_memory_limit);
+}
+
+}  // namespace pcpe
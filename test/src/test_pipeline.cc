@@ -0,0 +1,476 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "manifest.h"
+#include "memory_budget.h"
+#include "pcpe_util.h"
+#include "pipeline.h"
+#include "temp_folder.h"
+
+namespace pcpe {
+
+static void ReadComSubseqFiles(const std::vector<FilePath>& filepaths,
+                               std::vector<ComSubseq>& seqs) {
+  for (const auto& filepath : filepaths) {
+    std::vector<ComSubseq> read_seqs;
+    ReadComSubseqFile(filepath, read_seqs);
+    seqs.insert(seqs.end(), read_seqs.begin(), read_seqs.end());
+  }
+  std::sort(seqs.begin(), seqs.end());
+}
+
+static void CheckFindMaxComSubseqs(uint32_t compare_seq_size,
+                                   uint32_t buffer_size) {
+  std::vector<FilePath> ofilepaths;
+  {
+    FilePath saved_temp = gEnv.getTempFolderPath();
+    uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+    uint32_t saved_buffer_size = gEnv.getBufferSize();
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setTempFolderPath("testoutput");
+    gEnv.setCompareSeqenceSize(compare_seq_size);
+    gEnv.setBufferSize(buffer_size);
+    gEnv.setMinimumOutputLength(6);
+
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp);
+    gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+    gEnv.setBufferSize(saved_buffer_size);
+    gEnv.setMinimumOutputLength(saved_output_length);
+  }
+
+  std::vector<ComSubseq> ans{
+      ComSubseq(0, 0, 1, 0, 6), ComSubseq(1, 0, 1, 0, 6),
+      ComSubseq(1, 1, 2, 0, 6), ComSubseq(2, 0, 1, 0, 6),
+      ComSubseq(2, 1, 2, 0, 7),
+  };
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFiles(ofilepaths, seqs);
+
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) {
+    ASSERT_EQ(ans[i], seqs[i]);
+    ASSERT_EQ(ans[i].getLength(), seqs[i].getLength());
+  }
+}
+
+TEST(pipeline, FindMaxComSubseqs) {
+  CheckFindMaxComSubseqs(gEnv.getCompareSeqenceSize(), gEnv.getBufferSize());
+}
+
+TEST(pipeline, FindMaxComSubseqs_multiple_chunks) {
+  CheckFindMaxComSubseqs(1, gEnv.getBufferSize());
+}
+
+TEST(pipeline, FindMaxComSubseqs_temp_folders) {
+  const std::vector<TempFolder> folders = {
+      TempFolder("testoutput/test_pipeline_temp_a", 1),
+      TempFolder("testoutput/test_pipeline_temp_b", 1)};
+  for (const auto& folder : folders) CreateFolder(folder.path.c_str());
+
+  std::vector<FilePath> ofilepaths;
+  {
+    std::vector<TempFolder> saved_folders = gEnv.getTempFolders();
+    uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+    uint32_t saved_buffer_size = gEnv.getBufferSize();
+    uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setTempFolders(folders);
+    gEnv.setCompareSeqenceSize(1);
+    gEnv.setBufferSize(static_cast<uint32_t>(2 * sizeof(ComSubseq)));
+    gEnv.setMinimumOutputLength(6);
+
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepaths);
+
+    gEnv.setTempFolders(saved_folders);
+    gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+    gEnv.setBufferSize(saved_buffer_size);
+    gEnv.setMinimumOutputLength(saved_output_length);
+  }
+
+  // The outputs are placed on both folders.
+  std::size_t folder_a_size = 0;
+  for (const auto& filepath : ofilepaths)
+    if (filepath.compare(0, folders[0].path.size(), folders[0].path) == 0)
+      folder_a_size++;
+  ASSERT_LT(0UL, folder_a_size);
+  ASSERT_GT(ofilepaths.size(), folder_a_size);
+
+  std::vector<ComSubseq> ans{
+      ComSubseq(0, 0, 1, 0, 6), ComSubseq(1, 0, 1, 0, 6),
+      ComSubseq(1, 1, 2, 0, 6), ComSubseq(2, 0, 1, 0, 6),
+      ComSubseq(2, 1, 2, 0, 7),
+  };
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFiles(ofilepaths, seqs);
+  ASSERT_EQ(ans, seqs);
+}
+
+TEST(pipeline, FindMaxComSubseqs_spill) {
+  CheckFindMaxComSubseqs(gEnv.getCompareSeqenceSize(), sizeof(ComSubseq) * 2);
+}
+
+TEST(pipeline, FindMaxComSubseqs_memory_limit) {
+  // The memory limit is smaller than the buffers of the tasks so the buffers
+  // are shrunk and the tasks are throttled.
+  MemoryBudget& budget = GetMemoryBudget();
+  uint64_t saved_limit = budget.getLimit();
+  budget.setLimit(256 * 1024);
+
+  CheckFindMaxComSubseqs(1, 1024 * 1024);
+
+  ASSERT_EQ(0UL, budget.getUsedSize());
+  budget.setLimit(saved_limit);
+}
+
+TEST(pipeline, FindMaxComSubseqs_result_file) {
+  const FilePath ofilepath("testoutput/test_pipeline_result.bin");
+  std::vector<FilePath> ofilepaths;
+  {
+    FilePath saved_temp = gEnv.getTempFolderPath();
+    uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setTempFolderPath("testoutput");
+    gEnv.setCompareSeqenceSize(1);
+    gEnv.setMinimumOutputLength(6);
+
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepath);
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp);
+    gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+    gEnv.setMinimumOutputLength(saved_output_length);
+  }
+
+  // The result file is the concatenation of the outputs of the pairs.
+  std::vector<ComSubseq> ans;
+  for (const auto& filepath : ofilepaths) {
+    std::vector<ComSubseq> read_seqs;
+    ReadComSubseqFile(filepath, read_seqs);
+    ans.insert(ans.end(), read_seqs.begin(), read_seqs.end());
+  }
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+
+  ASSERT_EQ(5UL, seqs.size());
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) ASSERT_EQ(ans[i], seqs[i]);
+}
+
+TEST(pipeline, FindMaxComSubseqs_sorted_result) {
+  const FilePath ofilepath("testoutput/test_pipeline_sorted_result.bin");
+  std::vector<FilePath> ofilepaths;
+  {
+    FilePath saved_temp = gEnv.getTempFolderPath();
+    uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+    std::size_t saved_output_length = gEnv.getMinimumOutputLength();
+    gEnv.setTempFolderPath("testoutput");
+    gEnv.setCompareSeqenceSize(1);
+    gEnv.setMinimumOutputLength(6);
+
+    gEnv.setSortResult(true);
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepath);
+    gEnv.setSortResult(false);
+
+    FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                      ofilepaths);
+
+    gEnv.setTempFolderPath(saved_temp);
+    gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+    gEnv.setMinimumOutputLength(saved_output_length);
+  }
+
+  // The result file is the sorted outputs of the pairs.
+  std::vector<ComSubseq> ans;
+  for (const auto& filepath : ofilepaths) {
+    std::vector<ComSubseq> read_seqs;
+    ReadComSubseqFile(filepath, read_seqs);
+    ans.insert(ans.end(), read_seqs.begin(), read_seqs.end());
+  }
+  std::sort(ans.begin(), ans.end(), ComSubseqLess(gEnv.getComSubseqOrder()));
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+
+  ASSERT_EQ(5UL, seqs.size());
+  ASSERT_EQ(ans.size(), seqs.size());
+  for (std::size_t i = 0; i < ans.size(); ++i) ASSERT_EQ(ans[i], seqs[i]);
+}
+
+static bool RunFindMaxComSubseqs(const FilePath& temp_folder, bool resume,
+                                 const FilePath& ofilepath) {
+  FilePath saved_temp = gEnv.getTempFolderPath();
+  uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+  uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  bool saved_resume = gEnv.getResume();
+  gEnv.setTempFolderPath(temp_folder);
+  gEnv.setCompareSeqenceSize(1);
+  gEnv.setMinimumOutputLength(6);
+  gEnv.setResume(resume);
+
+  const bool found = FindMaxComSubseqs("testdata/test_seq1.txt",
+                                       "testdata/test_seq2.txt", ofilepath);
+
+  gEnv.setTempFolderPath(saved_temp);
+  gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+  gEnv.setMinimumOutputLength(saved_output_length);
+  gEnv.setResume(saved_resume);
+
+  return found;
+}
+
+/// Count the entries of each state of the manifest file.
+static void CountManifestEntries(const FilePath& filepath,
+                                 std::size_t& done_size,
+                                 std::size_t& consumed_size) {
+  done_size = 0;
+  consumed_size = 0;
+
+  std::ifstream infile(filepath.c_str());
+  std::string line;
+  while (std::getline(infile, line)) {
+    if (line.compare(0, 2, "D ") == 0) done_size++;
+    if (line.compare(0, 2, "C ") == 0) consumed_size++;
+  }
+}
+
+TEST(pipeline, FindMaxComSubseqs_resume) {
+  const FilePath temp_folder("testoutput/test_pipeline_resume");
+  const FilePath ofilepath("testoutput/test_pipeline_resume.bin");
+  CreateFolder(temp_folder.c_str());
+
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+  ASSERT_EQ(5UL, ans.size());
+
+  // The intermediate files are deleted. Only the result file is done.
+  ASSERT_FALSE(CheckFileExists((temp_folder + "/hash_table_x_0").c_str()));
+  ASSERT_FALSE(CheckFileExists((temp_folder + "/max_comsubseq_0").c_str()));
+
+  std::size_t done_size = 0;
+  std::size_t consumed_size = 0;
+  CountManifestEntries(temp_folder + "/manifest", done_size, consumed_size);
+  ASSERT_EQ(1UL, done_size);
+  ASSERT_LT(0UL, consumed_size);
+
+  // The data appended after the last record is dropped.
+  std::ofstream(ofilepath.c_str(), std::ofstream::app) << "partial";
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, true, ofilepath));
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans, seqs);
+
+  // The result file is not the same as the record. All pairs are computed
+  // again.
+  std::ofstream(ofilepath.c_str(), std::ofstream::trunc).close();
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, true, ofilepath));
+
+  seqs.clear();
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans, seqs);
+}
+
+TEST(pipeline, FindMaxComSubseqs_failed_task) {
+  const FilePath temp_folder("testoutput/test_pipeline_failed");
+  const FilePath ofilepath("testoutput/test_pipeline_failed.bin");
+  const FilePath hash_filepath(temp_folder + "/hash_table_x_1");
+  CreateFolder(temp_folder.c_str());
+  std::remove((temp_folder + "/manifest").c_str());
+
+  // The hash table can not be written since its path is a folder.
+  CreateFolder(hash_filepath.c_str());
+  ASSERT_FALSE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+
+  // The failed task is not recorded, and the outputs after it are not
+  // appended.
+  std::ifstream infile((temp_folder + "/manifest").c_str());
+  std::string line;
+  while (std::getline(infile, line))
+    if (line.compare(0, 2, "D ") == 0)
+      ASSERT_EQ(std::string::npos, line.find(hash_filepath));
+  infile.close();
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_GT(5UL, seqs.size());
+
+  // The failed task runs again when the run is resumed.
+  rmdir(hash_filepath.c_str());
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, true, ofilepath));
+
+  seqs.clear();
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(5UL, seqs.size());
+}
+
+TEST(pipeline, FindMaxComSubseqs_shards) {
+  const FilePath temp_folder("testoutput/test_pipeline_shard");
+  const FilePath ofilepath("testoutput/test_pipeline_shard.bin");
+  const uint32_t kShardSize = 4;
+  CreateFolder(temp_folder.c_str());
+
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+
+  for (uint32_t i = 0; i < kShardSize; ++i)
+    std::remove(GetShardFilePath(ofilepath, i, kShardSize).c_str());
+
+  // Run each shard with its own temp folder.
+  for (uint32_t i = 0; i < kShardSize; ++i) {
+    ASSERT_FALSE(MergeShardFiles(ofilepath, kShardSize));
+
+    const FilePath shard_temp_folder =
+        temp_folder + "/" + GetShardName(i, kShardSize);
+    CreateFolder(shard_temp_folder.c_str());
+
+    gEnv.setShard(i, kShardSize);
+    ASSERT_TRUE(RunFindMaxComSubseqs(shard_temp_folder, false, ofilepath));
+    gEnv.setShard(0, 1);
+
+    ASSERT_TRUE(
+        CheckFileExists(GetShardFilePath(ofilepath, i, kShardSize).c_str()));
+  }
+
+  // The merged result is the same as the result without shards.
+  std::remove(ofilepath.c_str());
+  ASSERT_TRUE(MergeShardFiles(ofilepath, kShardSize));
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans, seqs);
+}
+
+TEST(pipeline, FindMaxComSubseqs_temp_budget) {
+  const FilePath temp_folder("testoutput/test_pipeline_temp_budget");
+  const FilePath ofilepath("testoutput/test_pipeline_temp_budget.bin");
+  CreateFolder(temp_folder.c_str());
+
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+
+  // No hash table fits the budget, so they are built one at a time.
+  uint64_t saved_temp_budget = gEnv.getTempBudget();
+  gEnv.setTempBudget(1);
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+  gEnv.setTempBudget(saved_temp_budget);
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  ASSERT_EQ(ans, seqs);
+}
+
+static void ReadBinaryFile(const FilePath& filepath, std::vector<char>& data) {
+  std::ifstream infile(filepath.c_str(),
+                       std::ifstream::in | std::ifstream::binary);
+  data.assign(std::istreambuf_iterator<char>(infile),
+              std::istreambuf_iterator<char>());
+}
+
+TEST(pipeline, FindMaxComSubseqs_incremental) {
+  const FilePath temp_folder("testoutput/test_pipeline_incremental");
+  const FilePath ofilepath("testoutput/test_pipeline_incremental.bin");
+  const FilePath xfilepath("testoutput/test_pipeline_incremental_x.txt");
+  const FilePath yfilepath("testoutput/test_pipeline_incremental_y.txt");
+  CreateFolder(temp_folder.c_str());
+
+  ASSERT_TRUE(RunFindMaxComSubseqs(temp_folder, false, ofilepath));
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+  std::sort(ans.begin(), ans.end());
+
+  FilePath saved_temp = gEnv.getTempFolderPath();
+  uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+  uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  bool saved_incremental = gEnv.getIncremental();
+  gEnv.setTempFolderPath(temp_folder);
+  gEnv.setCompareSeqenceSize(1);
+  gEnv.setMinimumOutputLength(6);
+
+  // The base run has the prefixes of the sequences.
+  {
+    std::ofstream xfile(xfilepath.c_str());
+    xfile << "2\n7 ABCDEFG\n8 ABCDEFGH\n";
+    std::ofstream yfile(yfilepath.c_str());
+    yfile << "1\n6 BCDEFG\n";
+  }
+  gEnv.setIncremental(false);
+  FindMaxComSubseqs(xfilepath, yfilepath, ofilepath);
+
+  std::vector<char> base_result;
+  ReadBinaryFile(ofilepath, base_result);
+  ASSERT_TRUE(CheckFileExists(GetRunIndexFilePath(ofilepath).c_str()));
+
+  // Only the pairs with the appended sequences are computed and appended.
+  gEnv.setIncremental(true);
+  FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                    ofilepath);
+
+  std::vector<char> result;
+  ReadBinaryFile(ofilepath, result);
+  ASSERT_LT(base_result.size(), result.size());
+  ASSERT_TRUE(std::equal(base_result.begin(), base_result.end(),
+                         result.begin()));
+
+  std::vector<ComSubseq> seqs;
+  ReadComSubseqFile(ofilepath, seqs);
+  std::sort(seqs.begin(), seqs.end());
+  ASSERT_EQ(ans, seqs);
+
+  // Nothing is appended without new sequences.
+  FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                    ofilepath);
+  std::vector<char> same_result;
+  ReadBinaryFile(ofilepath, same_result);
+  ASSERT_EQ(result, same_result);
+
+  // The base sequences are changed, so all pairs are computed.
+  {
+    std::ofstream xfile(xfilepath.c_str());
+    xfile << "3\n7 ABCDEFG\n8 ABCDEFGX\n9 ABCDEFGHI\n";
+  }
+  FindMaxComSubseqs(xfilepath, "testdata/test_seq2.txt", ofilepath);
+  seqs.clear();
+  ReadComSubseqFile(ofilepath, seqs);
+  std::sort(seqs.begin(), seqs.end());
+  ASSERT_NE(ans, seqs);
+
+  FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                    ofilepath);
+  seqs.clear();
+  ReadComSubseqFile(ofilepath, seqs);
+  std::sort(seqs.begin(), seqs.end());
+  ASSERT_EQ(ans, seqs);
+
+  gEnv.setTempFolderPath(saved_temp);
+  gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+  gEnv.setMinimumOutputLength(saved_output_length);
+  gEnv.setIncremental(saved_incremental);
+}
+
+}  // namespace pcpe
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "pcpe_util.h"
+#include "pipeline.h"
+#include "query.h"
+#include "small_seq_hash.h"
+
+namespace pcpe {
+
+TEST(query, query) {
+  const FilePath temp_folder("testoutput/test_query");
+  const FilePath ofilepath("testoutput/test_query_pipeline.bin");
+  CreateFolder(temp_folder.c_str());
+
+  FilePath saved_temp = gEnv.getTempFolderPath();
+  uint32_t saved_compare_seq_size = gEnv.getCompareSeqenceSize();
+  uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  gEnv.setTempFolderPath(temp_folder);
+  gEnv.setCompareSeqenceSize(1);
+  gEnv.setMinimumOutputLength(6);
+  FindMaxComSubseqs("testdata/test_seq1.txt", "testdata/test_seq2.txt",
+                    ofilepath);
+  gEnv.setTempFolderPath(saved_temp);
+  gEnv.setCompareSeqenceSize(saved_compare_seq_size);
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(ofilepath, ans);
+  std::sort(ans.begin(), ans.end());
+  ASSERT_FALSE(ans.empty());
+  std::remove(ofilepath.c_str());
+
+  QueryIndex index;
+  ASSERT_TRUE(index.load("testdata/test_seq2.txt"));
+  ASSERT_EQ(2UL, index.getSequences().size());
+  ASSERT_EQ(3UL, index.getSmallSeqSize());
+
+  SeqList queries;
+  ReadSequences("testdata/test_seq1.txt", queries);
+
+  std::vector<QueryResult> results;
+  index.query(queries, results);
+  ASSERT_EQ(queries.size(), results.size());
+
+  // The results of the queries are the same as the pipeline.
+  std::vector<ComSubseq> seqs;
+  for (const auto& result : results)
+    seqs.insert(seqs.end(), result.seqs.begin(), result.seqs.end());
+  std::sort(seqs.begin(), seqs.end());
+  ASSERT_EQ(ans, seqs);
+
+  // The x of the results is the given index of the query.
+  std::vector<ComSubseq> query_seqs;
+  index.query(queries[2], 2, query_seqs);
+  ASSERT_EQ(results[2].seqs, query_seqs);
+  ASSERT_FALSE(query_seqs.empty());
+
+  // A query shorter than a small seqence has no result.
+  std::vector<ComSubseq> short_seqs;
+  index.query("ABC", 0, short_seqs);
+  ASSERT_TRUE(short_seqs.empty());
+
+  ASSERT_FALSE(index.load("testdata/does_not_exist"));
+
+  gEnv.setMinimumOutputLength(saved_output_length);
+}
+
+}  // namespace pcpe
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "env.h"
+#include "pcpe_util.h"
+#include "query.h"
+#include "query_server.h"
+#include "small_seq_hash.h"
+
+namespace pcpe {
+
+static void AppendUint32(std::string& message, uint32_t value) {
+  message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * Send a raw request to the server and check the server closes the
+ * connection without a response.
+ *
+ * @param[in] shutdown_write close the writing side after the request, i.e.
+ *                           the request is truncated
+ * */
+static bool IsRequestRejected(const FilePath& socket_path,
+                              const std::string& request,
+                              bool shutdown_write) {
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, socket_path.c_str(),
+               sizeof(address.sun_path) - 1);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  if (connect(fd, reinterpret_cast<struct sockaddr*>(&address),
+              sizeof(address)) != 0) {
+    close(fd);
+    return false;
+  }
+
+  // Do not wait forever if the server keeps the connection.
+  struct timeval timeout;
+  timeout.tv_sec = 5;
+  timeout.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  const bool sent =
+      write(fd, request.data(), request.size()) ==
+      static_cast<ssize_t>(request.size());
+  if (shutdown_write) shutdown(fd, SHUT_WR);
+
+  // The connection is reset if the server closes it before reading all data.
+  char c = 0;
+  const ssize_t read_size = read(fd, &c, 1);
+  const bool closed =
+      sent && (read_size == 0 || (read_size < 0 && errno == ECONNRESET));
+  close(fd);
+  return closed;
+}
+
+TEST(query_server, SendQueries) {
+  const FilePath socket_path("testoutput/test_query_server.sock");
+  const std::size_t kClientSize = 8;
+
+  uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  gEnv.setMinimumOutputLength(6);
+
+  std::unique_ptr<QueryIndex> index(new QueryIndex());
+  ASSERT_TRUE(index->load("testdata/test_seq2.txt"));
+
+  SeqList queries;
+  ReadSequences("testdata/test_seq1.txt", queries);
+
+  std::vector<QueryResult> ans;
+  index->query(queries, ans);
+
+  // Wait for all clients so the concurrent requests are queried in the same
+  // batch.
+  QueryServer server(socket_path);
+  server.addIndex(std::move(index));
+  server.setBatchWindow(10000000, kClientSize);
+  ASSERT_TRUE(server.start());
+
+  std::vector<std::vector<QueryResult>> results(kClientSize);
+  std::vector<char> sent(kClientSize, false);
+  std::vector<std::thread> clients;
+  for (std::size_t i = 0; i < kClientSize; ++i)
+    clients.emplace_back([&, i]() {
+      sent[i] = SendQueries(socket_path, 0, queries, results[i]);
+    });
+  for (auto& client : clients) client.join();
+
+  for (std::size_t i = 0; i < kClientSize; ++i) {
+    ASSERT_TRUE(sent[i]);
+    ASSERT_EQ(ans.size(), results[i].size());
+    for (std::size_t q = 0; q < ans.size(); ++q)
+      ASSERT_EQ(ans[q].seqs, results[i][q].seqs);
+  }
+  ASSERT_LT(1UL, server.getMaxBatchRequestSize());
+  ASSERT_GT(kClientSize, server.getBatchSize());
+
+  // The index does not exist.
+  std::vector<QueryResult> invalid_results;
+  ASSERT_FALSE(SendQueries(socket_path, 1, queries, invalid_results));
+  ASSERT_TRUE(invalid_results.empty());
+
+  server.stop();
+  ASSERT_FALSE(CheckFileExists(socket_path.c_str()));
+  ASSERT_FALSE(SendQueries(socket_path, 0, queries, invalid_results));
+
+  gEnv.setMinimumOutputLength(saved_output_length);
+}
+
+TEST(query_server, MalformedRequests) {
+  const FilePath socket_path("testoutput/test_query_server_malformed.sock");
+
+  std::unique_ptr<QueryIndex> index(new QueryIndex());
+  ASSERT_TRUE(index->load("testdata/test_seq2.txt"));
+
+  SeqList queries;
+  ReadSequences("testdata/test_seq1.txt", queries);
+
+  QueryServer server(socket_path);
+  server.addIndex(std::move(index));
+  ASSERT_TRUE(server.start());
+
+  std::vector<QueryResult> results;
+  ASSERT_TRUE(SendQueries(socket_path, 0, queries, results));
+  const std::size_t results_size = results.size();
+
+  std::string header;
+  AppendUint32(header, kQueryRequestMagic);
+  AppendUint32(header, 0);
+
+  // The magic number is wrong.
+  {
+    std::string request;
+    AppendUint32(request, kQueryRequestMagic + 1);
+    AppendUint32(request, 0);
+    AppendUint32(request, 0);
+    ASSERT_TRUE(IsRequestRejected(socket_path, request, false));
+  }
+
+  // The request ends in the middle of a query.
+  {
+    std::string request = header;
+    AppendUint32(request, 1);
+    AppendUint32(request, 10);
+    request += "ABCDE";
+    ASSERT_TRUE(IsRequestRejected(socket_path, request, true));
+  }
+
+  // Too many queries.
+  {
+    std::string request = header;
+    AppendUint32(request, kMaxRequestQuerySize + 1);
+    ASSERT_TRUE(IsRequestRejected(socket_path, request, false));
+  }
+
+  // A too long query.
+  {
+    std::string request = header;
+    AppendUint32(request, 1);
+    AppendUint32(request, kMaxQueryLength + 1);
+    ASSERT_TRUE(IsRequestRejected(socket_path, request, false));
+  }
+
+  // The server keeps serving after the malformed requests.
+  ASSERT_TRUE(SendQueries(socket_path, 0, queries, results));
+  ASSERT_EQ(results_size, results.size());
+
+  server.stop();
+}
+
+}  // namespace pcpe
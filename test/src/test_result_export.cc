@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "com_subseq.h"
+#include "pcpe_util.h"
+#include "result_export.h"
+
+namespace pcpe {
+
+static std::string ReadTextFile(const FilePath& filepath) {
+  std::ifstream infile(filepath.c_str());
+  std::ostringstream oss;
+  oss << infile.rdbuf();
+  return oss.str();
+}
+
+TEST(result_export, ExportComSubseqFile) {
+  const FilePath ifilepath("testoutput/test_result_export.bin");
+  const FilePath ofilepath("testoutput/test_result_export.tsv");
+
+  // Enough ComSubseqs for several rounds of the parallel formatting.
+  std::vector<ComSubseq> seqs;
+  std::ostringstream ans;
+  ans << "x\ty\tx_loc\ty_loc\tlength\n";
+  for (uint32_t i = 0; i < 20000; ++i) {
+    const uint32_t x_loc = (i % 7 == 0) ? UINT32_MAX : i * 31;
+    seqs.emplace_back(i / 100, i % 100, x_loc, i, 10 + i % 5);
+    ans << i / 100 << '\t' << i % 100 << '\t' << x_loc << '\t' << i << '\t'
+        << 10 + i % 5 << '\n';
+  }
+  WriteComSubseqFile(seqs, ifilepath);
+
+  ASSERT_TRUE(ExportComSubseqFile(ifilepath, {}, {}, ofilepath));
+  EXPECT_EQ(ans.str(), ReadTextFile(ofilepath));
+
+  // An empty result has the header only.
+  WriteComSubseqFile(std::vector<ComSubseq>(), ifilepath);
+  ASSERT_TRUE(ExportComSubseqFile(ifilepath, {}, {}, ofilepath));
+  EXPECT_EQ("x\ty\tx_loc\ty_loc\tlength\n", ReadTextFile(ofilepath));
+
+  std::remove(ifilepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
+TEST(result_export, ExportComSubseqFile_ids) {
+  const FilePath x_id_filepath("testoutput/test_result_export_x_id.txt");
+  const FilePath y_id_filepath("testoutput/test_result_export_y_id.txt");
+  const FilePath ifilepath("testoutput/test_result_export_ids.bin");
+  const FilePath ofilepath("testoutput/test_result_export_ids.tsv");
+
+  std::ofstream(x_id_filepath.c_str()) << "2\n1 sp|P1\n2 sp|P2 sp|P3\n";
+  std::ofstream(y_id_filepath.c_str()) << "1\n1 tr|Q1\n";
+
+  std::vector<std::string> x_ids;
+  std::vector<std::string> y_ids;
+  ASSERT_TRUE(ReadSequenceIds(x_id_filepath, x_ids));
+  ASSERT_TRUE(ReadSequenceIds(y_id_filepath, y_ids));
+  EXPECT_EQ(std::vector<std::string>({"sp|P1", "sp|P2,sp|P3"}), x_ids);
+  EXPECT_EQ(std::vector<std::string>({"tr|Q1"}), y_ids);
+
+  std::vector<ComSubseq> seqs;
+  seqs.emplace_back(0, 0, 1, 2, 10);
+  seqs.emplace_back(1, 0, 3, 4, 12);
+  WriteComSubseqFile(seqs, ifilepath);
+
+  ASSERT_TRUE(ExportComSubseqFile(ifilepath, x_ids, y_ids, ofilepath));
+  EXPECT_EQ(
+      "x\ty\tx_loc\ty_loc\tlength\n"
+      "sp|P1\ttr|Q1\t1\t2\t10\n"
+      "sp|P2,sp|P3\ttr|Q1\t3\t4\t12\n",
+      ReadTextFile(ofilepath));
+
+  // The y index 1 is out of the range of the ids.
+  seqs.emplace_back(0, 1, 5, 6, 10);
+  WriteComSubseqFile(seqs, ifilepath);
+  EXPECT_FALSE(ExportComSubseqFile(ifilepath, x_ids, y_ids, ofilepath));
+
+  // The id file has less sequences than its count.
+  std::ofstream(y_id_filepath.c_str()) << "2\n1 tr|Q1\n";
+  EXPECT_FALSE(ReadSequenceIds(y_id_filepath, y_ids));
+  EXPECT_FALSE(ReadSequenceIds("testoutput/not_exist_id.txt", y_ids));
+
+  std::remove(x_id_filepath.c_str());
+  std::remove(y_id_filepath.c_str());
+  std::remove(ifilepath.c_str());
+  std::remove(ofilepath.c_str());
+}
+
+}  // namespace pcpe
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "com_subseq.h"
+#include "pcpe_util.h"
+#include "result_lookup.h"
+
+namespace pcpe {
+
+TEST(result_lookup, LookupComSubseqs) {
+  const FilePath filepath("testoutput/test_result_lookup.bin");
+
+  // An unordered concatenation of the pairs. No ComSubseq of x = 1.
+  std::vector<ComSubseq> seqs{
+      ComSubseq(2, 1, 0, 0, 10), ComSubseq(0, 3, 1, 2, 11),
+      ComSubseq(4, 0, 2, 3, 12), ComSubseq(0, 1, 5, 5, 10),
+      ComSubseq(2, 0, 3, 7, 13), ComSubseq(0, 3, 8, 2, 10),
+      ComSubseq(2, 1, 9, 1, 14),
+  };
+  WriteComSubseqFile(seqs, filepath);
+
+  // The lookup needs the index.
+  std::vector<ComSubseq> result;
+  std::remove(GetLookupIndexFilePath(filepath).c_str());
+  EXPECT_FALSE(LookupComSubseqs(filepath, 0, result));
+
+  ASSERT_TRUE(BuildLookupIndex(filepath));
+
+  // The file is sorted in place.
+  std::vector<ComSubseq> sorted;
+  ReadComSubseqFile(filepath, sorted);
+  std::sort(seqs.begin(), seqs.end());
+  EXPECT_EQ(seqs, sorted);
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 0, result));
+  EXPECT_EQ(std::vector<ComSubseq>(seqs.begin(), seqs.begin() + 3), result);
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 1, result));
+  EXPECT_TRUE(result.empty());
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 2, result));
+  EXPECT_EQ(std::vector<ComSubseq>(seqs.begin() + 3, seqs.begin() + 6),
+            result);
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 4, result));
+  ASSERT_EQ(1UL, result.size());
+  EXPECT_EQ(ComSubseq(4, 0, 2, 3, 12), result[0]);
+  EXPECT_EQ(12U, result[0].getLength());
+
+  // The x is larger than the maximum x.
+  ASSERT_TRUE(LookupComSubseqs(filepath, 100, result));
+  EXPECT_TRUE(result.empty());
+
+  // The sequence pairs.
+  ASSERT_TRUE(LookupComSubseqs(filepath, 0, 3, result));
+  EXPECT_EQ(std::vector<ComSubseq>(seqs.begin() + 1, seqs.begin() + 3),
+            result);
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 2, 1, result));
+  EXPECT_EQ(std::vector<ComSubseq>(seqs.begin() + 4, seqs.begin() + 6),
+            result);
+
+  ASSERT_TRUE(LookupComSubseqs(filepath, 2, 2, result));
+  EXPECT_TRUE(result.empty());
+
+  // The result is changed after the index is built.
+  seqs.push_back(ComSubseq(5, 0, 0, 0, 10));
+  WriteComSubseqFile(seqs, filepath);
+  EXPECT_FALSE(LookupComSubseqs(filepath, 0, result));
+
+  std::remove(filepath.c_str());
+  std::remove(GetLookupIndexFilePath(filepath).c_str());
+}
+
+}  // namespace pcpe
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "com_subseq.h"
+#include "env.h"
+#include "pcpe_util.h"
+#include "pipeline.h"
+#include "run_context.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+TEST(run_context, GetEnv) {
+  ASSERT_EQ(&gEnv, &GetEnv());
+  ASSERT_EQ(nullptr, GetCurrentRunContext());
+
+  RunContext context("test_run_context");
+  context.getEnv().setMinimumOutputLength(gEnv.getMinimumOutputLength() + 1);
+  ASSERT_EQ(gEnv.getTempFolderPath() + "/test_run_context",
+            context.getEnv().getTempFolderPath());
+  {
+    ScopedRunContext scope(context);
+    ASSERT_EQ(&context, GetCurrentRunContext());
+    ASSERT_EQ(&context.getEnv(), &GetEnv());
+    ASSERT_NE(gEnv.getMinimumOutputLength(), GetEnv().getMinimumOutputLength());
+
+    // The tasks run in the context of the submitter.
+    WaitGroup wg;
+    const Env* task_env = nullptr;
+    GetRunContext().getThreadPool().submit(
+        [&task_env]() { task_env = &GetEnv(); }, wg);
+    wg.wait();
+    ASSERT_EQ(&context.getEnv(), task_env);
+  }
+  ASSERT_EQ(&gEnv, &GetEnv());
+
+  ASSERT_NE(context.getNextTempIndex(), context.getNextTempIndex());
+}
+
+TEST(run_context, concurrent_runs) {
+  const FilePath temp_folder("testoutput/test_run_context");
+  const std::size_t kRunSize = 4;
+  CreateFolder(temp_folder.c_str());
+
+  Env env;
+  env.setTempFolderPath(temp_folder);
+  env.setCompareSeqenceSize(1);
+  env.setMinimumOutputLength(6);
+
+  RunContext base_context("", env);
+  const FilePath base_filepath("testoutput/test_run_context_base.bin");
+  FindMaxComSubseqs(base_context, "testdata/test_seq1.txt",
+                    "testdata/test_seq2.txt", base_filepath);
+  ASSERT_NE(0UL, base_context.getStats().task_size.load());
+
+  std::vector<ComSubseq> ans;
+  ReadComSubseqFile(base_filepath, ans);
+  std::sort(ans.begin(), ans.end());
+  ASSERT_FALSE(ans.empty());
+
+  // The runs share the temp folder and the thread pool.
+  ThreadPool pool(2);
+  std::vector<std::unique_ptr<RunContext>> contexts;
+  std::vector<FilePath> ofilepaths;
+  for (std::size_t i = 0; i < kRunSize; ++i) {
+    const std::string name = "run_" + std::to_string(i);
+    contexts.emplace_back(new RunContext(name, env, &pool));
+    ofilepaths.push_back("testoutput/test_run_context_" + name + ".bin");
+  }
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < kRunSize; ++i)
+    threads.emplace_back([&contexts, &ofilepaths, i]() {
+      FindMaxComSubseqs(*contexts[i], "testdata/test_seq1.txt",
+                        "testdata/test_seq2.txt", ofilepaths[i]);
+    });
+  for (auto& thread : threads) thread.join();
+
+  for (std::size_t i = 0; i < kRunSize; ++i) {
+    std::vector<ComSubseq> seqs;
+    ReadComSubseqFile(ofilepaths[i], seqs);
+    std::sort(seqs.begin(), seqs.end());
+    ASSERT_EQ(ans, seqs);
+
+    ASSERT_EQ(base_context.getStats().task_size.load(),
+              contexts[i]->getStats().task_size.load());
+    ASSERT_TRUE(CheckFileExists(
+        (contexts[i]->getEnv().getTempFolderPath() + "/manifest").c_str()));
+  }
+}
+
+}  // namespace pcpe
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <fstream>
+
+#include "env.h"
+#include "manifest.h"
+#include "pcpe_util.h"
+#include "run_index.h"
+
+namespace pcpe {
+
+static void WriteTextFile(const FilePath& filepath, const char* content) {
+  std::ofstream ofile(filepath.c_str(),
+                      std::ofstream::out | std::ofstream::binary);
+  ofile << content;
+}
+
+TEST(run_index, GetSeqListChecksum) {
+  const SeqList seqs = {"ABC", "DE"};
+
+  uint64_t checksum = kEmptyChecksum;
+  UpdateChecksum("ABC\n", 4, checksum);
+  ASSERT_EQ(checksum, GetSeqListChecksum(seqs, 1));
+
+  UpdateChecksum("DE\n", 3, checksum);
+  ASSERT_EQ(checksum, GetSeqListChecksum(seqs, 2));
+  ASSERT_EQ(kEmptyChecksum, GetSeqListChecksum(seqs, 0));
+
+  // The separators keep the boundaries of the sequences.
+  const SeqList other_seqs = {"AB", "CDE"};
+  ASSERT_NE(GetSeqListChecksum(seqs, 2), GetSeqListChecksum(other_seqs, 2));
+}
+
+TEST(run_index, save_and_load) {
+  const FilePath filepath("testoutput/test_run_index");
+
+  RunIndex index;
+  index.settings = GetRunSettings();
+  index.x_size = 3;
+  index.x_checksum = 12345;
+  index.y_size = 2;
+  index.y_checksum = 67890;
+  index.result_size = 40;
+  index.result_checksum = 0xcbf29ce484222325ULL;
+  ASSERT_TRUE(index.save(filepath));
+
+  RunIndex loaded;
+  ASSERT_TRUE(loaded.load(filepath));
+  ASSERT_EQ(index.settings, loaded.settings);
+  ASSERT_EQ(3UL, loaded.x_size);
+  ASSERT_EQ(12345UL, loaded.x_checksum);
+  ASSERT_EQ(2UL, loaded.y_size);
+  ASSERT_EQ(67890UL, loaded.y_checksum);
+  ASSERT_EQ(40UL, loaded.result_size);
+  ASSERT_EQ(0xcbf29ce484222325ULL, loaded.result_checksum);
+
+  ASSERT_FALSE(loaded.load("testoutput/does_not_exist"));
+
+  WriteTextFile(filepath, "pcpe-index 1\n6 20 0\nx 3 1\n");
+  ASSERT_FALSE(loaded.load(filepath));
+}
+
+TEST(run_index, isBaseOf) {
+  const FilePath result_filepath("testoutput/test_run_index_result");
+  WriteTextFile(result_filepath, "result");
+
+  const SeqList xs = {"ABCDEFG", "ABCDEFGH"};
+  const SeqList ys = {"BCDEFG"};
+
+  RunIndex index;
+  index.settings = GetRunSettings();
+  index.x_size = xs.size();
+  index.x_checksum = GetSeqListChecksum(xs, xs.size());
+  index.y_size = ys.size();
+  index.y_checksum = GetSeqListChecksum(ys, ys.size());
+  ASSERT_TRUE(GetFileChecksum(result_filepath, index.result_size,
+                              index.result_checksum));
+
+  ASSERT_TRUE(index.isBaseOf(xs, ys, result_filepath));
+
+  // Appended sequences and results.
+  const SeqList grown_xs = {"ABCDEFG", "ABCDEFGH", "ABCDEFGHI"};
+  const SeqList grown_ys = {"BCDEFG", "CDEFGHI"};
+  WriteTextFile(result_filepath, "result and more");
+  ASSERT_TRUE(index.isBaseOf(grown_xs, grown_ys, result_filepath));
+
+  // Changed or removed sequences.
+  const SeqList changed_xs = {"ABCDEFG", "XBCDEFGH", "ABCDEFGHI"};
+  ASSERT_FALSE(index.isBaseOf(changed_xs, grown_ys, result_filepath));
+  ASSERT_FALSE(index.isBaseOf(xs, SeqList(), result_filepath));
+
+  // Changed result.
+  WriteTextFile(result_filepath, "resolt");
+  ASSERT_FALSE(index.isBaseOf(xs, ys, result_filepath));
+  WriteTextFile(result_filepath, "res");
+  ASSERT_FALSE(index.isBaseOf(xs, ys, result_filepath));
+  WriteTextFile(result_filepath, "result");
+
+  // Changed settings.
+  const uint32_t saved_output_length = gEnv.getMinimumOutputLength();
+  gEnv.setMinimumOutputLength(saved_output_length + 1);
+  ASSERT_FALSE(index.isBaseOf(xs, ys, result_filepath));
+  gEnv.setMinimumOutputLength(saved_output_length);
+  ASSERT_TRUE(index.isBaseOf(xs, ys, result_filepath));
+}
+
+}  // namespace pcpe
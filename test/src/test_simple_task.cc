@@ -6,9 +6,13 @@
 #include <algorithm>
 #include <memory>
 #include <cstdint>
+#include <mutex>
+#include <vector>
 
 #include "simple_task.h"
 #include "logging.h"
+#include "run_context.h"
+#include "thread_pool.h"
 
 namespace pcpe {
 
@@ -66,6 +70,53 @@ TEST(simple_task, basic_useage_shared_ptr) {
     ASSERT_EQ(task->task_id, task->result_id);
 }
 
+class CostTask {
+ public:
+  CostTask(uint64_t cost, std::vector<uint64_t>& order)
+      : cost_(cost), order_(order) {}
+
+  void exec() {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    order_.push_back(cost_);
+  }
+
+  uint64_t cost() const { return cost_; }
+
+ private:
+  uint64_t cost_;
+  std::vector<uint64_t>& order_;
+};
+
+TEST(simple_task, task_cost) {
+  std::vector<uint64_t> order;
+  std::unique_ptr<CostTask> cost_task(new CostTask(10, order));
+  std::unique_ptr<AssignIntTask> int_task(new AssignIntTask(1));
+
+  ASSERT_TRUE(HasTaskCost(cost_task, 0));
+  ASSERT_EQ(10UL, GetTaskCost(cost_task, 0));
+
+  ASSERT_FALSE(HasTaskCost(int_task, 0));
+  ASSERT_EQ(0UL, GetTaskCost(int_task, 0));
+}
+
+TEST(simple_task, longest_first) {
+  std::vector<uint64_t> order;
+  std::vector<std::unique_ptr<CostTask>> tasks;
+  const uint64_t costs[] = {3, 9, 1, 7, 5};
+  for (uint64_t cost : costs)
+    tasks.push_back(std::unique_ptr<CostTask>(new CostTask(cost, order)));
+
+  // Only one worker so the order is decided.
+  ThreadPool pool(1);
+  RunContext context("", GetEnv(), &pool);
+  ScopedRunContext scope(context);
+  RunSimpleTasks(tasks);
+
+  std::vector<uint64_t> expected = {9, 7, 5, 3, 1};
+  ASSERT_EQ(expected, order);
+}
+
 TEST(simple_task, GetStepsToNumberRegular_less_than) {
   {
     std::vector<std::size_t> steps;
@@ -341,6 +341,39 @@ TEST(compare_subseq, test_read_smallseqs_2_2) {
   }
 }
 
+TEST(compare_subseq, test_small_seq_size) {
+  SeqList seqs = {"ABCDEFGH", "ABC", "ABCDEF", "BCDEFGHIJ"};
+
+  ASSERT_EQ(8UL, GetSmallSeqSize(seqs, 0, seqs.size()));
+  ASSERT_EQ(1UL, GetSmallSeqSize(seqs, 1, 3));
+  ASSERT_EQ(0UL, GetSmallSeqSize(seqs, 1, 2));
+
+  SmallSeqList small_seqs;
+  ConstructSmallSeqs(seqs, 0, seqs.size(), small_seqs);
+
+  uint64_t entry_size = 0;
+  for (const auto& entry : small_seqs) entry_size += entry.second.size();
+  ASSERT_EQ(entry_size, GetSmallSeqSize(seqs, 0, seqs.size()));
+}
+
+TEST(compare_subseq, EstimateSmallSeqsMemorySize) {
+  SeqList seqs = {"ABCDEFGHABCDEFGH", "ABCDEFGHIJKLMNOPQRSTUVWXYZ", "ABCDEF",
+                  "ZZZZZZZZZZZZZZZZZZZZ"};
+
+  SmallSeqList small_seqs;
+  ConstructSmallSeqs(seqs, 0, seqs.size(), small_seqs);
+
+  // The nodes of the tree and the capacities of the lists.
+  uint64_t table_size = 0;
+  for (const auto& entry : small_seqs)
+    table_size += sizeof(SmallSeqList::value_type) + 3 * sizeof(void*) +
+                  entry.second.capacity() * sizeof(SeqLoc);
+
+  ASSERT_LE(table_size,
+            EstimateSmallSeqsMemorySize(GetSmallSeqSize(seqs, 0, seqs.size())));
+  ASSERT_EQ(0UL, EstimateSmallSeqsMemorySize(0));
+}
+
 TEST(compare_subseq, test_construct_small_seq_hash_files_1) {
   FilePath filepath = "testdata/test_seq1.txt";
 
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "task_graph.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+TEST(task_graph, empty_graph) {
+  TaskGraph graph;
+  graph.run();
+
+  ASSERT_EQ(0UL, graph.size());
+}
+
+TEST(task_graph, dependencies) {
+  // a --> c --> d
+  // b ----^
+  std::mutex mutex;
+  std::vector<char> order;
+  auto record = [&mutex, &order](char c) {
+    usleep(1000);
+    std::lock_guard<std::mutex> lock(mutex);
+    order.push_back(c);
+  };
+
+  TaskGraph graph;
+  TaskGraph::NodeId d = graph.addTask([&record]() { record('d'); });
+  TaskGraph::NodeId c = graph.addTask([&record]() { record('c'); });
+  TaskGraph::NodeId a = graph.addTask([&record]() { record('a'); });
+  TaskGraph::NodeId b = graph.addTask([&record]() { record('b'); });
+
+  graph.addDependency(a, c);
+  graph.addDependency(b, c);
+  graph.addDependency(c, d);
+  graph.run();
+
+  ASSERT_EQ(4UL, order.size());
+  ASSERT_EQ('c', order[2]);
+  ASSERT_EQ('d', order[3]);
+}
+
+TEST(task_graph, start_without_barrier) {
+  // Two independent chains: slow -> slow_next and fast -> fast_next.
+  // fast_next must not wait for the slow task.
+  std::atomic<bool> slow_done(false);
+  std::atomic<bool> fast_next_before_slow(false);
+
+  TaskGraph graph;
+  TaskGraph::NodeId slow = graph.addTask([&slow_done]() {
+    usleep(200000);
+    slow_done = true;
+  });
+  TaskGraph::NodeId slow_next = graph.addTask([]() {});
+  TaskGraph::NodeId fast = graph.addTask([]() {});
+  TaskGraph::NodeId fast_next = graph.addTask(
+      [&]() { fast_next_before_slow = !slow_done.load(); });
+
+  graph.addDependency(slow, slow_next);
+  graph.addDependency(fast, fast_next);
+
+  ThreadPool pool(2);
+  graph.run(pool);
+
+  ASSERT_TRUE(slow_done.load());
+  ASSERT_TRUE(fast_next_before_slow.load());
+}
+
+TEST(task_graph, chain) {
+  std::vector<uint32_t> order;
+
+  TaskGraph graph;
+  for (uint32_t i = 0; i < 50; ++i) {
+    TaskGraph::NodeId node =
+        graph.addTask([&order, i]() { order.push_back(i); });
+    if (i != 0) graph.addDependency(node - 1, node);
+  }
+  graph.run();
+
+  ASSERT_EQ(50UL, order.size());
+  for (uint32_t i = 0; i < order.size(); ++i) ASSERT_EQ(i, order[i]);
+}
+
+TEST(task_graph, longest_first) {
+  // root -> {1, 5, 3, 4, 2}: the ready tasks run in the order of the costs.
+  std::vector<uint64_t> order;
+
+  TaskGraph graph;
+  TaskGraph::NodeId root = graph.addTask([]() { usleep(10000); });
+  const uint64_t costs[] = {1, 5, 3, 4, 2};
+  for (uint64_t cost : costs) {
+    TaskGraph::NodeId node =
+        graph.addTask([&order, cost]() { order.push_back(cost); }, cost);
+    graph.addDependency(root, node);
+  }
+
+  // Only one worker so the order is decided.
+  ThreadPool pool(1);
+  graph.run(pool);
+
+  std::vector<uint64_t> expected = {5, 4, 3, 2, 1};
+  ASSERT_EQ(expected, order);
+}
+
+TEST(task_graph, resource_limit) {
+  // Each producer holds 10 until its consumer releases it. At most two
+  // producers are held at the same time.
+  const uint64_t kResource = 10;
+  std::mutex mutex;
+  uint64_t held = 0;
+  uint64_t max_held = 0;
+  std::atomic<std::size_t> consumed(0);
+
+  TaskGraph graph;
+  graph.setResourceLimit(2 * kResource);
+  for (int i = 0; i < 8; ++i) {
+    TaskGraph::NodeId producer = graph.addTask(
+        [&]() {
+          std::lock_guard<std::mutex> lock(mutex);
+          held += kResource;
+          max_held = std::max(max_held, held);
+        },
+        1, kResource);
+    TaskGraph::NodeId consumer = graph.addTask(
+        [&]() {
+          usleep(1000);
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            held -= kResource;
+          }
+          graph.releaseResource(kResource);
+          consumed++;
+        },
+        2);
+    graph.addDependency(producer, consumer);
+  }
+
+  ThreadPool pool(4);
+  graph.run(pool);
+
+  ASSERT_EQ(8UL, consumed.load());
+  ASSERT_EQ(0UL, held);
+  ASSERT_GE(2 * kResource, max_held);
+  ASSERT_GE(2 * kResource, graph.getResourcePeak());
+}
+
+TEST(task_graph, resource_over_limit) {
+  // A task larger than the limit still runs when nothing else is running.
+  std::atomic<std::size_t> executed(0);
+
+  TaskGraph graph;
+  graph.setResourceLimit(10);
+  graph.addTask([&executed]() { executed++; }, 0, 30);
+  graph.addTask([&executed]() { executed++; }, 0, 5);
+
+  ThreadPool pool(2);
+  graph.run(pool);
+
+  ASSERT_EQ(2UL, executed.load());
+  ASSERT_EQ(35UL, graph.getResourcePeak());
+}
+
+}  // namespace pcpe
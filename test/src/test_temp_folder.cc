@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "env.h"
+#include "pcpe_util.h"
+#include "temp_folder.h"
+
+namespace pcpe {
+
+TEST(temp_folder, ParseTempFolders) {
+  std::vector<TempFolder> folders;
+  ASSERT_TRUE(ParseTempFolders("/scratch0:2,/scratch1/,./a:b:3", folders));
+  ASSERT_EQ(3UL, folders.size());
+  ASSERT_EQ(FilePath("/scratch0"), folders[0].path);
+  ASSERT_EQ(2U, folders[0].weight);
+  ASSERT_EQ(FilePath("/scratch1"), folders[1].path);
+  ASSERT_EQ(1U, folders[1].weight);
+  ASSERT_EQ(FilePath("./a:b"), folders[2].path);
+  ASSERT_EQ(3U, folders[2].weight);
+
+  // A colon without digits is a part of the path.
+  ASSERT_TRUE(ParseTempFolders("./c:d", folders));
+  ASSERT_EQ(1UL, folders.size());
+  ASSERT_EQ(FilePath("./c:d"), folders[0].path);
+
+  ASSERT_FALSE(ParseTempFolders("", folders));
+  ASSERT_FALSE(ParseTempFolders("/scratch0:0", folders));
+  ASSERT_FALSE(ParseTempFolders("/scratch0:1001", folders));
+  ASSERT_FALSE(ParseTempFolders(":2", folders));
+}
+
+TEST(temp_folder, ParseTempPlacement) {
+  TempPlacement placement = TempPlacement::kRoundRobin;
+  ASSERT_TRUE(ParseTempPlacement("free-space", placement));
+  ASSERT_EQ(TempPlacement::kFreeSpace, placement);
+  ASSERT_TRUE(ParseTempPlacement("round-robin", placement));
+  ASSERT_EQ(TempPlacement::kRoundRobin, placement);
+  ASSERT_FALSE(ParseTempPlacement("random", placement));
+}
+
+TEST(temp_folder, SelectTempFolder) {
+  const std::vector<TempFolder> folders = {TempFolder("a", 2),
+                                           TempFolder("b", 1)};
+
+  // The weighted round-robin interleaves the folders.
+  std::vector<std::size_t> selected;
+  for (std::size_t i = 0; i < 6; ++i)
+    selected.push_back(
+        SelectTempFolder(folders, TempPlacement::kRoundRobin, i));
+
+  std::vector<std::size_t> ans = {0, 1, 0, 0, 1, 0};
+  ASSERT_EQ(ans, selected);
+
+  // Only one folder.
+  ASSERT_EQ(0UL, SelectTempFolder({TempFolder("a", 1)},
+                                  TempPlacement::kFreeSpace, 3));
+
+  uint64_t space = 0;
+  ASSERT_TRUE(GetFreeSpace("testoutput", space));
+  ASSERT_FALSE(GetFreeSpace("testoutput/does_not_exist", space));
+}
+
+TEST(temp_folder, GetTempFilePath) {
+  std::vector<TempFolder> saved_folders = gEnv.getTempFolders();
+  gEnv.setTempFolders({TempFolder("a", 1), TempFolder("b", 1),
+                       TempFolder("c", 1)});
+
+  ASSERT_EQ(FilePath("a/file"), GetTempFilePath("file", 0));
+  ASSERT_EQ(FilePath("c/file"), GetTempFilePath("file", 5));
+
+  // The striped files start from the folder after the file.
+  ASSERT_EQ(FilePath("c/run_0"), GetStripedTempFilePath("b/run_0", 1));
+  ASSERT_EQ(FilePath("a/run_1"), GetStripedTempFilePath("b/run_1", 2));
+
+  // Not in a temp folder.
+  ASSERT_EQ(FilePath("d/file"), GetStripedTempFilePath("d/file", 1));
+
+  // The striped files rotate from the folder with the most free space.
+  TempPlacement saved_placement = gEnv.getTempPlacement();
+  gEnv.setTempPlacement(TempPlacement::kFreeSpace);
+  std::vector<FilePath> striped;
+  for (std::size_t k = 0; k < 3; ++k)
+    striped.push_back(GetStripedTempFilePath("b/run", k));
+  ASSERT_NE(striped[0], striped[1]);
+  ASSERT_NE(striped[1], striped[2]);
+  ASSERT_NE(striped[0], striped[2]);
+  ASSERT_EQ(striped[0], GetStripedTempFilePath("b/run", 3));
+
+  gEnv.setTempPlacement(saved_placement);
+  gEnv.setTempFolders(saved_folders);
+}
+
+}  // namespace pcpe
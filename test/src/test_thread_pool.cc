@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "memory_budget.h"
+#include "thread_pool.h"
+
+namespace pcpe {
+
+TEST(thread_pool, submit_and_wait) {
+  ThreadPool pool(4);
+  ASSERT_EQ(4UL, pool.size());
+
+  std::vector<uint32_t> results(100, 0);
+  WaitGroup wg;
+
+  for (uint32_t i = 0; i < results.size(); ++i) {
+    uint32_t* result = &results[i];
+    pool.submit([result, i]() { *result = i + 1; }, wg);
+  }
+  wg.wait();
+
+  ASSERT_TRUE(wg.finished());
+  for (uint32_t i = 0; i < results.size(); ++i) ASSERT_EQ(i + 1, results[i]);
+}
+
+TEST(thread_pool, current_pool) {
+  ThreadPool pool(2);
+  ASSERT_EQ(nullptr, ThreadPool::getCurrentPool());
+
+  ThreadPool* task_pool = nullptr;
+  WaitGroup wg;
+  pool.submit([&task_pool]() { task_pool = ThreadPool::getCurrentPool(); },
+              wg);
+  wg.wait();
+
+  ASSERT_EQ(&pool, task_pool);
+}
+
+static uint64_t Fibonacci(ThreadPool& pool, uint32_t n) {
+  if (n < 2) return n;
+
+  // Fork the first subproblem and wait it in a worker.
+  uint64_t x = 0;
+  WaitGroup wg;
+  pool.submit([&pool, &x, n]() { x = Fibonacci(pool, n - 1); }, wg);
+  uint64_t y = Fibonacci(pool, n - 2);
+  wg.wait();
+
+  return x + y;
+}
+
+TEST(thread_pool, nested_subtasks) {
+  // Only two workers so the waiting workers must execute subtasks or the
+  // test would be deadlocked.
+  ThreadPool pool(2);
+
+  uint64_t result = 0;
+  WaitGroup wg;
+  pool.submit([&pool, &result]() { result = Fibonacci(pool, 16); }, wg);
+  wg.wait();
+
+  ASSERT_EQ(987UL, result);
+}
+
+TEST(thread_pool, steal_subtasks) {
+  ThreadPool pool(4);
+
+  // One task spawns all subtasks into its own deque. The other workers must
+  // steal them.
+  std::mutex mutex;
+  std::set<std::thread::id> thread_ids;
+  std::atomic<uint32_t> done_size(0);
+
+  WaitGroup wg;
+  pool.submit(
+      [&]() {
+        WaitGroup sub_wg;
+        for (uint32_t i = 0; i < 64; ++i) {
+          pool.submit(
+              [&]() {
+                usleep(1000);
+                std::lock_guard<std::mutex> lock(mutex);
+                thread_ids.insert(std::this_thread::get_id());
+                done_size++;
+              },
+              sub_wg);
+        }
+        sub_wg.wait();
+      },
+      wg);
+  wg.wait();
+
+  ASSERT_EQ(64U, done_size.load());
+  ASSERT_LT(1UL, thread_ids.size());
+}
+
+TEST(thread_pool, wait_runs_group_tasks) {
+  // The first task holds 60 of the budget 100 while it waits for a subtask
+  // which runs on the other worker. The waiting worker must not run the
+  // other tasks, or their reservations would be nested and exceed the
+  // budget.
+  MemoryBudget budget(100);
+  ThreadPool pool(2);
+  std::atomic<bool> sub_started(false);
+  std::atomic<bool> waiting(false);
+  std::atomic<uint32_t> done_size(0);
+
+  WaitGroup wg;
+  pool.submit(
+      [&]() {
+        MemoryReservation memory(budget, 60, 60);
+
+        WaitGroup sub_wg;
+        pool.submit(
+            [&]() {
+              sub_started = true;
+              usleep(100000);
+            },
+            sub_wg);
+        while (!sub_started.load()) usleep(100);
+
+        waiting = true;
+        sub_wg.wait();
+        done_size++;
+      },
+      wg);
+
+  while (!waiting.load()) usleep(100);
+  for (uint32_t i = 0; i < 2; ++i) {
+    pool.submit(
+        [&]() {
+          MemoryReservation memory(budget, 60, 60);
+          done_size++;
+        },
+        wg);
+  }
+  wg.wait();
+
+  ASSERT_EQ(3U, done_size.load());
+  ASSERT_LE(budget.getPeakSize(), budget.getLimit());
+}
+
+}  // namespace pcpe
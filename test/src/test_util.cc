@@ -107,4 +107,47 @@ TEST(pcpe_util, CreateFolder_multi_level) {
 	rmdir("./testoutput/test_create_folder");
 }
 
+TEST(pcpe_util, ParseSize) {
+  uint64_t size = 0;
+
+  ASSERT_TRUE(ParseSize("4096", size));
+  ASSERT_EQ(4096UL, size);
+
+  ASSERT_TRUE(ParseSize("512K", size));
+  ASSERT_EQ(512UL * 1024, size);
+
+  ASSERT_TRUE(ParseSize("100MB", size));
+  ASSERT_EQ(100UL * 1024 * 1024, size);
+
+  ASSERT_TRUE(ParseSize("8g", size));
+  ASSERT_EQ(8UL * 1024 * 1024 * 1024, size);
+
+  ASSERT_FALSE(ParseSize("", size));
+  ASSERT_FALSE(ParseSize("M", size));
+  ASSERT_FALSE(ParseSize("-1", size));
+  ASSERT_FALSE(ParseSize("10X", size));
+  ASSERT_FALSE(ParseSize("10MM", size));
+  ASSERT_FALSE(ParseSize("100000000000T", size));
+}
+
+TEST(pcpe_util, ParseShard) {
+  uint32_t index = 0;
+  uint32_t size = 0;
+
+  ASSERT_TRUE(ParseShard("0/4", index, size));
+  ASSERT_EQ(0U, index);
+  ASSERT_EQ(4U, size);
+
+  ASSERT_TRUE(ParseShard("3/4", index, size));
+  ASSERT_EQ(3U, index);
+  ASSERT_EQ(4U, size);
+
+  ASSERT_FALSE(ParseShard("4/4", index, size));
+  ASSERT_FALSE(ParseShard("0/0", index, size));
+  ASSERT_FALSE(ParseShard("1", index, size));
+  ASSERT_FALSE(ParseShard("1/", index, size));
+  ASSERT_FALSE(ParseShard("/4", index, size));
+  ASSERT_FALSE(ParseShard("1/4x", index, size));
+}
+
 } // namespace pcpe